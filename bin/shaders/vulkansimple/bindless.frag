@@ -0,0 +1,20 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// every texture of the scene, set 1 is bound once per command buffer
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+// the material picks the texture, same for the whole draw
+layout(push_constant) uniform DrawPushConstants {
+    mat4 model;
+    uint materialIndex;
+} draw;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = texture(textures[draw.materialIndex], fragTexCoord);
+}
@@ -3,12 +3,16 @@
 //
 #include <external.hpp>
 #include <framebuffer.hpp>
+#include <functional>
 #include <ldevice.hpp>
 #include <pdevice.hpp>
 #include <support.hpp>
 #include <triangle.hpp>
+#include <ubo.hpp>
 #include <utils.hpp>
 #include <vbuffer.hpp>
+#include <vkquery/timestamps.hpp>
+#include <vksync/timeline.hpp>
 
 using namespace vtuto;
 namespace vtuto {
@@ -51,6 +55,386 @@ public:
                          nullptr);
   }
 };
+/** handle of a one time submit, wait on it instead of idling the queue */
+struct transient_submit {
+  uint32_t slot = UINT32_MAX;
+  uint64_t generation = 0;
+};
+
+struct transient_pool_stats {
+  uint32_t allocated_buffers = 0;
+  uint64_t submits = 0;
+  uint64_t recycled = 0;
+  uint64_t blocking_waits = 0;
+};
+
+/**
+  Recycled command buffers for one time submits.
+
+  The pool is created with the transient and reset bits. Each submit takes
+  the next value of the frame scheduler's counter and signals it on the
+  timeline semaphore of the pool's lane; once the lane reached it the
+  buffer goes back to a free list and is reused by the next begin(), so
+  uploads neither allocate nor free command buffers nor idle the queue.
+  submit() returns a ticket the caller waits on only when it needs the
+  result on the host, e.g. before freeing a staging buffer, which
+  release_after() can also defer. Waiting on a ticket waits for its value,
+  so for every earlier submission on any lane as well.
+ */
+class transient_command_pool {
+  struct slot {
+    VkCommandBuffer buffer = VK_NULL_HANDLE;
+    /** timeline value its last submit signals */
+    uint64_t value = 0;
+    uint64_t generation = 0;
+    bool pending = false;
+    std::vector<std::function<void()>> on_complete;
+  };
+  VkDevice device = VK_NULL_HANDLE;
+  VkQueue queue = VK_NULL_HANDLE;
+  frame_scheduler *timeline = nullptr;
+  timeline_lane lane = timeline_lane::graphics;
+  uint64_t submitted_value = 0;
+  std::vector<slot> slots;
+  std::vector<uint32_t> free_slots;
+  uint32_t recording = UINT32_MAX;
+  transient_pool_stats pstats;
+
+public:
+  VkCommandPool pool = VK_NULL_HANDLE;
+
+public:
+  transient_command_pool() {}
+  /** pool on the graphics family, signaling the graphics lane */
+  transient_command_pool(const vulkan_device<VkPhysicalDevice> &physical_dev,
+                         vulkan_device<VkDevice> &logical_dev,
+                         VkQueue submit_queue, frame_scheduler &frames)
+      : transient_command_pool(
+            logical_dev,
+            QueuFamilyIndices::find_family_indices(physical_dev.pdevice,
+                                                   physical_dev.surface)
+                .graphics_family.value(),
+            submit_queue, frames, timeline_lane::graphics) {}
+  /** pool for the given family, submit_queue must come from it and its
+   * submits signal lane */
+  transient_command_pool(vulkan_device<VkDevice> &logical_dev,
+                         uint32_t queue_family, VkQueue submit_queue,
+                         frame_scheduler &frames, timeline_lane submit_lane)
+      : device(logical_dev.device()), queue(submit_queue), timeline(&frames),
+        lane(submit_lane) {
+    VkCommandPoolCreateInfo commandPoolInfo{};
+    commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                            VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    commandPoolInfo.queueFamilyIndex = queue_family;
+    CHECK_VK2(vkCreateCommandPool(device, &commandPoolInfo, nullptr, &pool),
+              "failed to create transient command pool");
+  }
+  /** start recording a one time submit command buffer */
+  VkCommandBuffer begin() {
+    if (recording != UINT32_MAX) {
+      throw std::runtime_error("transient command buffer already recording");
+    }
+    collect();
+    if (free_slots.empty()) {
+      add_slot();
+    }
+    recording = free_slots.back();
+    free_slots.pop_back();
+
+    VkCommandBufferBeginInfo binfo{};
+    binfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    binfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    // the reset bit of the pool makes begin reset the buffer implicitly
+    CHECK_VK2(vkBeginCommandBuffer(slots[recording].buffer, &binfo),
+              "failed to begin transient command buffer");
+    return slots[recording].buffer;
+  }
+  /** end and submit the buffer returned by begin(), after the waits of
+   * sems; its timeline signal is added here */
+  transient_submit submit(VkCommandBuffer cbuffer,
+                          timeline_submit sems = timeline_submit()) {
+    if (recording == UINT32_MAX || slots[recording].buffer != cbuffer) {
+      throw std::runtime_error("submitted buffer is not the recording one");
+    }
+    slot &s = slots[recording];
+    CHECK_VK2(vkEndCommandBuffer(cbuffer),
+              "failed to end transient command buffer");
+
+    s.value = timeline->next_value(lane);
+    sems.signal(timeline->semaphore(lane), s.value);
+    VkSubmitInfo sinfo{};
+    sinfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    sinfo.commandBufferCount = 1;
+    sinfo.pCommandBuffers = &s.buffer;
+    sems.fill(sinfo);
+    CHECK_VK2(vkQueueSubmit(queue, 1, &sinfo, VK_NULL_HANDLE),
+              "failed to submit transient command buffer");
+    submitted_value = s.value;
+    s.pending = true;
+    pstats.submits++;
+    transient_submit ticket;
+    ticket.slot = recording;
+    ticket.generation = s.generation;
+    recording = UINT32_MAX;
+    return ticket;
+  }
+  /** value the last submit signals on lane(), 0 before any */
+  uint64_t last_value() const { return submitted_value; }
+  /** non blocking check, recycles the buffer if the work is done */
+  bool is_complete(transient_submit ticket) {
+    if (!is_live(ticket)) {
+      return true;
+    }
+    if (!timeline->reached(device, lane, slots[ticket.slot].value)) {
+      return false;
+    }
+    finish(ticket.slot);
+    return true;
+  }
+  /** block until the ticket and everything submitted before it is done */
+  void wait(transient_submit ticket) {
+    if (!is_live(ticket)) {
+      return;
+    }
+    pstats.blocking_waits++;
+    timeline->wait(device, slots[ticket.slot].value);
+    finish(ticket.slot);
+    // earlier submissions are complete as well
+    collect();
+  }
+  /** run fn once the ticket completed, e.g. free a staging buffer */
+  void release_after(transient_submit ticket, std::function<void()> fn) {
+    if (!is_live(ticket)) {
+      fn();
+      return;
+    }
+    slots[ticket.slot].on_complete.push_back(std::move(fn));
+  }
+  /** recycle every buffer whose value the lane reached */
+  void collect() {
+    if (slots.empty()) {
+      return;
+    }
+    // one counter read for every slot
+    uint64_t reached = timeline->lane_value(device, lane);
+    for (uint32_t i = 0; i < slots.size(); i++) {
+      if (slots[i].pending && slots[i].value <= reached) {
+        finish(i);
+      }
+    }
+  }
+  /** block until every submitted buffer is done */
+  void wait_all() {
+    for (uint32_t i = 0; i < slots.size(); i++) {
+      if (slots[i].pending) {
+        transient_submit ticket;
+        ticket.slot = i;
+        ticket.generation = slots[i].generation;
+        wait(ticket);
+      }
+    }
+  }
+  const transient_pool_stats &stats() const { return pstats; }
+  /** before the frame scheduler, which owns the semaphore */
+  void destroy(vulkan_device<VkDevice> &logical_dev) {
+    wait_all();
+    // destroying the pool frees its command buffers
+    vkDestroyCommandPool(logical_dev.device(), pool, nullptr);
+    slots.clear();
+    free_slots.clear();
+  }
+
+private:
+  bool is_live(transient_submit ticket) const {
+    // a recycled slot has a new generation, its old work is long done
+    return ticket.slot < slots.size() &&
+           slots[ticket.slot].generation == ticket.generation &&
+           slots[ticket.slot].pending;
+  }
+  void add_slot() {
+    slot s;
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = pool;
+    allocInfo.commandBufferCount = 1;
+    CHECK_VK2(vkAllocateCommandBuffers(device, &allocInfo, &s.buffer),
+              "failed to allocate transient command buffer");
+    slots.push_back(std::move(s));
+    free_slots.push_back(static_cast<uint32_t>(slots.size() - 1));
+    pstats.allocated_buffers++;
+  }
+  void finish(uint32_t index) {
+    slot &s = slots[index];
+    auto callbacks = std::move(s.on_complete);
+    s.on_complete.clear();
+    s.pending = false;
+    s.generation++;
+    free_slots.push_back(index);
+    pstats.recycled++;
+    for (auto &fn : callbacks) {
+      fn();
+    }
+  }
+};
+/** how draw commands reach the queue */
+enum class command_recording {
+  /** one buffer per swapchain image recorded at init, resubmitted as is */
+  prebaked,
+  /** each frame in flight records its buffer again from the draw list */
+  per_frame
+};
+
+/** cost of recording a frame's command buffer */
+struct frame_record_stats {
+  uint64_t frames = 0;
+  uint64_t over_budget = 0;
+  double last_us = 0.0;
+  double max_us = 0.0;
+  double total_us = 0.0;
+
+  void add(double us, double budget_us) {
+    frames++;
+    last_us = us;
+    total_us += us;
+    if (us > max_us) {
+      max_us = us;
+    }
+    if (us > budget_us) {
+      over_budget++;
+    }
+  }
+  double average_us() const { return frames == 0 ? 0.0 : total_us / frames; }
+};
+
+/**
+  Command pool owned by one frame in flight.
+
+  The whole pool is reset with vkResetCommandPool once the frame's fence
+  signaled, which is cheaper than resetting buffers one by one, and its
+  single primary buffer is recorded again from scratch.
+ */
+class frame_command_pool {
+public:
+  VkCommandPool pool = VK_NULL_HANDLE;
+  VkCommandBuffer buffer = VK_NULL_HANDLE;
+
+public:
+  frame_command_pool() {}
+  frame_command_pool(const vulkan_device<VkPhysicalDevice> &physical_dev,
+                     vulkan_device<VkDevice> &logical_dev) {
+    QueuFamilyIndices qfi = QueuFamilyIndices::find_family_indices(
+        physical_dev.pdevice, physical_dev.surface);
+    VkCommandPoolCreateInfo commandPoolInfo{};
+    commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    commandPoolInfo.queueFamilyIndex = qfi.graphics_family.value();
+    CHECK_VK2(vkCreateCommandPool(logical_dev.device(), &commandPoolInfo,
+                                  nullptr, &pool),
+              "failed to create frame command pool");
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = pool;
+    allocInfo.commandBufferCount = 1;
+    CHECK_VK2(
+        vkAllocateCommandBuffers(logical_dev.device(), &allocInfo, &buffer),
+        "failed to allocate frame command buffer");
+  }
+  /** reset the pool and begin recording, the frame slot's previous
+   * submit must have completed */
+  VkCommandBuffer begin(vulkan_device<VkDevice> &logical_dev) {
+    CHECK_VK2(vkResetCommandPool(logical_dev.device(), pool, 0),
+              "failed to reset frame command pool");
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    CHECK_VK2(vkBeginCommandBuffer(buffer, &beginInfo),
+              "failed to begin frame command buffer");
+    return buffer;
+  }
+  void destroy(vulkan_device<VkDevice> &logical_dev) {
+    // frees the buffer as well
+    vkDestroyCommandPool(logical_dev.device(), pool, nullptr);
+  }
+};
+/** where an indirect draw reads its commands and, optionally, their count */
+struct indirect_draw_source {
+  VkBuffer commands = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  /** gpu written draw count, VK_NULL_HANDLE draws max_draws commands */
+  VkBuffer count = VK_NULL_HANDLE;
+  VkDeviceSize count_offset = 0;
+  uint32_t max_draws = 0;
+  /** multiDrawIndirect enabled, otherwise one call per command */
+  bool multi_draw = true;
+};
+
+/**
+  Record an indexed indirect draw.
+
+  With a count buffer the gpu decides how many of the commands run
+  (vkCmdDrawIndexedIndirectCount, core in 1.2 behind the drawIndirectCount
+  feature). Without one every command runs, the writer leaves the unused
+  ones with an instance count of zero.
+ */
+inline void cmd_draw_indexed_indirect(VkCommandBuffer cb,
+                                      const indirect_draw_source &src) {
+  const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+  if (src.count != VK_NULL_HANDLE) {
+    vkCmdDrawIndexedIndirectCount(cb, src.commands, src.offset, src.count,
+                                  src.count_offset, src.max_draws, stride);
+  } else if (src.multi_draw) {
+    vkCmdDrawIndexedIndirect(cb, src.commands, src.offset, src.max_draws,
+                             stride);
+  } else {
+    for (uint32_t i = 0; i < src.max_draws; i++) {
+      vkCmdDrawIndexedIndirect(cb, src.commands,
+                               src.offset + VkDeviceSize(i) * stride, 1,
+                               stride);
+    }
+  }
+}
+
+/** viewport and scissor covering the extent, the pipelines leave both
+ * dynamic so a resize only needs new command buffers */
+inline void cmd_set_viewport_scissor(VkCommandBuffer cb, VkExtent2D extent) {
+  VkViewport viewport{};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = static_cast<float>(extent.width);
+  viewport.height = static_cast<float>(extent.height);
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  vkCmdSetViewport(cb, 0, 1, &viewport);
+  VkRect2D scissor{};
+  scissor.offset = {0, 0};
+  scissor.extent = extent;
+  vkCmdSetScissor(cb, 0, 1, &scissor);
+}
+/** per draw data of the next draws, the layout must declare the range */
+inline void cmd_push_draw_constants(VkCommandBuffer cb,
+                                    VkPipelineLayout layout,
+                                    const DrawPushConstants &constants) {
+  vkCmdPushConstants(cb, layout, DrawPushConstants::stages, 0,
+                     sizeof(DrawPushConstants), &constants);
+}
+
+/**
+  The per image set at 0 and, when there is one, the bindless texture
+  table at 1, both in one call.
+ */
+inline void cmd_bind_draw_sets(VkCommandBuffer cb, VkPipelineLayout layout,
+                               VkDescriptorSet set,
+                               VkDescriptorSet texture_set) {
+  const VkDescriptorSet sets[] = {set, texture_set};
+  uint32_t count = texture_set != VK_NULL_HANDLE ? 2 : 1;
+  vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0,
+                          count, sets, 0, nullptr);
+}
+
 template <> class vulkan_buffer<VkCommandBuffer> {
   //
 public:
@@ -78,7 +462,12 @@ public:
       uint32_t vertex_count = 3,
       uint32_t instance_count = 1,
       uint32_t first_vertex_index = 0,
-      uint32_t first_instance_index = 0)
+      uint32_t first_instance_index = 0,
+      VkBuffer instance_buffer = VK_NULL_HANDLE,
+      const gpu_timer *timer = nullptr,
+      uint32_t timer_slot = 0,
+      const DrawPushConstants *push_constants = nullptr,
+      VkDescriptorSet texture_set = VK_NULL_HANDLE)
       : buffer(loc) {
     mk_cmd_buffer(
         sc_framebuffer, render_pass, swap_chain_extent,
@@ -88,7 +477,8 @@ public:
         clearValueCount, subpass_contents,
         graphics_pass_bind_point, vertex_count,
         instance_count, first_vertex_index,
-        first_instance_index);
+        first_instance_index, instance_buffer, timer,
+        timer_slot, push_constants, texture_set);
   }
   vulkan_buffer(
       VkCommandBuffer loc,
@@ -133,7 +523,12 @@ public:
       uint32_t vertex_count = 3,
       uint32_t instance_count = 1,
       uint32_t first_vertex_index = 0,
-      uint32_t first_instance_index = 0) {
+      uint32_t first_instance_index = 0,
+      VkBuffer instance_buffer = VK_NULL_HANDLE,
+      const gpu_timer *timer = nullptr,
+      uint32_t timer_slot = 0,
+      const DrawPushConstants *push_constants = nullptr,
+      VkDescriptorSet texture_set = VK_NULL_HANDLE) {
 
     // 1. create command buffer info
     VkCommandBufferBeginInfo beginInfo{};
@@ -141,6 +536,9 @@ public:
         VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     CHECK_VK2(vkBeginCommandBuffer(buffer, &beginInfo),
               "failed to begin recording commands");
+    if (timer != nullptr) {
+      timer->cmd_begin(buffer, timer_slot);
+    }
 
     // 2. create render pass info
     VkRenderPassBeginInfo renderPassInfo{};
@@ -164,31 +562,110 @@ public:
     vkCmdBeginRenderPass(buffer, &renderPassInfo,
                          subpass_contents);
 
-    // 4. bind pipeline to command buffer
-    vkCmdBindPipeline(buffer, graphics_pass_bind_point,
-                      graphics_pipeline);
-
-    // 5. bind vertex buffer to command buffer
-    VkBuffer vertex_buffers[] = {vertex_buffer};
-    VkDeviceSize vertex_offsets[] = {0};
-    vkCmdBindVertexBuffers(buffer, 0, 1, vertex_buffers,
-                           vertex_offsets);
-    // 6. bind index buffer to command buffer
-    vkCmdBindIndexBuffer(buffer, index_buffer, 0,
-                         VK_INDEX_TYPE_UINT32);
-
-    // 7. bind descriptor set
-    vkCmdBindDescriptorSets(
-        buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-        pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
-
-    // 7. draw given command buffer with indices
-    vkCmdDrawIndexed(buffer,
-                     static_cast<uint32_t>(indices.size()),
-                     instance_count, first_vertex_index,
-                     first_instance_index, 0);
+    // without a pipeline yet the pass only clears
+    if (graphics_pipeline != VK_NULL_HANDLE) {
+      // 4. bind pipeline to command buffer
+      vkCmdBindPipeline(buffer, graphics_pass_bind_point,
+                        graphics_pipeline);
+      cmd_set_viewport_scissor(buffer, swap_chain_extent);
+
+      // 5. bind vertex buffer to command buffer
+      VkBuffer vertex_buffers[] = {vertex_buffer};
+      VkDeviceSize vertex_offsets[] = {0};
+      vkCmdBindVertexBuffers(buffer, 0, 1, vertex_buffers,
+                             vertex_offsets);
+      // per instance attributes, if the pipeline reads any
+      if (instance_buffer != VK_NULL_HANDLE) {
+        vkCmdBindVertexBuffers(buffer, 1, 1, &instance_buffer,
+                               vertex_offsets);
+      }
+      // 6. bind index buffer to command buffer
+      vkCmdBindIndexBuffer(buffer, index_buffer, 0,
+                           VK_INDEX_TYPE_UINT32);
+
+      // 7. bind descriptor set
+      cmd_bind_draw_sets(buffer, pipeline_layout, descriptor_set,
+                         texture_set);
+      if (push_constants != nullptr) {
+        cmd_push_draw_constants(buffer, pipeline_layout, *push_constants);
+      }
+
+      // 7. draw given command buffer with indices
+      vkCmdDrawIndexed(buffer,
+                       static_cast<uint32_t>(indices.size()),
+                       instance_count, first_vertex_index,
+                       first_instance_index, 0);
+    }
+
+    vkCmdEndRenderPass(buffer);
+    if (timer != nullptr) {
+      timer->cmd_end(buffer, timer_slot);
+    }
+    CHECK_VK2(vkEndCommandBuffer(buffer),
+              "failed to register command buffer");
+  }
+  /**
+    Indirect variant of mk_cmd_buffer: the draws come from a buffer filled
+    by the gpu or the cpu. pre_pass records what must run before the
+    render pass, e.g. the compute pass writing the commands.
+   */
+  void mk_indirect_cmd_buffer(
+      vulkan_buffer<VkFramebuffer> &sc_framebuffer,
+      VkRenderPass &render_pass, VkExtent2D swap_chain_extent,
+      VkPipeline graphics_pipeline, VkBuffer vertex_buffer,
+      VkBuffer instance_buffer, VkBuffer index_buffer,
+      VkDescriptorSet descriptor_set, VkPipelineLayout pipeline_layout,
+      const indirect_draw_source &draws,
+      const std::function<void(VkCommandBuffer)> &pre_pass = nullptr,
+      const gpu_timer *timer = nullptr, uint32_t timer_slot = 0,
+      const DrawPushConstants *push_constants = nullptr,
+      VkDescriptorSet texture_set = VK_NULL_HANDLE) {
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    CHECK_VK2(vkBeginCommandBuffer(buffer, &beginInfo),
+              "failed to begin recording commands");
+    if (timer != nullptr) {
+      timer->cmd_begin(buffer, timer_slot);
+    }
+    if (pre_pass) {
+      pre_pass(buffer);
+    }
+
+    std::array<VkClearValue, 2> cvalues{};
+    cvalues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    cvalues[1].depthStencil = {1.0f, 0};
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = render_pass;
+    renderPassInfo.framebuffer = sc_framebuffer.buffer;
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = swap_chain_extent;
+    renderPassInfo.clearValueCount = static_cast<uint32_t>(cvalues.size());
+    renderPassInfo.pClearValues = cvalues.data();
+    vkCmdBeginRenderPass(buffer, &renderPassInfo,
+                         VK_SUBPASS_CONTENTS_INLINE);
+
+    // without a pipeline yet the pass only clears
+    if (graphics_pipeline != VK_NULL_HANDLE) {
+      vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        graphics_pipeline);
+      cmd_set_viewport_scissor(buffer, swap_chain_extent);
+      VkDeviceSize offsets[] = {0};
+      vkCmdBindVertexBuffers(buffer, 0, 1, &vertex_buffer, offsets);
+      vkCmdBindVertexBuffers(buffer, 1, 1, &instance_buffer, offsets);
+      vkCmdBindIndexBuffer(buffer, index_buffer, 0, VK_INDEX_TYPE_UINT32);
+      cmd_bind_draw_sets(buffer, pipeline_layout, descriptor_set,
+                         texture_set);
+      if (push_constants != nullptr) {
+        cmd_push_draw_constants(buffer, pipeline_layout, *push_constants);
+      }
+      cmd_draw_indexed_indirect(buffer, draws);
+    }
 
     vkCmdEndRenderPass(buffer);
+    if (timer != nullptr) {
+      timer->cmd_end(buffer, timer_slot);
+    }
     CHECK_VK2(vkEndCommandBuffer(buffer),
               "failed to register command buffer");
   }
@@ -10,8 +10,34 @@
 #include <support.hpp>
 #include <swapchain.hpp>
 #include <triangle.hpp>
+#include <ubo.hpp>
 #include <utils.hpp>
 #include <vertex.hpp>
+#include <vkculling/gpucull.hpp>
+#include <vkdescriptor/allocator.hpp>
+#include <vkdescriptor/bindless.hpp>
+#include <vkdescriptor/layoutcache.hpp>
+#include <vkimage/samplercache.hpp>
+#include <vkimageview/viewcache.hpp>
+#include <vkrenderpass/framebuffercache.hpp>
+#include <vkrenderpass/passcache.hpp>
+#include <vkmemory/budget.hpp>
+#include <vkmemory/framearena.hpp>
+#include <vkpipeline/buildqueue.hpp>
+#include <vkpipeline/pipelinecache.hpp>
+#include <vkpipeline/pipelinestate.hpp>
+#include <vkquery/timestamps.hpp>
+#include <vkqueuefamily/ownership.hpp>
+#include <vkscene/drawlist.hpp>
+#include <vkscene/instances.hpp>
+#include <vkscene/transform.hpp>
+#include <vkshader/hotreload.hpp>
+#include <vkshader/registry.hpp>
+#include <vkshader/specialization.hpp>
+#include <vksync/deletionqueue.hpp>
+#include <vksync/framepacing.hpp>
+#include <vksync/timeline.hpp>
+#include <vkthread/cmdrecorder.hpp>
 
 using namespace vtuto;
 
@@ -45,42 +71,97 @@ public:
   /** swapchain for handling frame rate*/
   swapchain swap_chain;
 
-  /** swap chain frame buffers*/
+  /** swap chain frame buffers, owned by framebuffers*/
   std::vector<vulkan_buffer<VkFramebuffer>> swapchain_framebuffers;
+  /** framebuffers by pass, views and extent, least recently used evicted*/
+  framebuffer_cache framebuffers;
 
-  /** render pass */
+  /** render pass, owned by render_passes */
   VkRenderPass render_pass;
+  /** passes by attachments and subpasses, kept for formats coming back*/
+  render_pass_cache render_passes;
 
-  /** descriptor set layout*/
-  VkDescriptorSetLayout descriptor_set_layout;
+  /** descriptor set layout, owned by descriptor_layouts*/
+  VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
 
-  /** descriptor pool*/
-  VkDescriptorPool descriptor_pool;
+  /** set layouts by bindings, shared by everything asking for the same*/
+  descriptor_layout_cache descriptor_layouts;
+  /** sets living as long as the swapchain, its pools are recycled after
+   * a rebuild once no frame uses them*/
+  descriptor_allocator descriptors;
 
   std::vector<VkDescriptorSet> descriptor_sets;
 
-  /** graphics pipeline layout*/
-  VkPipelineLayout pipeline_layout;
-
-  /** graphics pipeline object*/
-  VkPipeline graphics_pipeline;
+  /** every texture by slot, bound as set 1 next to descriptor_sets*/
+  bindless_texture_table texture_table;
+  /** slots the table is created with, fewer if the device limits it*/
+  uint32_t texture_table_capacity = 1024;
+  /** false when descriptor indexing, push constants or the shader are
+   * missing, the texture is then bound per image as binding 1*/
+  bool bindless_enabled = true;
+  bool use_bindless = false;
+  /** slot of the model texture, the material index of its draw*/
+  uint32_t model_texture_slot = 0;
+
+  /** graphics pipeline layout, recreated when the flags below differ
+   * from use_push_constants and use_bindless*/
+  VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+  bool layout_push_constants = false;
+  bool layout_bindless = false;
+
+  /** graphics pipeline object, owned by pipeline_library*/
+  VkPipeline graphics_pipeline = VK_NULL_HANDLE;
 
   /** command pool for command buffer*/
   vk_command_pool command_pool;
   vulkan_buffers<VkCommandBuffer> cmd_buffers;
 
+  /** recycled command buffers for one time upload submits*/
+  transient_command_pool upload_pool;
+
+  /** buffer uploads on the dedicated transfer family, if there is one*/
+  transient_command_pool transfer_pool;
+  bool use_transfer_queue = false;
+  /** acquire halves of the transfers released by transfer_pool*/
+  std::vector<VkBufferMemoryBarrier> pending_acquires;
+  VkPipelineStageFlags pending_acquire_stages = 0;
+
+  /** threads recording secondary command buffers, 0 picks one per core and
+   * 1 records serially on the main thread*/
+  std::size_t record_threads = 0;
+  thread_pool record_workers;
+  thread_command_pools record_pools;
+  /** secondary buffers executed by each swapchain image's primary*/
+  std::vector<std::vector<recorded_secondary>> secondary_buffers;
+  record_stats last_record_stats;
+
+  /** prebaked per image buffers or buffers recorded every frame*/
+  command_recording recording_mode = command_recording::prebaked;
+  /** one resettable pool per frame in flight, per_frame mode only*/
+  std::vector<frame_command_pool> frame_pools;
+  /** draws recorded every frame in per_frame mode*/
+  draw_list scene_draws;
+  /** frames whose recording takes longer than this are counted*/
+  double record_budget_us = 500.0;
+  frame_record_stats frame_recording;
+
   /** texture staging buffer */
   VkBuffer staging_buffer;
   VkDeviceMemory stage_buffer_memory;
   VkImage texture_image;
   VkDeviceMemory texture_image_memory;
 
-  /** texture image view */
+  /** texture image view, owned by view_cache */
   VkImageView texture_image_view;
 
-  /** texture sampler */
+  /** texture sampler, owned by samplers*/
   VkSampler texture_sampler;
 
+  /** samplers by create info, shared by textures sampled alike*/
+  sampler_cache samplers;
+  /** views by image and description, released with their image*/
+  image_view_cache view_cache;
+
   /** depth image related*/
   VkImage depth_image;
   VkImageView depth_image_view;
@@ -101,18 +182,133 @@ public:
   /** uniform buffer*/
   std::vector<VkBuffer> uniform_buffers;
   std::vector<VkDeviceMemory> uniform_buffer_memories;
-
-  /** vk semaphore to hold available and rendered images */
+  /** mapped for the buffers' whole life, an image is rewritten only when
+   * the scene moved since its last write*/
+  std::vector<UniformBufferObject *> uniform_mapped;
+  std::vector<uint64_t> uniform_written;
+
+  /** scene nodes, the model matrix of the uniform buffer is model_node;
+   * instance i is node instance_root + 1 + i, the last nodes of the graph*/
+  transform_hierarchy scene_graph;
+  uint32_t model_node = 0;
+  uint32_t instance_root = 0;
+  /** view and projection, recomputed with the swapchain extent only*/
+  glm::mat4 camera_view{1.0f};
+  glm::mat4 camera_proj{1.0f};
+
+  /** copies of the model drawn by a single indexed draw*/
+  uint32_t instance_count = 1;
+  instance_transforms instances;
+  /** false when the instanced vertex shader is missing, one copy is drawn*/
+  bool instancing = false;
+  /** model matrix and material pushed with each draw instead of read from
+   * the uniform buffer, false when the push constant shader is missing*/
+  bool push_constants_enabled = true;
+  bool use_push_constants = false;
+  /** per image instance buffers, mapped for their whole life*/
+  std::vector<VkBuffer> instance_buffers;
+  std::vector<VkDeviceMemory> instance_buffer_memories;
+  std::vector<InstanceData *> instance_mapped;
+  uint32_t instance_capacity = 0;
+  /** bumped when the instance count or layout changes, culling bounds
+   * behind it are rebuilt*/
+  uint64_t instance_version = 1;
+  /** scene_graph version each image's instance buffer was written at*/
+  std::vector<uint64_t> instance_written;
+
+  /** gpu time of each image's command buffer*/
+  gpu_timer frame_timer;
+  double gpu_time_ms_total = 0.0;
+  uint64_t gpu_time_samples = 0;
+  /** step through instance counts instead of running the render loop*/
+  bool instance_benchmark = false;
+
+  /** how instances outside the view are skipped, picked by
+   * createCullPipeline from the device features*/
+  cull_mode culling = cull_mode::none;
+  bool culling_enabled = true;
+  /** check every gpu visible count against the cpu*/
+  bool verify_culling = false;
+  /** bounding sphere of the mesh after the uniform model matrix*/
+  glm::vec4 model_bounds{0.0f};
+  /** per image bounds, commands and count, sized like the instances*/
+  std::vector<cull_buffers> cull_targets;
+  /** instance spheres the cpu path tests, rebuilt when instance_version
+   * moves*/
+  sphere_soa instance_spheres;
+  uint64_t instance_spheres_version = 0;
+  VkDescriptorSetLayout cull_set_layout = VK_NULL_HANDLE;
+  VkPipelineLayout cull_pipeline_layout = VK_NULL_HANDLE;
+  VkPipeline cull_pipeline = VK_NULL_HANDLE;
+  /** specialization of cull_pipeline, dispatches use its workgroup size*/
+  cull_shader_constants cull_constants;
+  /** per image sets of the culling shader, retired with cull_targets*/
+  descriptor_allocator cull_descriptors;
+  std::vector<VkDescriptorSet> cull_sets;
+  /** maxDrawIndirectCount of the device*/
+  uint32_t max_indirect_draws = 1;
+  cull_stats culled;
+
+  /** vk semaphore to hold available and rendered images, binary since the
+   * swapchain does not take timeline semaphores */
   std::vector<VkSemaphore> image_available_semaphores;
   std::vector<VkSemaphore> render_finished_semaphores;
 
-  /** fence image for drawing */
-  std::vector<VkFence> current_fences;
-  std::vector<VkFence> images_in_flight;
+  /** timeline values of frames, images and uploads instead of fences*/
+  frame_scheduler frames;
   std::size_t current_frame = 0;
 
-  /** maximum frames in flight*/
-  const int MAX_FRAMES_IN_FLIGHT = 2;
+  /** present mode preferences, frames in flight and swapchain image
+   * count, change with setFramePacing once the device exists*/
+  frame_pacing_config pacing;
+  latency_tracker frame_latency;
+  /** resize cost, rebuild_pipeline_on_resize restores the old behaviour
+   * to compare against*/
+  swapchain_rebuild_stats swapchain_rebuilds;
+  bool rebuild_pipeline_on_resize = false;
+
+  /** transient cpu side memory per frame in flight, reset once its frame
+   * completed*/
+  std::vector<frame_arena> frame_arenas;
+
+  /** device memory accounting per heap and per category*/
+  memory_tracker memory_stats;
+
+  /** every pipeline is created through it, saved at shutdown so the next
+   * launch skips the driver's shader compilation*/
+  pipeline_cache pipelines;
+  std::string pipeline_cache_path = "./pipeline_cache.bin";
+  /** graphics pipelines by state, owned by the library*/
+  graphics_pipeline_library pipeline_library;
+  /** compiles pipelines on record_workers once they run, inline before*/
+  pipeline_build_queue pipeline_builds;
+  /** attachment formats and samples of render_pass*/
+  uint64_t render_pass_compat = 0;
+  /** spir-v modules shared by every pipeline, loaded once per file*/
+  shader_registry shaders;
+  /** vertex and fragment modules of graphics_pipeline, kept until its
+   * successor holds its own so a rebuild reads nothing from disk*/
+  std::array<VkShaderModule, 2> graphics_modules{};
+  /** what graphics_pipeline was built from and the files of its modules*/
+  graphics_pipeline_desc graphics_desc;
+  std::array<std::string, 2> graphics_shader_paths;
+
+  /** rebuild graphics_pipeline in the background when its shaders change
+   * under ./shaders, swapped in between frames*/
+  bool hot_reload_enabled = false;
+  /** run on a changed glsl source to write its .spv, empty to only
+   * watch the spir-v*/
+  std::string shader_compiler = "glslc";
+  shader_watcher shader_changes;
+  /** one rebuild at a time, off the render thread*/
+  thread_pool reload_worker;
+  std::future<shader_reload> pending_reload;
+  /** changes seen while a rebuild runs, they start the next one*/
+  std::set<std::string> reload_queued;
+  shader_reload_stats reload_stats;
+
+  /** handles retired while frames in flight may still use them*/
+  deletion_queue deletions;
 
   /** check framebuffer state*/
   bool framebuffer_resized = false;
@@ -295,11 +491,38 @@ number of indices for given device family.
   bool checkDeviceExtensionSupport(VkPhysicalDevice pdev);
   void createPhysicalDevice();
   void createLogicalDevice();
-  VkShaderModule createShaderModule(const std::vector<char> &shaderCode);
+  /** module of the spir-v at path with a reference taken, throws when
+   * it can not be loaded*/
+  VkShaderModule acquireShader(const std::string &path);
   void createGraphicsPipeline();
+  void startHotReload();
+  /** once per frame: collect changed files, swap in a finished rebuild
+   * and start the next, never waits*/
+  void pollShaderChanges();
+  /** runs on reload_worker, touches only thread safe members*/
+  shader_reload rebuildGraphicsPipeline(std::set<std::string> changed,
+                                        graphics_pipeline_desc base,
+                                        std::array<std::string, 2> paths);
+  void applyShaderReload(shader_reload &reload);
+  /** block until a running rebuild is done with the objects it was
+   * handed, its result is still applied by the next poll*/
+  void waitShaderReload();
+  void stopHotReload();
   void createDescriptorSetLayout();
+  /** size the allocators, their pools are created on demand*/
   void createDescriptorPool();
+  void reportDescriptorStats();
+  /** the table's layout and set, only when the device supports it*/
+  void createTextureTable();
+  /** put the model texture in the table, nothing without one*/
+  void addTableTextures();
+  /** the set bound at 1, null without bindless textures*/
+  VkDescriptorSet textureTableSet() const;
   void createDescriptorSets();
+  /** append the writes pointing set at image's uniform buffer and the
+   * model texture, infos are taken from the frame arena*/
+  void writeDrawSet(VkDescriptorSet set, std::size_t image,
+                    arena_vector<VkWriteDescriptorSet> &writes);
   void createFramebuffers();
   uint32_t findMemoryType(uint32_t filter, VkMemoryPropertyFlags flags);
   VkFormat findSupportedFormat(const std::vector<VkFormat> &candidates,
@@ -311,14 +534,73 @@ number of indices for given device family.
   void createVertexBuffer();
   void createIndexBuffer();
   void createUniformBuffer();
-  void copyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size);
+  /** persistently mapped per image buffers of instance_capacity entries*/
+  void createInstanceBuffers();
+  void retireInstanceBuffers();
+  /** copy the transforms into the image's buffer if they changed*/
+  void writeInstances(uint32_t image_index);
+  /** lay count instances on a grid and re-record the draws*/
+  void setInstanceCount(uint32_t count);
+  void createFrameTimer();
+  /** sphere around the loaded model for the culling tests*/
+  void computeModelBounds();
+  /** choose the cull mode and build the compute pipeline if it is gpu*/
+  void createCullPipeline();
+  /** bounds, command and count buffers of every image*/
+  void createCullBuffers();
+  void retireCullBuffers();
+  /** read back the visible count of the image's completed frame*/
+  void readCulling(uint32_t image_index);
+  /** write the image's frustum and, on the cpu path, its draw commands*/
+  void writeCulling(uint32_t image_index);
+  /** compute pass filling the image's commands, before the render pass*/
+  void cmdCull(VkCommandBuffer cb, uint32_t image_index);
+  indirect_draw_source cullDraws(uint32_t image_index) const;
+  void destroyCulling();
+  void reportCullStats();
+  /** cpu and gpu frame time from 1 to 100k instances*/
+  void runInstanceBenchmark();
+  transient_submit copyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size);
+  /** copy staging into dst, on the transfer queue when there is a
+   * dedicated one, and free staging once the copy is done*/
+  void uploadBuffer(VkBuffer staging, VkDeviceMemory staging_memory,
+                    VkBuffer dst, VkDeviceSize size, VkAccessFlags dst_access,
+                    VkPipelineStageFlags dst_stage);
+  /** wait for every upload and hand transferred buffers to graphics*/
+  void finishUploads();
   void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
                     VkMemoryPropertyFlags mem_flags, VkBuffer &buffer,
-                    VkDeviceMemory &buffer_memory);
+                    VkDeviceMemory &buffer_memory,
+                    memory_category category = memory_category::other);
+  /** untrack and free device memory*/
+  void freeMemory(VkDeviceMemory memory);
+  /** untrack memory that swapchain::destroy frees on our behalf*/
+  void untrackSwapchainMemory();
+  /** print memory budget, usage and fragmentation metrics*/
+  void reportMemoryUsage();
   void createCommandPool();
   void createCommandBuffers();
+  /** record the primaries from secondaries built on record_workers*/
+  void recordCommandBuffersParallel();
+  /** record this frame's command buffer from scene_draws*/
+  VkCommandBuffer recordFrameCommands(uint32_t image_index);
+  /** print command buffer recording timings*/
+  void reportRecordStats();
   void createSyncObjects();
+  /** semaphores, arenas and command pools of each frame slot*/
+  void createFrameSlots();
+  void destroyFrameSlots();
+  /** wait for the gpu then rebuild the frame slots for count frames*/
+  void setFramesInFlight(std::size_t count);
+  /** apply new pacing settings, rebuilds the swapchain and frame slots*/
+  void setFramePacing(const frame_pacing_config &config);
+  void reportFramePacing();
   void recreateSwapchain();
+  /** hand every swapchain dependent object to the deletion queue, the
+   * render pass and the pipeline are kept*/
+  void retireSwapchainResources();
+  /** prebaked primaries and their secondaries, freed once unused*/
+  void retireCommandBuffers();
   void createDepthRessources();
   void createTextureImage();
   void createTextureSampler();
@@ -328,15 +610,27 @@ number of indices for given device family.
   void createImage(uint32_t imw, uint32_t imh, VkFormat format,
                    VkImageTiling tiling, VkImageUsageFlags imusage,
                    VkMemoryPropertyFlags improps, VkImage &vimage,
-                   VkDeviceMemory &vimage_memory);
+                   VkDeviceMemory &vimage_memory,
+                   memory_category category = memory_category::other);
+  /** model, camera and projection of the current frame*/
+  UniformBufferObject frameUniforms() const;
+  /** nodes of the scene and their initial transforms*/
+  void createSceneGraph();
+  /** replace the instance nodes by the current instances*/
+  void placeInstances();
+  /** view and projection for the current swapchain extent*/
+  void updateCamera();
+  /** what a draw pushes, its node's world matrix and its material*/
+  DrawPushConstants drawConstants(const draw_item &d) const;
   void updateUniformBuffer(uint32_t image_index);
   void draw();
   VkCommandBuffer beginSignalCommand();
-  void endSignalCommand(VkCommandBuffer cbuffer);
-  void transitionImageLayout(VkImage image, VkFormat format,
-                             VkImageLayout old_layout,
-                             VkImageLayout new_layout);
-  void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width,
-                         uint32_t height);
+  /** submit without waiting, the ticket tells when the work is done*/
+  transient_submit endSignalCommand(VkCommandBuffer cbuffer);
+  transient_submit transitionImageLayout(VkImage image, VkFormat format,
+                                         VkImageLayout old_layout,
+                                         VkImageLayout new_layout);
+  transient_submit copyBufferToImage(VkBuffer buffer, VkImage image,
+                                     uint32_t width, uint32_t height);
 };
 } // namespace vtuto
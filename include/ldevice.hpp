@@ -5,6 +5,7 @@
 #include <pdevice.hpp>
 #include <support.hpp>
 #include <utils.hpp>
+#include <vkdescriptor/bindless.hpp>
 
 using namespace vtuto;
 
@@ -21,6 +22,24 @@ public:
   /** window surface queue*/
   VkQueue present_queue;
 
+  /** transfer queue, graphics queue when there is no dedicated family*/
+  VkQueue transfer_queue;
+
+  /** compute queue, graphics queue when there is no async compute*/
+  VkQueue compute_queue;
+
+  /** families the queues above come from*/
+  QueuFamilyIndices families;
+
+  /** core features enabled on the device*/
+  VkPhysicalDeviceFeatures enabled_features{};
+
+  /** vulkan 1.2 features enabled on the device*/
+  VkPhysicalDeviceVulkan12Features enabled12{};
+
+  /** required and supported optional extensions the device was created with*/
+  std::vector<const char *> enabled_extensions;
+
 public:
   vulkan_device() {}
   vulkan_device(
@@ -29,15 +48,15 @@ public:
     QueuFamilyIndices indices =
         QueuFamilyIndices::find_family_indices(
             physical_dev.pdevice, physical_dev.surface);
+    families = indices;
 
     /**
       VkDeviceQueueCreateInfo
       queueFamilyIndex
      */
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = {
-        indices.graphics_family.value(),
-        indices.present_family.value()};
+    std::set<uint32_t> uniqueQueueFamilies =
+        indices.unique_families();
 
     float queuePriority = 1.0f;
     for (uint32_t qfamily : uniqueQueueFamilies) {
@@ -51,23 +70,48 @@ public:
     }
 
     //
-    VkPhysicalDeviceFeatures deviceFeature{};
-    deviceFeature.samplerAnisotropy = VK_TRUE;
+    VkPhysicalDeviceFeatures supported{};
+    vkGetPhysicalDeviceFeatures(physical_dev.pdevice, &supported);
+    enabled_features.samplerAnisotropy = VK_TRUE;
+    // indirect draws, used when supported
+    enabled_features.multiDrawIndirect = supported.multiDrawIndirect;
+    enabled_features.drawIndirectFirstInstance =
+        supported.drawIndirectFirstInstance;
+
+    // timeline semaphores pace the frames
+    VkPhysicalDeviceVulkan12Features supported12 =
+        query_vulkan12_features(physical_dev.pdevice);
+    if (!supported12.timelineSemaphore) {
+      throw std::runtime_error(
+          "device does not support timeline semaphores");
+    }
+    enabled12.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    enabled12.timelineSemaphore = VK_TRUE;
+    enabled12.drawIndirectCount = supported12.drawIndirectCount;
+    // descriptor indexing for the bindless texture table, if complete
+    bindless_texture_table::enable(supported12, enabled12);
 
     //
     VkDeviceCreateInfo createInfo{};
-    createInfo.sType =
-        VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &enabled12;
 
     createInfo.queueCreateInfoCount =
         static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
-    createInfo.pEnabledFeatures = &deviceFeature;
+    createInfo.pEnabledFeatures = &enabled_features;
+    enabled_extensions = device_extensions;
+    for (const char *ext : optional_device_extensions) {
+      if (has_device_extension(physical_dev.pdevice, ext)) {
+        enabled_extensions.push_back(ext);
+      }
+    }
     createInfo.enabledExtensionCount =
-        static_cast<uint32_t>(device_extensions.size());
+        static_cast<uint32_t>(enabled_extensions.size());
     createInfo.ppEnabledExtensionNames =
-        device_extensions.data();
+        enabled_extensions.data();
 
     //
     if (enableVLayers) {
@@ -90,8 +134,22 @@ public:
     vkGetDeviceQueue(ldevice,
                      indices.present_family.value(), 0,
                      &present_queue);
+    vkGetDeviceQueue(ldevice,
+                     indices.transfer_family.value(), 0,
+                     &transfer_queue);
+    vkGetDeviceQueue(ldevice,
+                     indices.compute_family.value(), 0,
+                     &compute_queue);
   }
   void destroy() { vkDestroyDevice(ldevice, nullptr); }
+  bool is_enabled(const char *ext) const {
+    for (const char *e : enabled_extensions) {
+      if (std::string(e) == ext) {
+        return true;
+      }
+    }
+    return false;
+  }
   VkDevice device() { return ldevice; }
 };
 }
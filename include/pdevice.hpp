@@ -84,7 +84,10 @@ public:
     bool cond1 = indices.is_complete() &&
            areExtensionsSupported && isSwapChainPossible;
     bool cond2 = cond1 && (dprops.limits.maxSamplerAnisotropy > 0.0);
-    return cond2;
+    // frames are paced on timeline semaphores
+    bool cond3 = cond2 && dprops.apiVersion >= VK_API_VERSION_1_2 &&
+                 query_vulkan12_features(pdev).timelineSemaphore;
+    return cond3;
   }
   void createSurface(GLFWwindow *window) {
     CHECK_VK2(glfwCreateWindowSurface(instance(), window,
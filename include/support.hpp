@@ -5,19 +5,72 @@ namespace vtuto {
 //
 std::vector<const char *> device_extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
+/** extensions enabled when the device has them, never required */
+std::vector<const char *> optional_device_extensions = {
+    VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+    VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME};
+
+bool has_device_extension(VkPhysicalDevice pdev, const char *name) {
+  uint32_t ext_count = 0;
+  vkEnumerateDeviceExtensionProperties(pdev, nullptr, &ext_count, nullptr);
+  std::vector<VkExtensionProperties> exts(ext_count);
+  vkEnumerateDeviceExtensionProperties(pdev, nullptr, &ext_count, exts.data());
+  for (const auto &ext : exts) {
+    if (std::string(ext.extensionName) == name) {
+      return true;
+    }
+  }
+  return false;
+}
+/** vulkan 1.2 features of the device, needs a 1.2 instance and device */
+VkPhysicalDeviceVulkan12Features query_vulkan12_features(VkPhysicalDevice pdev) {
+  VkPhysicalDeviceVulkan12Features features12{};
+  features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  VkPhysicalDeviceFeatures2 features{};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features.pNext = &features12;
+  vkGetPhysicalDeviceFeatures2(pdev, &features);
+  features12.pNext = nullptr;
+  return features12;
+}
+
 struct QueuFamilyIndices {
   std::optional<uint32_t> graphics_family;
   std::optional<uint32_t> present_family;
+  /** transfer only family if there is one, else graphics */
+  std::optional<uint32_t> transfer_family;
+  /** compute family without graphics if there is one, else graphics */
+  std::optional<uint32_t> compute_family;
   bool is_complete() {
     return graphics_family.has_value() && present_family.has_value();
   }
+  bool has_dedicated_transfer() const {
+    return transfer_family.has_value() && transfer_family != graphics_family;
+  }
+  bool has_async_compute() const {
+    return compute_family.has_value() && compute_family != graphics_family;
+  }
+  /** every family a queue has to be created for */
+  std::set<uint32_t> unique_families() const {
+    std::set<uint32_t> families;
+    for (const auto &f :
+         {graphics_family, present_family, transfer_family, compute_family}) {
+      if (f.has_value()) {
+        families.insert(f.value());
+      }
+    }
+    return families;
+  }
   /**
   Find device family indices for given VkPhysicalDevice
 
   We query the given physical device for physical device
-  family properties. We break away if the device has
-  complete
-  number of indices for given device family.
+  family properties. Every family is looked at: graphics takes the first
+  graphics family, present prefers that same family, transfer prefers a
+  family with neither graphics nor compute (the DMA engine) and compute a
+  family without graphics, so uploads and compute can run next to
+  graphics. Both fall back to the graphics family which supports them
+  implicitly.
   */
 
   static QueuFamilyIndices find_family_indices(VkPhysicalDevice pdev,
@@ -31,25 +84,46 @@ struct QueuFamilyIndices {
     vkGetPhysicalDeviceQueueFamilyProperties(pdev, &familyCount,
                                              queueFamilies.data());
 
+    std::optional<uint32_t> transfer_no_graphics;
     uint32_t i = 0;
     for (const auto &qfamily : queueFamilies) {
       //
-      if (qfamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+      VkQueueFlags flags = qfamily.queueFlags;
+      bool graphics = (flags & VK_QUEUE_GRAPHICS_BIT) != 0;
+      bool compute = (flags & VK_QUEUE_COMPUTE_BIT) != 0;
+      bool transfer = (flags & VK_QUEUE_TRANSFER_BIT) != 0;
+      if (graphics && !indices.graphics_family.has_value()) {
         indices.graphics_family = i;
       }
 
       VkBool32 present_support = false;
       vkGetPhysicalDeviceSurfaceSupportKHR(pdev, i, surface, &present_support);
 
-      if (present_support) {
+      if (present_support &&
+          (!indices.present_family.has_value() ||
+           (graphics && indices.graphics_family == i))) {
         indices.present_family = i;
       }
-
-      if (indices.is_complete()) {
-        break;
+      if (transfer && !graphics && !compute &&
+          !indices.transfer_family.has_value()) {
+        indices.transfer_family = i;
+      }
+      if (transfer && !graphics && !transfer_no_graphics.has_value()) {
+        transfer_no_graphics = i;
+      }
+      if (compute && !graphics && !indices.compute_family.has_value()) {
+        indices.compute_family = i;
       }
       i++;
     }
+    if (!indices.transfer_family.has_value()) {
+      indices.transfer_family = transfer_no_graphics.has_value()
+                                    ? transfer_no_graphics
+                                    : indices.graphics_family;
+    }
+    if (!indices.compute_family.has_value()) {
+      indices.compute_family = indices.graphics_family;
+    }
     return indices;
   }
 };
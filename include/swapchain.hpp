@@ -9,10 +9,35 @@
 #include <pdevice.hpp>
 #include <support.hpp>
 #include <utils.hpp>
+#include <vksync/framepacing.hpp>
 
 using namespace vtuto;
 
 namespace vtuto {
+/** wall time of each swapchain rebuild and how many also rebuilt the
+ * render pass and the graphics pipeline*/
+struct swapchain_rebuild_stats {
+  uint64_t rebuilds = 0;
+  uint64_t pipeline_rebuilds = 0;
+  double last_us = 0.0;
+  double max_us = 0.0;
+  double total_us = 0.0;
+
+  void add(double us, bool pipeline_rebuilt) {
+    rebuilds++;
+    if (pipeline_rebuilt) {
+      pipeline_rebuilds++;
+    }
+    last_us = us;
+    total_us += us;
+    if (us > max_us) {
+      max_us = us;
+    }
+  }
+  double average_us() const {
+    return rebuilds == 0 ? 0.0 : total_us / rebuilds;
+  }
+};
 //
 class swapchain {
 public:
@@ -31,13 +56,18 @@ public:
   /** swapchain image view */
   image_views simage_views;
 
+  /** present mode picked from the pacing preferences*/
+  VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
+
 public:
   swapchain() {}
   swapchain(
       const vulkan_device<VkPhysicalDevice> &physical_dev,
       vulkan_device<VkDevice> logical_dev,
       GLFWwindow *window,
-      unsigned int image_arr_layers = 1) {
+      unsigned int image_arr_layers = 1,
+      VkSwapchainKHR old_chain = VK_NULL_HANDLE,
+      const frame_pacing_config &pacing = frame_pacing_config()) {
     SwapChainSupportDetails swap_details =
         SwapChainSupportDetails::querySwapChainSupport(
             physical_dev.pdevice, physical_dev.surface);
@@ -46,18 +76,13 @@ public:
         chooseSwapSurfaceFormat(swap_details.formats);
 
     VkPresentModeKHR presentMode =
-        chooseSwapPresentMode(swap_details.present_modes);
+        chooseSwapPresentMode(swap_details.present_modes, pacing);
 
     VkExtent2D extent =
         chooseSwapExtent(swap_details.capabilities, window);
 
     uint32_t img_count =
-        swap_details.capabilities.minImageCount + 1;
-    if (swap_details.capabilities.maxImageCount > 0 &&
-        img_count >
-            swap_details.capabilities.maxImageCount) {
-      img_count = swap_details.capabilities.maxImageCount;
-    }
+        pacing.choose_image_count(swap_details.capabilities);
 
     // Swapchain info details
     VkSwapchainCreateInfoKHR createInfo{};
@@ -99,8 +124,9 @@ public:
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
 
-    // handling of used ressources
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    // handling of used ressources: the old chain is retired by this call
+    // but its images may still be presented, the caller destroys it later
+    createInfo.oldSwapchain = old_chain;
 
     //
     CHECK_VK2(vkCreateSwapchainKHR(logical_dev.device(),
@@ -119,6 +145,7 @@ public:
              "failed to set swapchain images");
     simage_format = surfaceFormat.format;
     sextent = extent;
+    present_mode = presentMode;
     set_image_views(logical_dev);
   }
   void
@@ -140,14 +167,10 @@ public:
     return availables[0];
   }
   VkPresentModeKHR chooseSwapPresentMode(
-      const std::vector<VkPresentModeKHR> &availables) {
-    //
-    for (const auto &apresent : availables) {
-      if (apresent == VK_PRESENT_MODE_MAILBOX_KHR) {
-        return apresent;
-      }
-    }
-    return VK_PRESENT_MODE_FIFO_KHR;
+      const std::vector<VkPresentModeKHR> &availables,
+      const frame_pacing_config &pacing = frame_pacing_config()) {
+    // first preferred mode the surface supports, fifo otherwise
+    return pacing.choose_present_mode(availables);
   }
   VkExtent2D chooseSwapExtent(
       const VkSurfaceCapabilitiesKHR &capabilities,
@@ -184,7 +207,6 @@ public:
       VkPipelineLayout &pipeline_layout,
       std::vector<VkBuffer> &uniform_buffers,
       std::vector<VkDeviceMemory> &uniform_buffer_memories,
-      VkDescriptorPool &descriptor_pool,
       VkImage &depth_image, VkImageView &depth_image_view,
       VkDeviceMemory &depth_image_memory
       ) {
@@ -196,10 +218,12 @@ public:
     vkFreeMemory(logical_dev.device(), depth_image_memory,
                  nullptr);
     //
-    vkFreeCommandBuffers(
-        logical_dev.device(), command_pool,
-        static_cast<uint32_t>(command_buffers.size()),
-        command_buffers.data());
+    if (!command_buffers.empty()) {
+      vkFreeCommandBuffers(
+          logical_dev.device(), command_pool,
+          static_cast<uint32_t>(command_buffers.size()),
+          command_buffers.data());
+    }
 
     for (auto &framebuffer : swapchain_framebuffers) {
       //
@@ -225,9 +249,6 @@ public:
       vkFreeMemory(logical_dev.device(),
                    uniform_buffer_memories[i], nullptr);
     }
-    // 5. destroy descriptor pool
-    vkDestroyDescriptorPool(logical_dev.device(),
-                            descriptor_pool, nullptr);
   }
 };
 }
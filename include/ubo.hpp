@@ -7,3 +7,22 @@ struct UniformBufferObject {
   glm::mat4 view;
   glm::mat4 proj;
 };
+
+/** per draw data recorded with vkCmdPushConstants, no buffer or descriptor
+ * behind it. 80 bytes, inside the 128 every device supports */
+struct DrawPushConstants {
+  glm::mat4 model;
+  uint32_t material_index = 0;
+  uint32_t padding[3] = {0, 0, 0};
+
+  /** stages the range is visible to, every push must name the same */
+  static constexpr VkShaderStageFlags stages =
+      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+  static VkPushConstantRange range() {
+    VkPushConstantRange r{};
+    r.stageFlags = stages;
+    r.offset = 0;
+    r.size = sizeof(DrawPushConstants);
+    return r;
+  }
+};
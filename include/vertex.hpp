@@ -48,6 +48,33 @@ struct Vertex {
   }
 };
 
+/** per instance attributes, read once per instance from binding 1 */
+struct InstanceData {
+  glm::mat4 model;
+
+  static VkVertexInputBindingDescription getBindingDescription() {
+    VkVertexInputBindingDescription description{};
+    description.binding = 1;
+    description.stride = sizeof(InstanceData);
+    description.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    return description;
+  }
+  /** a mat4 attribute takes four locations, one vec4 column each */
+  static std::array<VkVertexInputAttributeDescription, 4>
+  getAttributeDescriptions() {
+    std::array<VkVertexInputAttributeDescription, 4> attributes{};
+    for (uint32_t i = 0; i < 4; i++) {
+      attributes[i].binding = 1;
+      attributes[i].location = 3 + i;
+      attributes[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+      attributes[i].offset =
+          static_cast<uint32_t>(offsetof(InstanceData, model) +
+                                i * sizeof(glm::vec4));
+    }
+    return attributes;
+  }
+};
+
 std::size_t glm_vec_hash(glm::vec2 v) {
   auto h1x_h = std::hash<float>{}(v.x);
   auto h1y_h = std::hash<float>{}(v.y);
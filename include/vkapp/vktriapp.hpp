@@ -13,12 +13,16 @@
 #include <vkqueuefamily/queue.hpp>
 #include <vkswapchain/support.hpp>
 #include <vkswapchain/swapchain.hpp>
+#include <vksync/deletionqueue.hpp>
 // render pass test
 #include <vkrenderpass/vkattachment.hpp>
 #include <vkrenderpass/vksubpass.hpp>
+#include <vkshader/registry.hpp>
+#include <vkshader/vkshadermodule.hpp>
 // utility functions
 #include <vkutils/ioutils.hpp>
 //
+#include <vkpipeline/pipelinecache.hpp>
 #include <vkpipeline/vkinputassembly.hpp>
 #include <vkpipeline/vkvertexinput.hpp>
 
@@ -74,7 +78,7 @@ struct vk_triapp {
     @{
    */
   /** swapchain for handling frame rate*/
-  VkSwapchainKHR chain;
+  VkSwapchainKHR chain = VK_NULL_HANDLE;
 
   /** images in swap chain */
   std::vector<VkImage> simages;
@@ -129,6 +133,15 @@ struct vk_triapp {
 
   VkPipeline graphics_pipeline;
 
+  /** on disk cache the pipeline is created through, saved by destroyAll */
+  pipeline_cache pcache;
+  std::string pcache_path = "./pipeline_cache_graph.bin";
+
+  /** spir-v modules, the pipeline's pair is held until its successor took
+   * its own references */
+  shader_registry shaders;
+  std::array<VkShaderModule, 2> shader_modules{};
+
   /** @} */
 
   /** command pool and command buffer handlers
@@ -214,6 +227,12 @@ struct vk_triapp {
   /** maximum frames in flight*/
   const int MAX_FRAMES_IN_FLIGHT = 2;
 
+  /** objects retired by cleanupSwapChain wait here for their frames */
+  deletion_queue deletions;
+  uint64_t frame_serial = 0;
+  std::vector<uint64_t> frame_serials =
+      std::vector<uint64_t>(MAX_FRAMES_IN_FLIGHT, 0);
+
   /** @} */
 
   /** check framebuffer state*/
@@ -474,7 +493,8 @@ vk_triAppFns() {
     out.signal = 1;
 
     QueueFamilyIndices indices =
-        find_queue_families<VK_QUEUE_GRAPHICS_BIT>(myg.pdevice, myg.surface);
+        find_queue_families<VK_QUEUE_GRAPHICS_BIT, VK_QUEUE_TRANSFER_BIT,
+                            VK_QUEUE_COMPUTE_BIT>(myg.pdevice, myg.surface);
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     auto indice_values = indices.values();
@@ -533,8 +553,25 @@ vk_triAppFns() {
 
     vkGetDeviceQueue(myg.ldevice, graphics_family, 0,
                      &myg.queues[VK_QUEUE_GRAPHICS_BIT]);
+    // transfer and compute fall back to the graphics family
+    uint32_t transfer_family = graphics_family;
+    indices.index<VK_QUEUE_TRANSFER_BIT>(transfer_family);
+    vkGetDeviceQueue(myg.ldevice, transfer_family, 0,
+                     &myg.queues[VK_QUEUE_TRANSFER_BIT]);
+    uint32_t compute_family = graphics_family;
+    indices.index<VK_QUEUE_COMPUTE_BIT>(compute_family);
+    vkGetDeviceQueue(myg.ldevice, compute_family, 0,
+                     &myg.queues[VK_QUEUE_COMPUTE_BIT]);
     vkGetDeviceQueue(myg.ldevice, indices.presentFamily.value(), 0,
                      &myg.present_queue);
+
+    nmsg = "failed to create pipeline cache!";
+    CHECK_VK(myg.pcache.create(myg.pdevice, myg.ldevice, myg.pcache_path,
+                               false),
+             nmsg, out.result_info);
+    if (out.result_info.status != SUCCESS_OP) {
+      out.signal = 0;
+    }
     return out;
   };
   //
@@ -565,6 +602,9 @@ vk_triAppFns() {
         myg.pdevice, myg.surface, myg.window, surfaceFormat, extent,
         imageCount);
 
+    // retire the previous chain, cleanupSwapChain deferred its destruction
+    scinfo.createInfo.oldSwapchain = myg.chain;
+
     std::string nmsg = "failed to create swap chain!";
     CHECK_VK(vkCreateSwapchainKHR(myg.ldevice, &scinfo.createInfo, nullptr,
                                   &myg.chain),
@@ -696,40 +736,39 @@ vk_triAppFns() {
     out.signal = 1;
 
     //
-    auto vertShaderCode = readFile("shaders/triangle/triangle.vert.spv");
-    auto fragShaderCode = readFile("shaders/triangle/triangle.frag.spv");
-
-    VkShaderModule vertShaderModule =
-        ShaderModuleCreateInfoVk vertInfo(vertShaderCode);
-    VkShaderModule vertShaderModule;
-    auto vertCreateInfo = vertInfo.createInfo;
-    if (vkCreateShaderModule(myg.ldevice, &vertCreateInfo, nullptr,
-                             &vertShaderModule) != VK_SUCCESS) {
-      std::cerr << "failed to create vertex shader module!" << std::endl;
-    }
-    VkShaderModule fragShaderModule =
-        ShaderModuleCreateInfoVk fragInfo(fragShaderCode);
-    VkShaderModule fragShaderModule;
-    auto fragCreateInfo = fragInfo.createInfo;
-    if (vkCreateShaderModule(myg.ldevice, &fragCreateInfo, nullptr,
-                             &fragShaderModule) != VK_SUCCESS) {
-      std::cerr << "failed to create vertex shader module!" << std::endl;
+    // mapped on the first build only, rebuilds reuse the modules
+    VkShaderModule vertShaderModule = VK_NULL_HANDLE;
+    std::string smsg = "failed to create vertex shader module!";
+    CHECK_VK(myg.shaders.acquire(myg.ldevice,
+                                 "shaders/triangle/triangle.vert.spv",
+                                 vertShaderModule),
+             smsg, out.result_info);
+    VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+    smsg = "failed to create fragment shader module!";
+    CHECK_VK(myg.shaders.acquire(myg.ldevice,
+                                 "shaders/triangle/triangle.frag.spv",
+                                 fragShaderModule),
+             smsg, out.result_info);
+    if (out.result_info.status != SUCCESS_OP) {
+      myg.shaders.release(myg.ldevice, vertShaderModule);
+      out.signal = 0;
+      return out;
     }
 
-    PipelineShaderStageCreateInfoVk vertSInfo<VK_SHADER_STAGE_VERTEX_BIT>(
-        std::nullopt, // flagrefs
-        std::nullopt, // pname
-        std::nullopt, // special info
-        vertShaderModule);
+    PipelineShaderStageCreateInfoVk vertSInfo(VK_SHADER_STAGE_VERTEX_BIT,
+                                              std::nullopt, // flagrefs
+                                              std::nullopt, // pname
+                                              std::nullopt, // special info
+                                              vertShaderModule);
 
-    PipelineShaderStageCreateInfoVk fragSInfo<VK_SHADER_STAGE_FRAGMENT_BIT>(
-        std::nullopt, // flagrefs
-        std::nullopt, // pname
-        std::nullopt, // special info
-        fragShaderModule)
+    PipelineShaderStageCreateInfoVk fragSInfo(VK_SHADER_STAGE_FRAGMENT_BIT,
+                                              std::nullopt, // flagrefs
+                                              std::nullopt, // pname
+                                              std::nullopt, // special info
+                                              fragShaderModule);
 
-        VkPipelineShaderStageCreateInfo shaderStages[] = {vertSInfo.createInfo,
-                                                          fragSInfo.createInfo};
+    VkPipelineShaderStageCreateInfo shaderStages[] = {vertSInfo.createInfo,
+                                                      fragSInfo.createInfo};
 
     //
     /*
@@ -842,9 +881,8 @@ vk_triAppFns() {
     pipelineInfo.subpass = 0;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
     nmsg = "failed to create graphics pipeline!";
-    CHECK_VK(vkCreateGraphicsPipelines(myg.ldevice, VK_NULL_HANDLE, 1,
-                                       &pipelineInfo, nullptr,
-                                       &myg.graphics_pipeline),
+    CHECK_VK(myg.pcache.create_graphics(myg.ldevice, pipelineInfo,
+                                        &myg.graphics_pipeline),
              nmsg, out.result_info);
 
     if (out.result_info.status != SUCCESS_OP) {
@@ -852,8 +890,10 @@ vk_triAppFns() {
       return out;
     }
 
-    vkDestroyShaderModule(myg.ldevice, fragShaderModule, nullptr);
-    vkDestroyShaderModule(myg.ldevice, vertShaderModule, nullptr);
+    for (VkShaderModule previous : myg.shader_modules) {
+      myg.shaders.release(myg.ldevice, previous);
+    }
+    myg.shader_modules = {vertShaderModule, fragShaderModule};
     return out;
   };
   //
@@ -1089,6 +1129,7 @@ vk_triAppFns() {
     //
     vkWaitForFences(g.ldevice, 1, &g.current_fences[g.current_frame], VK_TRUE,
                     UINT64_MAX);
+    g.deletions.collect(g.frame_serials[g.current_frame]);
 
     uint32_t imageIndex;
     std::string nmsg = "failed to acquire swap chain image!";
@@ -1144,6 +1185,8 @@ vk_triAppFns() {
       out.signal = 0;
       return out;
     }
+    g.frame_serials[g.current_frame] = ++g.frame_serial;
+    g.deletions.submitted(g.frame_serial);
 
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -1186,7 +1229,7 @@ vk_triAppFns() {
       glfwGetFramebufferSize(myg.window, &width, &height);
       glfwWaitEvents();
     }
-    vkDeviceWaitIdle(myg.ldevice);
+    // no device wait, cleanupSwapChain only enqueues the old objects
     //
     Result_Vk vr;
     vr.status = SUCCESS_OP;
@@ -1197,23 +1240,30 @@ vk_triAppFns() {
   };
   // cleanup swap chain
   fm["cleanupSwapChain"] = [](vk_triapp &myg) {
+    VkDevice device = myg.ldevice;
     for (auto framebuffer : myg.swapchain_framebuffers) {
-      vkDestroyFramebuffer(myg.ldevice, framebuffer, nullptr);
+      myg.deletions.destroy(device, framebuffer, vkDestroyFramebuffer);
     }
 
-    vkFreeCommandBuffers(myg.ldevice, myg.pool,
-                         static_cast<uint32_t>(myg.cbuffers.size()),
-                         myg.cbuffers.data());
+    VkCommandPool pool = myg.pool;
+    auto cbuffers = myg.cbuffers;
+    myg.deletions.push([device, pool, cbuffers]() {
+      vkFreeCommandBuffers(device, pool,
+                           static_cast<uint32_t>(cbuffers.size()),
+                           cbuffers.data());
+    });
 
-    vkDestroyPipeline(myg.ldevice, myg.graphics_pipeline, nullptr);
-    vkDestroyPipelineLayout(myg.ldevice, myg.pipeline_layout, nullptr);
-    vkDestroyRenderPass(myg.ldevice, myg.render_pass, nullptr);
+    myg.deletions.destroy(device, myg.graphics_pipeline, vkDestroyPipeline);
+    myg.deletions.destroy(device, myg.pipeline_layout,
+                          vkDestroyPipelineLayout);
+    myg.deletions.destroy(device, myg.render_pass, vkDestroyRenderPass);
 
     for (auto imageView : myg.views) {
-      vkDestroyImageView(myg.ldevice, imageView, nullptr);
+      myg.deletions.destroy(device, imageView, vkDestroyImageView);
     }
 
-    vkDestroySwapchainKHR(myg.ldevice, myg.chain, nullptr);
+    // still passed as oldSwapchain to the next createSwapChain
+    myg.deletions.destroy(device, myg.chain, vkDestroySwapchainKHR);
 
     Result_Vk vr;
     vr.status = SUCCESS_OP;
@@ -1224,7 +1274,7 @@ vk_triAppFns() {
   };
   //
   fm["imagesInFlightResize"] = [](vk_triapp &myg) {
-    myg.images_in_flight.resize(myg.simages.size(), VK_NULL_HANDLE);
+    myg.images_in_flight.assign(myg.simages.size(), VK_NULL_HANDLE);
     Result_Vk vr;
     vr.status = SUCCESS_OP;
     vk_output out;
@@ -1234,6 +1284,8 @@ vk_triAppFns() {
   };
   //
   fm["destroyAll"] = [](vk_triapp &myg) {
+    // windowShouldClose waited for the device
+    myg.deletions.flush();
     for (size_t i = 0; i < myg.MAX_FRAMES_IN_FLIGHT; i++) {
       vkDestroySemaphore(myg.ldevice, myg.render_finished_semaphores[i],
                          nullptr);
@@ -1244,6 +1296,13 @@ vk_triAppFns() {
 
     vkDestroyCommandPool(myg.ldevice, myg.pool, nullptr);
 
+    if (!myg.pcache.save(myg.ldevice)) {
+      std::cerr << "failed to save pipeline cache to " << myg.pcache_path
+                << std::endl;
+    }
+    myg.pcache.report(std::cout);
+    myg.pcache.destroy(myg.ldevice);
+    myg.shaders.destroy(myg.ldevice);
     vkDestroyDevice(myg.ldevice, nullptr);
 
     if (enableValidationLayers) {
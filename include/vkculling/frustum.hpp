@@ -0,0 +1,75 @@
+// view frustum planes and bounding sphere tests
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <external.hpp>
+#include <ubo.hpp>
+
+namespace vtuto {
+
+/**
+  The six planes of a view frustum, xyz is the inward normal and w the
+  distance, so a point p is inside a plane when dot(n, p) + w >= 0. Same
+  layout as the planes the culling compute shader reads.
+ */
+struct frustum {
+  glm::vec4 planes[6];
+};
+
+/**
+  Planes of a view projection matrix (Gribb and Hartmann), in the space the
+  matrix maps from. Depth is vulkan's 0 to w range, a flipped y only swaps
+  the top and bottom planes.
+ */
+inline frustum extract_frustum(const glm::mat4 &m) {
+  // glm is column major, row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+  auto row = [&m](int i) {
+    return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+  };
+  frustum f;
+  f.planes[0] = row(3) + row(0); // left
+  f.planes[1] = row(3) - row(0); // right
+  f.planes[2] = row(3) + row(1); // bottom
+  f.planes[3] = row(3) - row(1); // top
+  f.planes[4] = row(2);          // near
+  f.planes[5] = row(3) - row(2); // far
+  for (auto &p : f.planes) {
+    p /= glm::length(glm::vec3(p));
+  }
+  return f;
+}
+/** world space planes of the camera a uniform buffer describes */
+inline frustum extract_frustum(const UniformBufferObject &ubo) {
+  return extract_frustum(ubo.proj * ubo.view);
+}
+
+/**
+  sphere is xyz center and w radius. The far plane is the last one, a
+  plane_count of 5 leaves it out as the culling shader does when built
+  with farPlane false.
+ */
+inline bool sphere_visible(const frustum &f, const glm::vec4 &sphere,
+                           int plane_count = 6) {
+  for (int i = 0; i < plane_count; i++) {
+    const glm::vec4 &p = f.planes[i];
+    if (glm::dot(glm::vec3(p), glm::vec3(sphere)) + p.w < -sphere.w) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** write the indices of the visible spheres to visible, returns how many */
+inline std::size_t cull_spheres(const frustum &f, const glm::vec4 *spheres,
+                                std::size_t count, uint32_t *visible,
+                                int plane_count = 6) {
+  std::size_t n = 0;
+  for (std::size_t i = 0; i < count; i++) {
+    if (sphere_visible(f, spheres[i], plane_count)) {
+      visible[n++] = static_cast<uint32_t>(i);
+    }
+  }
+  return n;
+}
+
+} // namespace vtuto
@@ -0,0 +1,88 @@
+// per object culling into indirect draw commands
+#pragma once
+#include <cstdint>
+#include <external.hpp>
+#include <vkculling/frustum.hpp>
+
+namespace vtuto {
+
+/** who decides which objects are drawn */
+enum class cull_mode {
+  /** every instance is drawn by one instanced draw */
+  none,
+  /** the cpu tests the bounds and writes the indirect commands */
+  cpu,
+  /** a compute pass writes the commands and their count */
+  gpu
+};
+
+inline const char *to_string(cull_mode m) {
+  switch (m) {
+  case cull_mode::none:
+    return "none";
+  case cull_mode::cpu:
+    return "cpu";
+  case cull_mode::gpu:
+    return "gpu";
+  }
+  return "none";
+}
+
+/** uniform block of the culling shader, std140 */
+struct cull_params {
+  glm::vec4 planes[6];
+  uint32_t object_count = 0;
+  /** the indexed draw each visible object gets */
+  uint32_t index_count = 0;
+  uint32_t first_index = 0;
+  int32_t vertex_offset = 0;
+};
+
+/**
+  Compiled into the culling shader as specialization constants: the
+  workgroup size and whether the far plane is tested are fixed per
+  pipeline instead of read from the uniform block every invocation.
+ */
+struct cull_shader_constants {
+  /** constant_id 0, local_size_x_id of the shader */
+  uint32_t workgroup_size = 64;
+  /** constant_id 1, VK_FALSE for an infinite far plane */
+  VkBool32 far_plane = VK_TRUE;
+};
+
+/** buffers the culling of one swapchain image reads and writes */
+struct cull_buffers {
+  VkBuffer params = VK_NULL_HANDLE;
+  VkDeviceMemory params_memory = VK_NULL_HANDLE;
+  cull_params *params_mapped = nullptr;
+  /** xyz center and w radius per object, gpu mode only */
+  VkBuffer bounds = VK_NULL_HANDLE;
+  VkDeviceMemory bounds_memory = VK_NULL_HANDLE;
+  glm::vec4 *bounds_mapped = nullptr;
+  /** VkDrawIndexedIndirectCommand per object, mapped in cpu mode only */
+  VkBuffer commands = VK_NULL_HANDLE;
+  VkDeviceMemory commands_memory = VK_NULL_HANDLE;
+  VkDrawIndexedIndirectCommand *commands_mapped = nullptr;
+  /** draw count written by the compute pass, host visible for readback */
+  VkBuffer count = VK_NULL_HANDLE;
+  VkDeviceMemory count_memory = VK_NULL_HANDLE;
+  uint32_t *count_mapped = nullptr;
+  /** instance version the bounds were written at, 0 for never */
+  uint64_t bounds_version = 0;
+  /** frustum and object count the last submit of this image used */
+  frustum culled_with{};
+  uint32_t culled_objects = 0;
+  bool submitted = false;
+};
+
+/** visible counts read back from the gpu, or counted on the cpu */
+struct cull_stats {
+  uint64_t frames = 0;
+  uint32_t last_objects = 0;
+  uint32_t last_visible = 0;
+  /** readbacks that disagreed with the cpu reference */
+  uint64_t mismatches = 0;
+  uint64_t verified = 0;
+};
+
+} // namespace vtuto
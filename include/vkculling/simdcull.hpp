@@ -0,0 +1,310 @@
+// frustum tests over structure of arrays bounds, four or eight at a time
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <vector>
+#include <vkculling/frustum.hpp>
+#include <vkthread/threadpool.hpp>
+#include <vkutils/simd.hpp>
+
+namespace vtuto {
+
+/** bounding spheres, one array per component */
+struct sphere_soa {
+  std::vector<float> x, y, z, r;
+
+  std::size_t size() const { return x.size(); }
+  void resize(std::size_t n) {
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+    r.resize(n);
+  }
+  /** s is xyz center and w radius */
+  void set(std::size_t i, const glm::vec4 &s) {
+    x[i] = s.x;
+    y[i] = s.y;
+    z[i] = s.z;
+    r[i] = s.w;
+  }
+};
+
+/** axis aligned boxes as center and half extent, one array per component */
+struct aabb_soa {
+  std::vector<float> cx, cy, cz, ex, ey, ez;
+
+  std::size_t size() const { return cx.size(); }
+  void resize(std::size_t n) {
+    for (auto *v : {&cx, &cy, &cz, &ex, &ey, &ez}) {
+      v->resize(n);
+    }
+  }
+  void set(std::size_t i, const glm::vec3 &lo, const glm::vec3 &hi) {
+    cx[i] = 0.5f * (lo.x + hi.x);
+    cy[i] = 0.5f * (lo.y + hi.y);
+    cz[i] = 0.5f * (lo.z + hi.z);
+    ex[i] = 0.5f * (hi.x - lo.x);
+    ey[i] = 0.5f * (hi.y - lo.y);
+    ez[i] = 0.5f * (hi.z - lo.z);
+  }
+};
+
+/*
+  Every kernel evaluates d = (nx * x + ny * y) + (nz * z + w) in the same
+  order so the scalar, sse and avx2 paths agree bit for bit. A sphere is
+  kept when d + r >= 0 for all six planes, a box when d plus its extent
+  projected on the normal is.
+ */
+
+/** append base + k for every set bit k of the lane mask, without branches */
+inline std::size_t emit_visible(unsigned mask, unsigned lanes,
+                                std::size_t base, uint32_t *out) {
+  std::size_t n = 0;
+  for (unsigned k = 0; k < lanes; k++) {
+    out[n] = static_cast<uint32_t>(base + k);
+    n += (mask >> k) & 1u;
+  }
+  return n;
+}
+
+inline std::size_t cull_range_scalar(const frustum &f, const sphere_soa &s,
+                                     std::size_t first, std::size_t last,
+                                     uint32_t *visible) {
+  std::size_t n = 0;
+  for (std::size_t i = first; i < last; i++) {
+    bool inside = true;
+    for (const auto &p : f.planes) {
+      float d = (p.x * s.x[i] + p.y * s.y[i]) + (p.z * s.z[i] + p.w);
+      inside = inside && (d + s.r[i] >= 0.0f);
+    }
+    visible[n] = static_cast<uint32_t>(i);
+    n += inside ? 1 : 0;
+  }
+  return n;
+}
+inline std::size_t cull_range_scalar(const frustum &f, const aabb_soa &b,
+                                     std::size_t first, std::size_t last,
+                                     uint32_t *visible) {
+  std::size_t n = 0;
+  for (std::size_t i = first; i < last; i++) {
+    bool inside = true;
+    for (const auto &p : f.planes) {
+      float d = (p.x * b.cx[i] + p.y * b.cy[i]) + (p.z * b.cz[i] + p.w);
+      float e = (std::abs(p.x) * b.ex[i] + std::abs(p.y) * b.ey[i]) +
+                std::abs(p.z) * b.ez[i];
+      inside = inside && (d + e >= 0.0f);
+    }
+    visible[n] = static_cast<uint32_t>(i);
+    n += inside ? 1 : 0;
+  }
+  return n;
+}
+
+#ifdef VTUTO_SIMD_X86
+__attribute__((target("sse2"))) inline std::size_t
+cull_range_sse(const frustum &f, const sphere_soa &s, std::size_t first,
+               std::size_t last, uint32_t *visible) {
+  __m128 nx[6], ny[6], nz[6], nw[6];
+  for (int p = 0; p < 6; p++) {
+    nx[p] = _mm_set1_ps(f.planes[p].x);
+    ny[p] = _mm_set1_ps(f.planes[p].y);
+    nz[p] = _mm_set1_ps(f.planes[p].z);
+    nw[p] = _mm_set1_ps(f.planes[p].w);
+  }
+  const __m128 zero = _mm_setzero_ps();
+  std::size_t n = 0;
+  std::size_t i = first;
+  for (; i + 4 <= last; i += 4) {
+    __m128 x = _mm_loadu_ps(&s.x[i]);
+    __m128 y = _mm_loadu_ps(&s.y[i]);
+    __m128 z = _mm_loadu_ps(&s.z[i]);
+    __m128 r = _mm_loadu_ps(&s.r[i]);
+    __m128 inside = _mm_cmpeq_ps(zero, zero);
+    for (int p = 0; p < 6; p++) {
+      __m128 d =
+          _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], x), _mm_mul_ps(ny[p], y)),
+                     _mm_add_ps(_mm_mul_ps(nz[p], z), nw[p]));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), zero));
+    }
+    n += emit_visible(static_cast<unsigned>(_mm_movemask_ps(inside)), 4, i,
+                      visible + n);
+  }
+  return n + cull_range_scalar(f, s, i, last, visible + n);
+}
+__attribute__((target("sse2"))) inline std::size_t
+cull_range_sse(const frustum &f, const aabb_soa &b, std::size_t first,
+               std::size_t last, uint32_t *visible) {
+  __m128 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+  for (int p = 0; p < 6; p++) {
+    nx[p] = _mm_set1_ps(f.planes[p].x);
+    ny[p] = _mm_set1_ps(f.planes[p].y);
+    nz[p] = _mm_set1_ps(f.planes[p].z);
+    nw[p] = _mm_set1_ps(f.planes[p].w);
+    ax[p] = _mm_set1_ps(std::abs(f.planes[p].x));
+    ay[p] = _mm_set1_ps(std::abs(f.planes[p].y));
+    az[p] = _mm_set1_ps(std::abs(f.planes[p].z));
+  }
+  const __m128 zero = _mm_setzero_ps();
+  std::size_t n = 0;
+  std::size_t i = first;
+  for (; i + 4 <= last; i += 4) {
+    __m128 cx = _mm_loadu_ps(&b.cx[i]);
+    __m128 cy = _mm_loadu_ps(&b.cy[i]);
+    __m128 cz = _mm_loadu_ps(&b.cz[i]);
+    __m128 ex = _mm_loadu_ps(&b.ex[i]);
+    __m128 ey = _mm_loadu_ps(&b.ey[i]);
+    __m128 ez = _mm_loadu_ps(&b.ez[i]);
+    __m128 inside = _mm_cmpeq_ps(zero, zero);
+    for (int p = 0; p < 6; p++) {
+      __m128 d =
+          _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)),
+                     _mm_add_ps(_mm_mul_ps(nz[p], cz), nw[p]));
+      __m128 e =
+          _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)),
+                     _mm_mul_ps(az[p], ez));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, e), zero));
+    }
+    n += emit_visible(static_cast<unsigned>(_mm_movemask_ps(inside)), 4, i,
+                      visible + n);
+  }
+  return n + cull_range_scalar(f, b, i, last, visible + n);
+}
+__attribute__((target("avx2"))) inline std::size_t
+cull_range_avx2(const frustum &f, const sphere_soa &s, std::size_t first,
+                std::size_t last, uint32_t *visible) {
+  __m256 nx[6], ny[6], nz[6], nw[6];
+  for (int p = 0; p < 6; p++) {
+    nx[p] = _mm256_set1_ps(f.planes[p].x);
+    ny[p] = _mm256_set1_ps(f.planes[p].y);
+    nz[p] = _mm256_set1_ps(f.planes[p].z);
+    nw[p] = _mm256_set1_ps(f.planes[p].w);
+  }
+  const __m256 zero = _mm256_setzero_ps();
+  std::size_t n = 0;
+  std::size_t i = first;
+  for (; i + 8 <= last; i += 8) {
+    __m256 x = _mm256_loadu_ps(&s.x[i]);
+    __m256 y = _mm256_loadu_ps(&s.y[i]);
+    __m256 z = _mm256_loadu_ps(&s.z[i]);
+    __m256 r = _mm256_loadu_ps(&s.r[i]);
+    __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+    for (int p = 0; p < 6; p++) {
+      __m256 d = _mm256_add_ps(
+          _mm256_add_ps(_mm256_mul_ps(nx[p], x), _mm256_mul_ps(ny[p], y)),
+          _mm256_add_ps(_mm256_mul_ps(nz[p], z), nw[p]));
+      inside = _mm256_and_ps(
+          inside, _mm256_cmp_ps(_mm256_add_ps(d, r), zero, _CMP_GE_OQ));
+    }
+    n += emit_visible(static_cast<unsigned>(_mm256_movemask_ps(inside)), 8,
+                      i, visible + n);
+  }
+  return n + cull_range_scalar(f, s, i, last, visible + n);
+}
+__attribute__((target("avx2"))) inline std::size_t
+cull_range_avx2(const frustum &f, const aabb_soa &b, std::size_t first,
+                std::size_t last, uint32_t *visible) {
+  __m256 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+  for (int p = 0; p < 6; p++) {
+    nx[p] = _mm256_set1_ps(f.planes[p].x);
+    ny[p] = _mm256_set1_ps(f.planes[p].y);
+    nz[p] = _mm256_set1_ps(f.planes[p].z);
+    nw[p] = _mm256_set1_ps(f.planes[p].w);
+    ax[p] = _mm256_set1_ps(std::abs(f.planes[p].x));
+    ay[p] = _mm256_set1_ps(std::abs(f.planes[p].y));
+    az[p] = _mm256_set1_ps(std::abs(f.planes[p].z));
+  }
+  const __m256 zero = _mm256_setzero_ps();
+  std::size_t n = 0;
+  std::size_t i = first;
+  for (; i + 8 <= last; i += 8) {
+    __m256 cx = _mm256_loadu_ps(&b.cx[i]);
+    __m256 cy = _mm256_loadu_ps(&b.cy[i]);
+    __m256 cz = _mm256_loadu_ps(&b.cz[i]);
+    __m256 ex = _mm256_loadu_ps(&b.ex[i]);
+    __m256 ey = _mm256_loadu_ps(&b.ey[i]);
+    __m256 ez = _mm256_loadu_ps(&b.ez[i]);
+    __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+    for (int p = 0; p < 6; p++) {
+      __m256 d = _mm256_add_ps(
+          _mm256_add_ps(_mm256_mul_ps(nx[p], cx), _mm256_mul_ps(ny[p], cy)),
+          _mm256_add_ps(_mm256_mul_ps(nz[p], cz), nw[p]));
+      __m256 e = _mm256_add_ps(
+          _mm256_add_ps(_mm256_mul_ps(ax[p], ex), _mm256_mul_ps(ay[p], ey)),
+          _mm256_mul_ps(az[p], ez));
+      inside = _mm256_and_ps(
+          inside, _mm256_cmp_ps(_mm256_add_ps(d, e), zero, _CMP_GE_OQ));
+    }
+    n += emit_visible(static_cast<unsigned>(_mm256_movemask_ps(inside)), 8,
+                      i, visible + n);
+  }
+  return n + cull_range_scalar(f, b, i, last, visible + n);
+}
+#endif
+
+/**
+  Write the indices in [first, last) of the bounds inside the frustum to
+  visible, in increasing order, and return how many there are. visible
+  needs room for last - first entries. An isa the cpu lacks falls back to
+  scalar.
+ */
+template <class Bounds>
+std::size_t cull_range(const frustum &f, const Bounds &bounds,
+                       std::size_t first, std::size_t last, uint32_t *visible,
+                       simd_isa isa = best_simd_isa()) {
+#ifdef VTUTO_SIMD_X86
+  if (isa == simd_isa::avx2 && simd_supported(isa)) {
+    return cull_range_avx2(f, bounds, first, last, visible);
+  }
+  if (isa == simd_isa::sse && simd_supported(isa)) {
+    return cull_range_sse(f, bounds, first, last, visible);
+  }
+#endif
+  return cull_range_scalar(f, bounds, first, last, visible);
+}
+
+/**
+  Cull every bound, in chunks on the pool when there are enough of them.
+
+  Each chunk writes its indices at its own offset in visible, which must
+  hold bounds.size() entries, then the chunks are packed to the front in
+  order. The result is the same as a serial cull_range.
+ */
+template <class Bounds>
+std::size_t cull_parallel(thread_pool &pool, const frustum &f,
+                          const Bounds &bounds, uint32_t *visible,
+                          simd_isa isa = best_simd_isa(),
+                          std::size_t min_chunk = 16 * 1024) {
+  const std::size_t count = bounds.size();
+  if (pool.size() < 2 || count < 2 * min_chunk) {
+    return cull_range(f, bounds, 0, count, visible, isa);
+  }
+  // a few chunks per worker so a slow one does not hold the rest back,
+  // whole simd blocks in each
+  std::size_t chunk = (count + 4 * pool.size() - 1) / (4 * pool.size());
+  chunk = (std::max(chunk, min_chunk) + 7) & ~std::size_t(7);
+  std::vector<std::future<std::size_t>> found;
+  for (std::size_t first = 0; first < count; first += chunk) {
+    std::size_t last = std::min(first + chunk, count);
+    found.push_back(pool.submit([&f, &bounds, visible, isa, first,
+                                 last](std::size_t) {
+      return cull_range(f, bounds, first, last, visible + first, isa);
+    }));
+  }
+  std::size_t n = 0;
+  std::size_t first = 0;
+  for (auto &chunk_found : found) {
+    std::size_t k = chunk_found.get();
+    if (n != first) {
+      std::memmove(visible + n, visible + first, k * sizeof(uint32_t));
+    }
+    n += k;
+    first += chunk;
+  }
+  return n;
+}
+
+} // namespace vtuto
@@ -0,0 +1,207 @@
+// descriptor sets from a chain of pools that grows when one runs out
+#pragma once
+#include <external.hpp>
+#include <ostream>
+
+namespace vtuto {
+
+/** descriptors of one type a pool holds per set it can allocate */
+struct descriptor_pool_ratio {
+  VkDescriptorType type;
+  float per_set;
+};
+
+/** allocation traffic and pool churn of a descriptor_allocator */
+struct descriptor_allocator_stats {
+  uint64_t sets_allocated = 0;
+  uint64_t pools_created = 0;
+  /** pools that ran out and made the allocator move on to the next */
+  uint64_t pools_exhausted = 0;
+  /** pools reset as a whole, by reset() or recycle() */
+  uint64_t pools_reset = 0;
+  /** pools handed out by detach() */
+  uint64_t pools_detached = 0;
+  /** pools owned now, in use and free */
+  std::size_t pools_live = 0;
+};
+
+/**
+  Allocates descriptor sets of any layout from pools it creates itself.
+
+  Sets are taken from the current pool until it reports
+  VK_ERROR_OUT_OF_POOL_MEMORY or VK_ERROR_FRAGMENTED_POOL; the pool is then
+  put aside as full and the allocation retried from a recycled pool or a
+  new one, each new pool twice the size of the last up to max_sets. Pools
+  are sized by ratio, descriptors per set by type, so nothing has to know
+  the layouts in advance.
+
+  Sets are never freed one by one. reset() returns every set at once, for
+  allocators whose sets live a frame. Sets that live longer, e.g. as long
+  as a swapchain, are retired with detach(): the allocator starts over on
+  fresh pools while the detached ones are recycle()d once no frame uses
+  their sets anymore.
+ */
+class descriptor_allocator {
+  std::vector<descriptor_pool_ratio> ratios;
+  uint32_t next_sets = 0;
+  uint32_t max_sets = 0;
+  VkDescriptorPool current = VK_NULL_HANDLE;
+  /** exhausted or partly used pools, reset together */
+  std::vector<VkDescriptorPool> used;
+  /** reset and ready */
+  std::vector<VkDescriptorPool> free_pools;
+  descriptor_allocator_stats counters;
+
+  VkResult create_pool(VkDevice device, VkDescriptorPool &pool) {
+    std::vector<VkDescriptorPoolSize> sizes;
+    for (const auto &r : ratios) {
+      VkDescriptorPoolSize s{};
+      s.type = r.type;
+      s.descriptorCount =
+          std::max<uint32_t>(1, static_cast<uint32_t>(r.per_set * next_sets));
+      sizes.push_back(s);
+    }
+    VkDescriptorPoolCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    info.maxSets = next_sets;
+    info.poolSizeCount = static_cast<uint32_t>(sizes.size());
+    info.pPoolSizes = sizes.data();
+    VkResult r = vkCreateDescriptorPool(device, &info, nullptr, &pool);
+    if (r == VK_SUCCESS) {
+      counters.pools_created++;
+      counters.pools_live++;
+      next_sets = std::min(next_sets * 2, max_sets);
+    }
+    return r;
+  }
+  VkResult next_pool(VkDevice device) {
+    if (current != VK_NULL_HANDLE) {
+      used.push_back(current);
+      current = VK_NULL_HANDLE;
+    }
+    if (!free_pools.empty()) {
+      current = free_pools.back();
+      free_pools.pop_back();
+      return VK_SUCCESS;
+    }
+    return create_pool(device, current);
+  }
+
+public:
+  descriptor_allocator() {}
+
+  /**
+    What a pool holds per set and how many sets the first pool gets.
+    Only affects pools created from now on.
+   */
+  void init(const std::vector<descriptor_pool_ratio> &pool_ratios,
+            uint32_t first_sets, uint32_t most_sets = 4096) {
+    ratios = pool_ratios;
+    max_sets = std::max<uint32_t>(most_sets, 1);
+    next_sets = std::min(std::max<uint32_t>(first_sets, 1), max_sets);
+  }
+
+  VkResult allocate(VkDevice device, VkDescriptorSetLayout layout,
+                    VkDescriptorSet &set) {
+    if (current == VK_NULL_HANDLE) {
+      VkResult r = next_pool(device);
+      if (r != VK_SUCCESS) {
+        return r;
+      }
+    }
+    VkDescriptorSetAllocateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    info.descriptorPool = current;
+    info.descriptorSetCount = 1;
+    info.pSetLayouts = &layout;
+    VkResult r = vkAllocateDescriptorSets(device, &info, &set);
+    if (r == VK_ERROR_OUT_OF_POOL_MEMORY || r == VK_ERROR_FRAGMENTED_POOL) {
+      counters.pools_exhausted++;
+      r = next_pool(device);
+      if (r != VK_SUCCESS) {
+        return r;
+      }
+      info.descriptorPool = current;
+      r = vkAllocateDescriptorSets(device, &info, &set);
+    }
+    if (r == VK_SUCCESS) {
+      counters.sets_allocated++;
+    }
+    return r;
+  }
+  /** one set per layout, stops at the first failure */
+  VkResult allocate(VkDevice device, const VkDescriptorSetLayout *layouts,
+                    std::size_t count, VkDescriptorSet *sets) {
+    for (std::size_t i = 0; i < count; i++) {
+      VkResult r = allocate(device, layouts[i], sets[i]);
+      if (r != VK_SUCCESS) {
+        return r;
+      }
+    }
+    return VK_SUCCESS;
+  }
+
+  /** every set allocated so far becomes invalid, the pools are kept */
+  void reset(VkDevice device) {
+    if (current != VK_NULL_HANDLE) {
+      used.push_back(current);
+      current = VK_NULL_HANDLE;
+    }
+    for (VkDescriptorPool pool : used) {
+      vkResetDescriptorPool(device, pool, 0);
+      counters.pools_reset++;
+      free_pools.push_back(pool);
+    }
+    used.clear();
+  }
+  /**
+    The pools holding the sets allocated so far, taken out of the
+    allocator. Give them back with recycle() once their sets are unused.
+   */
+  std::vector<VkDescriptorPool> detach() {
+    std::vector<VkDescriptorPool> pools;
+    pools.swap(used);
+    if (current != VK_NULL_HANDLE) {
+      pools.push_back(current);
+      current = VK_NULL_HANDLE;
+    }
+    counters.pools_detached += pools.size();
+    counters.pools_live -= pools.size();
+    return pools;
+  }
+  /** reset detached pools and keep them for later allocations */
+  void recycle(VkDevice device, const std::vector<VkDescriptorPool> &pools) {
+    for (VkDescriptorPool pool : pools) {
+      vkResetDescriptorPool(device, pool, 0);
+      counters.pools_reset++;
+      counters.pools_live++;
+      free_pools.push_back(pool);
+    }
+  }
+  /** detached pools not recycled yet are the caller's */
+  void destroy(VkDevice device) {
+    if (current != VK_NULL_HANDLE) {
+      used.push_back(current);
+      current = VK_NULL_HANDLE;
+    }
+    for (auto *pools : {&used, &free_pools}) {
+      for (VkDescriptorPool pool : *pools) {
+        vkDestroyDescriptorPool(device, pool, nullptr);
+      }
+      counters.pools_live -= pools->size();
+      pools->clear();
+    }
+  }
+  const descriptor_allocator_stats &stats() const { return counters; }
+  void report(std::ostream &out, const std::string &name) const {
+    const std::string p = "descriptors." + name;
+    out << p << ".sets_allocated " << counters.sets_allocated << std::endl;
+    out << p << ".pools_created " << counters.pools_created << std::endl;
+    out << p << ".pools_exhausted " << counters.pools_exhausted << std::endl;
+    out << p << ".pools_reset " << counters.pools_reset << std::endl;
+    out << p << ".pools_detached " << counters.pools_detached << std::endl;
+    out << p << ".pools_live " << counters.pools_live << std::endl;
+  }
+};
+
+} // namespace vtuto
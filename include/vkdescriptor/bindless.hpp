@@ -0,0 +1,230 @@
+// one descriptor array holding every texture, indexed from the shaders
+#pragma once
+#include <algorithm>
+#include <external.hpp>
+#include <ostream>
+
+namespace vtuto {
+
+/**
+  Indices into a table of fixed capacity. Released indices are handed out
+  again before the table grows into unused ones, so the part of the table
+  in use stays dense.
+ */
+class slot_allocator {
+  uint32_t slot_capacity = 0;
+  /** slots below this were handed out at least once */
+  uint32_t high_water = 0;
+  std::vector<uint32_t> free_slots;
+
+public:
+  slot_allocator() {}
+  explicit slot_allocator(uint32_t capacity) : slot_capacity(capacity) {}
+
+  /** false when every slot is taken */
+  bool acquire(uint32_t &slot) {
+    if (!free_slots.empty()) {
+      slot = free_slots.back();
+      free_slots.pop_back();
+      return true;
+    }
+    if (high_water == slot_capacity) {
+      return false;
+    }
+    slot = high_water++;
+    return true;
+  }
+  void release(uint32_t slot) { free_slots.push_back(slot); }
+  uint32_t capacity() const { return slot_capacity; }
+  uint32_t in_use() const {
+    return high_water - static_cast<uint32_t>(free_slots.size());
+  }
+  uint32_t high_water_mark() const { return high_water; }
+};
+
+/**
+  Every texture in one COMBINED_IMAGE_SAMPLER array, bound once per command
+  buffer as its own set. Draws pick their texture by slot, passed in the
+  push constants, instead of binding a set per material.
+
+  The binding is PARTIALLY_BOUND, so slots never written are fine as long
+  as no draw samples them, and UPDATE_AFTER_BIND, so adding a texture does
+  not invalidate recorded command buffers that bind the set. Where the
+  device also allows updating unused descriptors while pending, textures
+  can be added while frames are in flight; otherwise only while the device
+  is idle. A slot given back with remove() may be reused by the next add(),
+  so remove it only once no frame in flight samples it.
+ */
+class bindless_texture_table {
+  VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+  VkDescriptorPool pool = VK_NULL_HANDLE;
+  VkDescriptorSet table = VK_NULL_HANDLE;
+  slot_allocator slots;
+  uint64_t added = 0;
+  uint64_t removed = 0;
+  uint64_t rejected = 0;
+
+public:
+  static constexpr uint32_t binding = 0;
+
+  /** what the table needs from descriptor indexing, core in vulkan 1.2 */
+  static bool supported(const VkPhysicalDeviceVulkan12Features &f) {
+    return f.descriptorIndexing && f.runtimeDescriptorArray &&
+           f.descriptorBindingPartiallyBound &&
+           f.descriptorBindingSampledImageUpdateAfterBind;
+  }
+  /** turn on what the table uses, if the device has all of it */
+  static bool enable(const VkPhysicalDeviceVulkan12Features &supported12,
+                     VkPhysicalDeviceVulkan12Features &enabled12) {
+    if (!supported(supported12)) {
+      return false;
+    }
+    enabled12.descriptorIndexing = VK_TRUE;
+    enabled12.runtimeDescriptorArray = VK_TRUE;
+    enabled12.descriptorBindingPartiallyBound = VK_TRUE;
+    enabled12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    enabled12.descriptorBindingUpdateUnusedWhilePending =
+        supported12.descriptorBindingUpdateUnusedWhilePending;
+    return true;
+  }
+  /** wanted, or less when the device limits update after bind sets */
+  static uint32_t device_capacity(VkPhysicalDevice pdev, uint32_t wanted) {
+    VkPhysicalDeviceDescriptorIndexingProperties indexing{};
+    indexing.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+    VkPhysicalDeviceProperties2 props{};
+    props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    props.pNext = &indexing;
+    vkGetPhysicalDeviceProperties2(pdev, &props);
+    // a combined image sampler counts as a sampler and a sampled image
+    return std::min({wanted,
+                     indexing.maxPerStageDescriptorUpdateAfterBindSamplers,
+                     indexing.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                     indexing.maxDescriptorSetUpdateAfterBindSamplers,
+                     indexing.maxDescriptorSetUpdateAfterBindSampledImages});
+  }
+
+  bindless_texture_table() {}
+
+  /** layout, pool and the single set, visible to the fragment stage */
+  VkResult create(VkDevice device, uint32_t capacity,
+                  const VkPhysicalDeviceVulkan12Features &enabled12) {
+    VkDescriptorSetLayoutBinding b{};
+    b.binding = binding;
+    b.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    b.descriptorCount = capacity;
+    b.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorBindingFlags flags =
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+    if (enabled12.descriptorBindingUpdateUnusedWhilePending) {
+      flags |= VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    }
+    VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags{};
+    binding_flags.sType =
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    binding_flags.bindingCount = 1;
+    binding_flags.pBindingFlags = &flags;
+
+    // binding flags are not part of a descriptor_layout_key, the table
+    // owns its layout
+    VkDescriptorSetLayoutCreateInfo linfo{};
+    linfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    linfo.pNext = &binding_flags;
+    linfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    linfo.bindingCount = 1;
+    linfo.pBindings = &b;
+    VkResult r =
+        vkCreateDescriptorSetLayout(device, &linfo, nullptr, &set_layout);
+    if (r != VK_SUCCESS) {
+      return r;
+    }
+
+    VkDescriptorPoolSize size{};
+    size.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    size.descriptorCount = capacity;
+    VkDescriptorPoolCreateInfo pinfo{};
+    pinfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pinfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    pinfo.maxSets = 1;
+    pinfo.poolSizeCount = 1;
+    pinfo.pPoolSizes = &size;
+    r = vkCreateDescriptorPool(device, &pinfo, nullptr, &pool);
+    if (r != VK_SUCCESS) {
+      destroy(device);
+      return r;
+    }
+
+    VkDescriptorSetAllocateInfo ainfo{};
+    ainfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    ainfo.descriptorPool = pool;
+    ainfo.descriptorSetCount = 1;
+    ainfo.pSetLayouts = &set_layout;
+    r = vkAllocateDescriptorSets(device, &ainfo, &table);
+    if (r != VK_SUCCESS) {
+      destroy(device);
+      return r;
+    }
+    slots = slot_allocator(capacity);
+    return VK_SUCCESS;
+  }
+  bool valid() const { return table != VK_NULL_HANDLE; }
+  VkDescriptorSetLayout layout() const { return set_layout; }
+  VkDescriptorSet set() const { return table; }
+
+  /**
+    Write view and sampler to a free slot, the index draws pass to the
+    shader. VK_ERROR_TOO_MANY_OBJECTS when the table is full.
+   */
+  VkResult add(VkDevice device, VkImageView view, VkSampler sampler,
+               uint32_t &slot) {
+    if (!slots.acquire(slot)) {
+      rejected++;
+      return VK_ERROR_TOO_MANY_OBJECTS;
+    }
+    VkDescriptorImageInfo image{};
+    image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    image.imageView = view;
+    image.sampler = sampler;
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = table;
+    write.dstBinding = binding;
+    write.dstArrayElement = slot;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.descriptorCount = 1;
+    write.pImageInfo = &image;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    added++;
+    return VK_SUCCESS;
+  }
+  /** the descriptor stays until the slot is reused, nothing is written */
+  void remove(uint32_t slot) {
+    slots.release(slot);
+    removed++;
+  }
+  void destroy(VkDevice device) {
+    // the set goes with its pool
+    if (pool != VK_NULL_HANDLE) {
+      vkDestroyDescriptorPool(device, pool, nullptr);
+    }
+    if (set_layout != VK_NULL_HANDLE) {
+      vkDestroyDescriptorSetLayout(device, set_layout, nullptr);
+    }
+    pool = VK_NULL_HANDLE;
+    set_layout = VK_NULL_HANDLE;
+    table = VK_NULL_HANDLE;
+    slots = slot_allocator();
+  }
+  void report(std::ostream &out) const {
+    out << "bindless.capacity " << slots.capacity() << std::endl;
+    out << "bindless.in_use " << slots.in_use() << std::endl;
+    out << "bindless.high_water " << slots.high_water_mark() << std::endl;
+    out << "bindless.added " << added << std::endl;
+    out << "bindless.removed " << removed << std::endl;
+    out << "bindless.rejected " << rejected << std::endl;
+  }
+};
+
+} // namespace vtuto
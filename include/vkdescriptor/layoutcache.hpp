@@ -0,0 +1,112 @@
+// descriptor set layouts created once per distinct set of bindings
+#pragma once
+#include <algorithm>
+#include <external.hpp>
+#include <ostream>
+#include <vkpipeline/pipelinestate.hpp>
+
+namespace vtuto {
+
+/**
+  The bindings of a set layout in canonical form, sorted by binding so the
+  order they were listed in does not matter.
+ */
+struct descriptor_layout_key {
+  std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+  descriptor_layout_key() {}
+  descriptor_layout_key(const VkDescriptorSetLayoutBinding *b,
+                        std::size_t count)
+      : bindings(b, b + count) {
+    std::sort(bindings.begin(), bindings.end(),
+              [](const VkDescriptorSetLayoutBinding &x,
+                 const VkDescriptorSetLayoutBinding &y) {
+                return x.binding < y.binding;
+              });
+  }
+  uint64_t hash() const {
+    state_hasher s;
+    s.add(static_cast<uint64_t>(bindings.size()));
+    for (const auto &b : bindings) {
+      s.add(static_cast<uint64_t>(b.binding));
+      s.add(static_cast<uint64_t>(b.descriptorType));
+      s.add(static_cast<uint64_t>(b.descriptorCount));
+      s.add(static_cast<uint64_t>(b.stageFlags));
+      s.add_handle(b.pImmutableSamplers);
+    }
+    return s.h;
+  }
+  bool operator==(const descriptor_layout_key &o) const {
+    return std::equal(bindings.begin(), bindings.end(), o.bindings.begin(),
+                      o.bindings.end(),
+                      [](const VkDescriptorSetLayoutBinding &x,
+                         const VkDescriptorSetLayoutBinding &y) {
+                        return x.binding == y.binding &&
+                               x.descriptorType == y.descriptorType &&
+                               x.descriptorCount == y.descriptorCount &&
+                               x.stageFlags == y.stageFlags &&
+                               x.pImmutableSamplers == y.pImmutableSamplers;
+                      });
+  }
+};
+
+struct descriptor_layout_key_hash {
+  std::size_t operator()(const descriptor_layout_key &k) const {
+    return static_cast<std::size_t>(k.hash());
+  }
+};
+
+/**
+  VkDescriptorSetLayouts by their bindings.
+
+  Asking twice for the same bindings gives the same handle, which is also
+  what makes pipeline layouts and graphics_pipeline_desc built from them
+  compare equal. The cache owns every layout it returned, they go with
+  destroy().
+ */
+class descriptor_layout_cache {
+  std::unordered_map<descriptor_layout_key, VkDescriptorSetLayout,
+                     descriptor_layout_key_hash>
+      layouts;
+  uint64_t hit_count = 0;
+  uint64_t miss_count = 0;
+
+public:
+  descriptor_layout_cache() {}
+
+  VkResult get(VkDevice device, const VkDescriptorSetLayoutBinding *bindings,
+               std::size_t count, VkDescriptorSetLayout &layout) {
+    descriptor_layout_key key(bindings, count);
+    auto it = layouts.find(key);
+    if (it != layouts.end()) {
+      hit_count++;
+      layout = it->second;
+      return VK_SUCCESS;
+    }
+    VkDescriptorSetLayoutCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    info.bindingCount = static_cast<uint32_t>(key.bindings.size());
+    info.pBindings = key.bindings.data();
+    VkResult r = vkCreateDescriptorSetLayout(device, &info, nullptr, &layout);
+    if (r != VK_SUCCESS) {
+      return r;
+    }
+    miss_count++;
+    layouts.emplace(std::move(key), layout);
+    return VK_SUCCESS;
+  }
+  std::size_t size() const { return layouts.size(); }
+  void destroy(VkDevice device) {
+    for (auto &kv : layouts) {
+      vkDestroyDescriptorSetLayout(device, kv.second, nullptr);
+    }
+    layouts.clear();
+  }
+  void report(std::ostream &out) const {
+    out << "descriptor_layouts.size " << layouts.size() << std::endl;
+    out << "descriptor_layouts.hits " << hit_count << std::endl;
+    out << "descriptor_layouts.misses " << miss_count << std::endl;
+  }
+};
+
+} // namespace vtuto
@@ -1,5 +1,6 @@
 #pragma once
 // device
+#include <cstring>
 #include <external.hpp>
 #include <vkqueuefamily/index.hpp>
 #include <vkqueuefamily/queue.hpp>
@@ -20,6 +21,21 @@ get_physical_device_extensions(VkPhysicalDevice device) {
                                        availableExtensions.data());
   return availableExtensions;
 }
+/**
+  Fill the given vector with the device extensions.
+
+  The vector is only resized, so a caller that keeps it around between
+  suitability checks does not allocate once it is large enough.
+ */
+void get_physical_device_extensions(
+    VkPhysicalDevice device, std::vector<VkExtensionProperties> &exts) {
+  uint32_t extensionCount = 0;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       nullptr);
+  exts.resize(extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       exts.data());
+}
 
 struct extension_comp {
   bool operator()(const VkExtensionProperties &p1,
@@ -31,6 +47,9 @@ struct extension_comp {
 template <std::size_t N> struct PhysicalDeviceExtensionQuery {
   std::array<VkExtensionProperties, N> extension_props;
 
+  /** reused between is_supported calls */
+  std::vector<VkExtensionProperties> available_props;
+
   PhysicalDeviceExtensionQuery(const std::array<VkExtensionProperties, N> &exts)
       : extension_props(exts) {}
 
@@ -41,17 +60,16 @@ template <std::size_t N> struct PhysicalDeviceExtensionQuery {
     must be the same
    */
   bool is_supported(VkPhysicalDevice device) {
-    auto exts = get_physical_device_extensions(device);
+    get_physical_device_extensions(device, available_props);
     bool has_support = true;
     for (const auto &name : extension_props) {
       bool has_name = false;
-      for (const auto &extension : exts) {
-        // string conversion is needed for comparing const char* with const
-        // char[]
-        auto ext_name = std::string(extension.extensionName);
-        auto ename = std::string(name.extensionName);
-        if (ename == ext_name) {
+      for (const auto &extension : available_props) {
+        // both are null terminated char arrays, compare in place instead of
+        // building two std::string per pair
+        if (std::strcmp(name.extensionName, extension.extensionName) == 0) {
           has_name = true;
+          break;
         }
       }
       if (!has_name) {
@@ -0,0 +1,108 @@
+// samplers created once per distinct sampler state
+#pragma once
+#include <external.hpp>
+#include <ostream>
+#include <vkpipeline/pipelinestate.hpp>
+
+namespace vtuto {
+
+/** every field of a VkSamplerCreateInfo but sType and pNext */
+struct sampler_key {
+  VkSamplerCreateInfo info{};
+
+  sampler_key() {}
+  explicit sampler_key(const VkSamplerCreateInfo &i) : info(i) {
+    info.pNext = nullptr;
+  }
+  uint64_t hash() const {
+    state_hasher s;
+    s.add(static_cast<uint64_t>(info.flags));
+    s.add(static_cast<uint64_t>(info.magFilter));
+    s.add(static_cast<uint64_t>(info.minFilter));
+    s.add(static_cast<uint64_t>(info.mipmapMode));
+    s.add(static_cast<uint64_t>(info.addressModeU));
+    s.add(static_cast<uint64_t>(info.addressModeV));
+    s.add(static_cast<uint64_t>(info.addressModeW));
+    s.add(info.mipLodBias);
+    s.add(static_cast<uint64_t>(info.anisotropyEnable));
+    s.add(info.maxAnisotropy);
+    s.add(static_cast<uint64_t>(info.compareEnable));
+    s.add(static_cast<uint64_t>(info.compareOp));
+    s.add(info.minLod);
+    s.add(info.maxLod);
+    s.add(static_cast<uint64_t>(info.borderColor));
+    s.add(static_cast<uint64_t>(info.unnormalizedCoordinates));
+    return s.h;
+  }
+  bool operator==(const sampler_key &o) const {
+    const VkSamplerCreateInfo &a = info;
+    const VkSamplerCreateInfo &b = o.info;
+    return a.flags == b.flags && a.magFilter == b.magFilter &&
+           a.minFilter == b.minFilter && a.mipmapMode == b.mipmapMode &&
+           a.addressModeU == b.addressModeU &&
+           a.addressModeV == b.addressModeV &&
+           a.addressModeW == b.addressModeW && a.mipLodBias == b.mipLodBias &&
+           a.anisotropyEnable == b.anisotropyEnable &&
+           a.maxAnisotropy == b.maxAnisotropy &&
+           a.compareEnable == b.compareEnable && a.compareOp == b.compareOp &&
+           a.minLod == b.minLod && a.maxLod == b.maxLod &&
+           a.borderColor == b.borderColor &&
+           a.unnormalizedCoordinates == b.unnormalizedCoordinates;
+  }
+};
+
+struct sampler_key_hash {
+  std::size_t operator()(const sampler_key &k) const {
+    return static_cast<std::size_t>(k.hash());
+  }
+};
+
+/**
+  VkSamplers by their create info.
+
+  Samplers do not belong to an image, textures sampled the same way share
+  one, so the number of samplers follows the number of distinct sampler
+  states however many textures there are. The cache owns them all until
+  destroy().
+ */
+class sampler_cache {
+  std::unordered_map<sampler_key, VkSampler, sampler_key_hash> samplers;
+  uint64_t hit_count = 0;
+  uint64_t miss_count = 0;
+
+public:
+  sampler_cache() {}
+
+  /** pNext chains are not part of the key, info must not have one */
+  VkResult get(VkDevice device, const VkSamplerCreateInfo &info,
+               VkSampler &sampler) {
+    sampler_key key(info);
+    auto it = samplers.find(key);
+    if (it != samplers.end()) {
+      hit_count++;
+      sampler = it->second;
+      return VK_SUCCESS;
+    }
+    VkResult r = vkCreateSampler(device, &info, nullptr, &sampler);
+    if (r != VK_SUCCESS) {
+      return r;
+    }
+    miss_count++;
+    samplers.emplace(key, sampler);
+    return VK_SUCCESS;
+  }
+  std::size_t size() const { return samplers.size(); }
+  void destroy(VkDevice device) {
+    for (auto &kv : samplers) {
+      vkDestroySampler(device, kv.second, nullptr);
+    }
+    samplers.clear();
+  }
+  void report(std::ostream &out) const {
+    out << "samplers.size " << samplers.size() << std::endl;
+    out << "samplers.hits " << hit_count << std::endl;
+    out << "samplers.misses " << miss_count << std::endl;
+  }
+};
+
+} // namespace vtuto
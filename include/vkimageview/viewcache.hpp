@@ -0,0 +1,149 @@
+// image views created once per image and view description
+#pragma once
+#include <external.hpp>
+#include <ostream>
+#include <vkpipeline/pipelinestate.hpp>
+
+namespace vtuto {
+
+/**
+  What makes two views of an image the same view. Swizzles naming their
+  own channel are stored as IDENTITY, which is what they mean.
+ */
+struct image_view_key {
+  VkImage image = VK_NULL_HANDLE;
+  VkImageViewCreateFlags flags = 0;
+  VkImageViewType view_type = VK_IMAGE_VIEW_TYPE_2D;
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  VkComponentMapping components{};
+  VkImageSubresourceRange range{};
+
+  image_view_key() {}
+  explicit image_view_key(const VkImageViewCreateInfo &info)
+      : image(info.image), flags(info.flags), view_type(info.viewType),
+        format(info.format), components(info.components),
+        range(info.subresourceRange) {
+    auto identity = [](VkComponentSwizzle &s, VkComponentSwizzle own) {
+      if (s == own) {
+        s = VK_COMPONENT_SWIZZLE_IDENTITY;
+      }
+    };
+    identity(components.r, VK_COMPONENT_SWIZZLE_R);
+    identity(components.g, VK_COMPONENT_SWIZZLE_G);
+    identity(components.b, VK_COMPONENT_SWIZZLE_B);
+    identity(components.a, VK_COMPONENT_SWIZZLE_A);
+  }
+  uint64_t hash() const {
+    state_hasher s;
+    s.add_handle(image);
+    s.add(static_cast<uint64_t>(flags));
+    s.add(static_cast<uint64_t>(view_type));
+    s.add(static_cast<uint64_t>(format));
+    s.add(static_cast<uint64_t>(components.r));
+    s.add(static_cast<uint64_t>(components.g));
+    s.add(static_cast<uint64_t>(components.b));
+    s.add(static_cast<uint64_t>(components.a));
+    s.add(static_cast<uint64_t>(range.aspectMask));
+    s.add(static_cast<uint64_t>(range.baseMipLevel));
+    s.add(static_cast<uint64_t>(range.levelCount));
+    s.add(static_cast<uint64_t>(range.baseArrayLayer));
+    s.add(static_cast<uint64_t>(range.layerCount));
+    return s.h;
+  }
+  bool operator==(const image_view_key &o) const {
+    return image == o.image && flags == o.flags &&
+           view_type == o.view_type && format == o.format &&
+           components.r == o.components.r && components.g == o.components.g &&
+           components.b == o.components.b && components.a == o.components.a &&
+           range.aspectMask == o.range.aspectMask &&
+           range.baseMipLevel == o.range.baseMipLevel &&
+           range.levelCount == o.range.levelCount &&
+           range.baseArrayLayer == o.range.baseArrayLayer &&
+           range.layerCount == o.range.layerCount;
+  }
+};
+
+struct image_view_key_hash {
+  std::size_t operator()(const image_view_key &k) const {
+    return static_cast<std::size_t>(k.hash());
+  }
+};
+
+/**
+  VkImageViews by image and view description.
+
+  Asking twice for the same view of an image gives the same handle, so the
+  number of views follows the number of distinct views rather than the
+  number of places asking. Views are never destroyed one by one, they go
+  with their image: release() takes every view of an image out of the
+  cache for the caller to destroy, right away or through the deletion
+  queue, before the image itself. Handles of destroyed images may be
+  reused by the driver, so an image must be released before it goes.
+ */
+class image_view_cache {
+  std::unordered_map<image_view_key, VkImageView, image_view_key_hash> views;
+  /** what release() has to find */
+  std::unordered_map<VkImage, std::vector<VkImageView>> by_image;
+  uint64_t hit_count = 0;
+  uint64_t miss_count = 0;
+  uint64_t released_count = 0;
+
+public:
+  image_view_cache() {}
+
+  /** pNext chains are not part of the key, info must not have one */
+  VkResult get(VkDevice device, const VkImageViewCreateInfo &info,
+               VkImageView &view) {
+    image_view_key key(info);
+    auto it = views.find(key);
+    if (it != views.end()) {
+      hit_count++;
+      view = it->second;
+      return VK_SUCCESS;
+    }
+    VkResult r = vkCreateImageView(device, &info, nullptr, &view);
+    if (r != VK_SUCCESS) {
+      return r;
+    }
+    miss_count++;
+    views.emplace(key, view);
+    by_image[info.image].push_back(view);
+    return VK_SUCCESS;
+  }
+  /** every view of image, no longer in the cache and the caller's */
+  std::vector<VkImageView> release(VkImage image) {
+    std::vector<VkImageView> released;
+    auto it = by_image.find(image);
+    if (it == by_image.end()) {
+      return released;
+    }
+    released.swap(it->second);
+    by_image.erase(it);
+    for (auto v = views.begin(); v != views.end();) {
+      if (v->first.image == image) {
+        v = views.erase(v);
+      } else {
+        ++v;
+      }
+    }
+    released_count += released.size();
+    return released;
+  }
+  std::size_t size() const { return views.size(); }
+  void destroy(VkDevice device) {
+    for (auto &kv : views) {
+      vkDestroyImageView(device, kv.second, nullptr);
+    }
+    views.clear();
+    by_image.clear();
+  }
+  void report(std::ostream &out) const {
+    out << "image_views.size " << views.size() << std::endl;
+    out << "image_views.images " << by_image.size() << std::endl;
+    out << "image_views.hits " << hit_count << std::endl;
+    out << "image_views.misses " << miss_count << std::endl;
+    out << "image_views.released " << released_count << std::endl;
+  }
+};
+
+} // namespace vtuto
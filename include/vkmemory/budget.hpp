@@ -0,0 +1,260 @@
+// device memory accounting per heap and per usage category
+#pragma once
+#include <external.hpp>
+#include <iomanip>
+#include <ostream>
+
+namespace vtuto {
+
+/** what a device memory allocation is used for */
+enum class memory_category : uint32_t {
+  staging = 0,
+  geometry,
+  texture,
+  uniform,
+  attachment,
+  other,
+  count
+};
+
+inline const char *to_string(memory_category c) {
+  switch (c) {
+  case memory_category::staging:
+    return "staging";
+  case memory_category::geometry:
+    return "geometry";
+  case memory_category::texture:
+    return "texture";
+  case memory_category::uniform:
+    return "uniform";
+  case memory_category::attachment:
+    return "attachment";
+  default:
+    return "other";
+  }
+}
+
+const std::size_t MEMORY_CATEGORY_COUNT =
+    static_cast<std::size_t>(memory_category::count);
+
+/** bytes and live allocation count of a heap or a category */
+struct memory_usage {
+  VkDeviceSize bytes = 0;
+  uint32_t allocations = 0;
+  VkDeviceSize peak_bytes = 0;
+};
+
+/**
+  Heap budget as reported by the driver.
+
+  When VK_EXT_memory_budget is not enabled budget falls back to the heap
+  size and usage to what this process has tracked, so callers can use the
+  same numbers either way.
+ */
+struct heap_budget {
+  VkDeviceSize size = 0;
+  VkDeviceSize budget = 0;
+  VkDeviceSize usage = 0;
+  bool device_local = false;
+};
+
+/**
+  Fragmentation related statistics.
+
+  Every resource owns a dedicated VkDeviceMemory, so there is no internal
+  fragmentation to measure. What can hurt is the number of allocations
+  (drivers cap it at maxMemoryAllocationCount and large counts fragment the
+  driver's own heaps) and allocations much smaller than the driver's
+  allocation granularity, which waste the rest of a page.
+ */
+struct memory_fragmentation_stats {
+  uint32_t live_allocations = 0;
+  uint32_t max_allocations = 0;
+  uint32_t small_allocations = 0;
+  VkDeviceSize small_allocation_bytes = 0;
+  uint64_t total_allocations = 0;
+  uint64_t total_frees = 0;
+  /** live_allocations / max_allocations */
+  double allocation_pressure = 0.0;
+  /** share of live allocations below the small allocation threshold */
+  double small_allocation_ratio = 0.0;
+};
+
+class memory_tracker {
+  struct allocation_record {
+    VkDeviceSize size;
+    uint32_t heap_index;
+    memory_category category;
+  };
+
+  VkPhysicalDevice pdevice = VK_NULL_HANDLE;
+  VkPhysicalDeviceMemoryProperties mem_props{};
+  uint32_t max_allocations = 0;
+  bool budget_ext = false;
+
+  std::unordered_map<VkDeviceMemory, allocation_record> live;
+  std::array<memory_usage, VK_MAX_MEMORY_HEAPS> heaps{};
+  std::array<memory_usage, MEMORY_CATEGORY_COUNT> categories{};
+  uint64_t total_allocations = 0;
+  uint64_t total_frees = 0;
+
+public:
+  /** allocations below this size count as small in the statistics */
+  VkDeviceSize small_allocation_threshold = 64 * 1024;
+
+  memory_tracker() {}
+  memory_tracker(VkPhysicalDevice pdev, bool has_budget_extension)
+      : pdevice(pdev), budget_ext(has_budget_extension) {
+    vkGetPhysicalDeviceMemoryProperties(pdev, &mem_props);
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(pdev, &props);
+    max_allocations = props.limits.maxMemoryAllocationCount;
+  }
+
+  /** record a successful vkAllocateMemory */
+  void track(VkDeviceMemory memory, VkDeviceSize size, uint32_t type_index,
+             memory_category category) {
+    uint32_t heap_index = mem_props.memoryTypes[type_index].heapIndex;
+    live[memory] = allocation_record{size, heap_index, category};
+    add(heaps[heap_index], size);
+    add(categories[static_cast<std::size_t>(category)], size);
+    total_allocations++;
+  }
+  /** record a vkFreeMemory, must be called before the handle is freed */
+  void release(VkDeviceMemory memory) {
+    auto it = live.find(memory);
+    if (it == live.end()) {
+      return;
+    }
+    const allocation_record &rec = it->second;
+    remove(heaps[rec.heap_index], rec.size);
+    remove(categories[static_cast<std::size_t>(rec.category)], rec.size);
+    live.erase(it);
+    total_frees++;
+  }
+
+  const memory_usage &heap_usage(uint32_t heap_index) const {
+    return heaps[heap_index];
+  }
+  const memory_usage &category_usage(memory_category c) const {
+    return categories[static_cast<std::size_t>(c)];
+  }
+  uint32_t heap_count() const { return mem_props.memoryHeapCount; }
+  bool has_budget_extension() const { return budget_ext; }
+
+  /** query budget and usage of every heap */
+  std::vector<heap_budget> query_budget() const {
+    std::vector<heap_budget> budgets(mem_props.memoryHeapCount);
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_props{};
+    budget_props.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    if (budget_ext) {
+      VkPhysicalDeviceMemoryProperties2 props2{};
+      props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+      props2.pNext = &budget_props;
+      vkGetPhysicalDeviceMemoryProperties2(pdevice, &props2);
+    }
+    for (uint32_t i = 0; i < mem_props.memoryHeapCount; i++) {
+      heap_budget &b = budgets[i];
+      b.size = mem_props.memoryHeaps[i].size;
+      b.device_local =
+          (mem_props.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) !=
+          0;
+      if (budget_ext) {
+        b.budget = budget_props.heapBudget[i];
+        b.usage = budget_props.heapUsage[i];
+      } else {
+        b.budget = b.size;
+        b.usage = heaps[i].bytes;
+      }
+    }
+    return budgets;
+  }
+
+  memory_fragmentation_stats fragmentation() const {
+    memory_fragmentation_stats stats;
+    stats.live_allocations = static_cast<uint32_t>(live.size());
+    stats.max_allocations = max_allocations;
+    stats.total_allocations = total_allocations;
+    stats.total_frees = total_frees;
+    for (const auto &kv : live) {
+      if (kv.second.size < small_allocation_threshold) {
+        stats.small_allocations++;
+        stats.small_allocation_bytes += kv.second.size;
+      }
+    }
+    if (max_allocations > 0) {
+      stats.allocation_pressure =
+          static_cast<double>(stats.live_allocations) / max_allocations;
+    }
+    if (stats.live_allocations > 0) {
+      stats.small_allocation_ratio =
+          static_cast<double>(stats.small_allocations) /
+          stats.live_allocations;
+    }
+    return stats;
+  }
+
+  /** write every metric as "name value" lines */
+  void report(std::ostream &out) const {
+    auto budgets = query_budget();
+    for (uint32_t i = 0; i < budgets.size(); i++) {
+      const heap_budget &b = budgets[i];
+      out << "memory.heap." << i << ".size " << b.size << std::endl;
+      out << "memory.heap." << i << ".budget " << b.budget << std::endl;
+      out << "memory.heap." << i << ".usage " << b.usage << std::endl;
+      out << "memory.heap." << i << ".tracked " << heaps[i].bytes
+          << std::endl;
+      out << "memory.heap." << i << ".tracked_peak " << heaps[i].peak_bytes
+          << std::endl;
+      out << "memory.heap." << i << ".allocations " << heaps[i].allocations
+          << std::endl;
+    }
+    for (std::size_t c = 0; c < MEMORY_CATEGORY_COUNT; c++) {
+      const char *name = to_string(static_cast<memory_category>(c));
+      out << "memory.category." << name << ".bytes " << categories[c].bytes
+          << std::endl;
+      out << "memory.category." << name << ".peak "
+          << categories[c].peak_bytes << std::endl;
+      out << "memory.category." << name << ".allocations "
+          << categories[c].allocations << std::endl;
+    }
+    auto frag = fragmentation();
+    out << "memory.fragmentation.live_allocations " << frag.live_allocations
+        << std::endl;
+    out << "memory.fragmentation.max_allocations " << frag.max_allocations
+        << std::endl;
+    out << "memory.fragmentation.small_allocations " << frag.small_allocations
+        << std::endl;
+    out << "memory.fragmentation.small_allocation_bytes "
+        << frag.small_allocation_bytes << std::endl;
+    out << "memory.fragmentation.total_allocations " << frag.total_allocations
+        << std::endl;
+    out << "memory.fragmentation.total_frees " << frag.total_frees
+        << std::endl;
+    auto flags = out.flags();
+    auto precision = out.precision();
+    out << std::fixed << std::setprecision(6)
+        << "memory.fragmentation.allocation_pressure "
+        << frag.allocation_pressure << std::endl
+        << "memory.fragmentation.small_allocation_ratio "
+        << frag.small_allocation_ratio << std::endl;
+    out.flags(flags);
+    out.precision(precision);
+  }
+
+private:
+  static void add(memory_usage &u, VkDeviceSize size) {
+    u.bytes += size;
+    u.allocations++;
+    if (u.bytes > u.peak_bytes) {
+      u.peak_bytes = u.bytes;
+    }
+  }
+  static void remove(memory_usage &u, VkDeviceSize size) {
+    u.bytes -= size;
+    u.allocations--;
+  }
+};
+
+} // namespace vtuto
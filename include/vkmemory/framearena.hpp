@@ -0,0 +1,185 @@
+// frame scoped linear allocator for transient cpu side vulkan structs
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace vtuto {
+
+/**
+  Allocation statistics of a frame arena.
+
+  heap_allocations only grows when the arena has to request a new block from
+  the system allocator. Once the arena has seen the peak usage of a frame it
+  must stay constant: a frame that makes it grow did call operator new.
+ */
+struct frame_arena_stats {
+  std::size_t heap_allocations = 0;
+  std::size_t block_count = 0;
+  std::size_t reserved_bytes = 0;
+  std::size_t used_bytes = 0;
+  std::size_t high_water_bytes = 0;
+  std::size_t resets = 0;
+};
+
+/**
+  Bump allocator whose memory is recycled at frame boundaries.
+
+  Memory is handed out linearly from a list of blocks. Nothing is freed
+  individually, reset() rewinds the arena to its first block and keeps every
+  block around, so after a few frames the arena serves each request without
+  touching the heap. Objects placed in the arena must be trivially
+  destructible since no destructor is ever run for them, which holds for
+  every Vk*Info/Vk*Barrier struct.
+ */
+class frame_arena {
+  struct block {
+    std::unique_ptr<unsigned char[]> data;
+    std::size_t size = 0;
+  };
+  std::vector<block> blocks;
+  std::size_t block_index = 0;
+  std::size_t offset = 0;
+  std::size_t block_size = 0;
+  frame_arena_stats fstats;
+
+public:
+  explicit frame_arena(std::size_t initial_block_size = 64 * 1024)
+      : block_size(initial_block_size) {}
+
+  frame_arena(const frame_arena &) = delete;
+  frame_arena &operator=(const frame_arena &) = delete;
+  frame_arena(frame_arena &&) = default;
+  frame_arena &operator=(frame_arena &&) = default;
+
+  /** raw aligned allocation, valid until the next reset() */
+  void *allocate(std::size_t bytes,
+                 std::size_t alignment = alignof(std::max_align_t)) {
+    if (bytes == 0) {
+      bytes = 1;
+    }
+    while (block_index < blocks.size()) {
+      block &b = blocks[block_index];
+      std::size_t aligned = align_up(b.data.get(), offset, alignment);
+      if (aligned + bytes <= b.size) {
+        offset = aligned + bytes;
+        mark_used(bytes);
+        return b.data.get() + aligned;
+      }
+      // does not fit the rest of this block, try the next one
+      block_index++;
+      offset = 0;
+    }
+    add_block(bytes + alignment);
+    return allocate(bytes, alignment);
+  }
+
+  /** allocate n value initialized objects of a trivially destructible type */
+  template <class T> T *alloc_array(std::size_t n) {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "frame arena never runs destructors");
+    T *ptr = static_cast<T *>(allocate(sizeof(T) * n, alignof(T)));
+    for (std::size_t i = 0; i < n; i++) {
+      new (ptr + i) T{};
+    }
+    return ptr;
+  }
+
+  /** rewind to the first block, every previous allocation becomes invalid */
+  void reset() {
+    block_index = 0;
+    offset = 0;
+    fstats.used_bytes = 0;
+    fstats.resets++;
+  }
+
+  /** drop every block, used when the frame count changes */
+  void release() {
+    blocks.clear();
+    reset();
+    fstats.block_count = 0;
+    fstats.reserved_bytes = 0;
+  }
+
+  const frame_arena_stats &stats() const { return fstats; }
+
+private:
+  static std::size_t align_up(const unsigned char *base, std::size_t off,
+                              std::size_t alignment) {
+    auto addr = reinterpret_cast<std::uintptr_t>(base) + off;
+    auto aligned = (addr + alignment - 1) & ~(alignment - 1);
+    return off + static_cast<std::size_t>(aligned - addr);
+  }
+  void mark_used(std::size_t bytes) {
+    fstats.used_bytes += bytes;
+    if (fstats.used_bytes > fstats.high_water_bytes) {
+      fstats.high_water_bytes = fstats.used_bytes;
+    }
+  }
+  void add_block(std::size_t min_size) {
+    // grow geometrically so a frame that overflows settles in a few frames
+    std::size_t size = blocks.empty() ? block_size : blocks.back().size * 2;
+    while (size < min_size) {
+      size *= 2;
+    }
+    block b;
+    b.data.reset(new unsigned char[size]);
+    b.size = size;
+    blocks.push_back(std::move(b));
+    block_index = blocks.size() - 1;
+    offset = 0;
+    fstats.heap_allocations++;
+    fstats.block_count = blocks.size();
+    fstats.reserved_bytes += size;
+  }
+};
+
+/**
+  STL allocator adaptor over a frame arena.
+
+  deallocate is a no-op, the memory is reclaimed when the arena is reset.
+  Containers using it must not outlive the frame they were created in, and
+  should reserve() up front since every growth step leaves the old storage
+  behind until the reset.
+ */
+template <class T> class arena_allocator {
+public:
+  typedef T value_type;
+  frame_arena *arena;
+
+  explicit arena_allocator(frame_arena &a) noexcept : arena(&a) {}
+  template <class U>
+  arena_allocator(const arena_allocator<U> &other) noexcept
+      : arena(other.arena) {}
+
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(arena->allocate(sizeof(T) * n, alignof(T)));
+  }
+  void deallocate(T *, std::size_t) noexcept {}
+
+  template <class U> struct rebind { typedef arena_allocator<U> other; };
+};
+
+template <class T, class U>
+bool operator==(const arena_allocator<T> &a, const arena_allocator<U> &b) {
+  return a.arena == b.arena;
+}
+template <class T, class U>
+bool operator!=(const arena_allocator<T> &a, const arena_allocator<U> &b) {
+  return !(a == b);
+}
+
+template <class T> using arena_vector = std::vector<T, arena_allocator<T>>;
+
+/** make an empty arena backed vector with room for n elements */
+template <class T>
+arena_vector<T> make_arena_vector(frame_arena &arena, std::size_t n = 0) {
+  arena_vector<T> vs{arena_allocator<T>(arena)};
+  vs.reserve(n);
+  return vs;
+}
+
+} // namespace vtuto
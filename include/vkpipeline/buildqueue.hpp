@@ -0,0 +1,218 @@
+// graphics pipelines compiled on worker threads, draws never wait for them
+#pragma once
+#include <chrono>
+#include <external.hpp>
+#include <future>
+#include <mutex>
+#include <ostream>
+#include <vkpipeline/pipelinestate.hpp>
+#include <vkthread/threadpool.hpp>
+
+namespace vtuto {
+
+/** what the build queue did since it was bound */
+struct pipeline_build_stats {
+  uint64_t requested = 0;
+  uint64_t built = 0;
+  uint64_t failed = 0;
+  /** draws that got the registered fallback or nothing at all */
+  uint64_t fallbacks = 0;
+  uint64_t skipped = 0;
+  /** summed over workers, compare with the wall time of a batch */
+  double build_us = 0.0;
+};
+
+/**
+  Builds graphics pipelines on a thread pool.
+
+  request() queues a description and returns a future of its pipeline, the
+  same future to everyone asking while it compiles. Finished pipelines go
+  into the graphics_pipeline_library, which keeps owning them. Every worker
+  compiles against the one pipeline_cache: vkCreateGraphicsPipelines
+  synchronizes the cache itself, so the workers share what the others
+  compiled without a lock held across the driver call.
+
+  A frame asks with ready_or_fallback() instead, which never blocks: a
+  pipeline still compiling is replaced by the fallback registered for its
+  description, and without one the draw is meant to be skipped. With no
+  pool, or a pool without workers, requests are built on the caller.
+ */
+class pipeline_build_queue {
+  VkDevice device = VK_NULL_HANDLE;
+  pipeline_cache *cache = nullptr;
+  graphics_pipeline_library *library = nullptr;
+  thread_pool *pool = nullptr;
+
+  std::mutex mtx;
+  std::unordered_map<graphics_pipeline_desc, std::shared_future<VkPipeline>,
+                     graphics_pipeline_desc_hash>
+      pending;
+  std::unordered_map<graphics_pipeline_desc, VkPipeline,
+                     graphics_pipeline_desc_hash>
+      fallbacks;
+  /** descriptions whose build failed, not retried every frame */
+  std::unordered_map<graphics_pipeline_desc, VkResult,
+                     graphics_pipeline_desc_hash>
+      failures;
+  pipeline_build_stats counters;
+
+  /** runs on a worker or inline, never with mtx held */
+  VkPipeline build(const graphics_pipeline_desc &d) {
+    auto start = std::chrono::steady_clock::now();
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult r = graphics_pipeline_library::build(device, *cache, d, pipeline);
+    std::chrono::duration<double, std::micro> took =
+        std::chrono::steady_clock::now() - start;
+    std::lock_guard<std::mutex> lock(mtx);
+    pending.erase(d);
+    counters.build_us += took.count();
+    if (r != VK_SUCCESS) {
+      counters.failed++;
+      failures[d] = r;
+      throw std::runtime_error("failed to build queued graphics pipeline");
+    }
+    counters.built++;
+    library->add(d, pipeline);
+    return pipeline;
+  }
+  static std::shared_future<VkPipeline> ready(VkPipeline pipeline) {
+    std::promise<VkPipeline> done;
+    done.set_value(pipeline);
+    return done.get_future().share();
+  }
+  /** count_hit is false once the caller started the build itself */
+  VkPipeline ready_or_fallback(const graphics_pipeline_desc &d,
+                               bool count_hit) {
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (count_hit ? library->find(d, pipeline)
+                    : library->lookup(d, pipeline)) {
+        return pipeline;
+      }
+      bool started = pending.count(d) > 0 || failures.count(d) > 0;
+      if (started) {
+        auto fb = fallbacks.find(d);
+        if (fb != fallbacks.end()) {
+          counters.fallbacks++;
+          return fb->second;
+        }
+        counters.skipped++;
+        return VK_NULL_HANDLE;
+      }
+    }
+    request(d);
+    // an inline build may already be done, that is a miss not a hit
+    return ready_or_fallback(d, false);
+  }
+
+public:
+  pipeline_build_queue() {}
+  pipeline_build_queue(const pipeline_build_queue &) = delete;
+  pipeline_build_queue &operator=(const pipeline_build_queue &) = delete;
+
+  /** pool may be null, the others must outlive the queue */
+  void bind(VkDevice dev, pipeline_cache &shared_cache,
+            graphics_pipeline_library &lib, thread_pool *workers) {
+    device = dev;
+    cache = &shared_cache;
+    library = &lib;
+    pool = workers;
+  }
+
+  /** the pipeline of d, from the library, an ongoing build or a new one */
+  std::shared_future<VkPipeline> request(const graphics_pipeline_desc &d) {
+    std::unique_lock<std::mutex> lock(mtx);
+    VkPipeline built = VK_NULL_HANDLE;
+    if (library->find(d, built)) {
+      return ready(built);
+    }
+    auto known = pending.find(d);
+    if (known != pending.end()) {
+      return known->second;
+    }
+    counters.requested++;
+    failures.erase(d);
+    if (pool == nullptr || pool->size() == 0) {
+      lock.unlock();
+      std::packaged_task<VkPipeline()> task([this, d]() { return build(d); });
+      std::shared_future<VkPipeline> result = task.get_future().share();
+      task();
+      return result;
+    }
+    // registered before the worker can finish and erase it, the worker
+    // takes mtx first
+    std::shared_future<VkPipeline> result =
+        pool->submit([this, d](std::size_t) { return build(d); }).share();
+    pending.emplace(d, result);
+    return result;
+  }
+
+  /**
+    Hand a pipeline built elsewhere, e.g. by a shader reload, to the
+    library. When an equal description is already there that one is
+    returned and pipeline, never used, is destroyed.
+   */
+  VkPipeline adopt(const graphics_pipeline_desc &d, VkPipeline pipeline) {
+    std::lock_guard<std::mutex> lock(mtx);
+    VkPipeline known = VK_NULL_HANDLE;
+    if (library->lookup(d, known)) {
+      if (known != pipeline) {
+        vkDestroyPipeline(device, pipeline, nullptr);
+      }
+      return known;
+    }
+    library->add(d, pipeline);
+    return pipeline;
+  }
+  /** take d's pipeline out of the library, the caller destroys it */
+  VkPipeline retire(const graphics_pipeline_desc &d) {
+    std::lock_guard<std::mutex> lock(mtx);
+    return library->take(d);
+  }
+
+  /** what draws of wanted use until it is built */
+  void set_fallback(const graphics_pipeline_desc &wanted,
+                    VkPipeline fallback) {
+    std::lock_guard<std::mutex> lock(mtx);
+    fallbacks[wanted] = fallback;
+  }
+
+  /**
+    The pipeline of d if built, otherwise its fallback, otherwise
+    VK_NULL_HANDLE and the draw should be skipped. Starts the build when
+    nobody asked for it yet.
+   */
+  VkPipeline ready_or_fallback(const graphics_pipeline_desc &d) {
+    return ready_or_fallback(d, true);
+  }
+
+  /** block until every queued build finished, failed ones included */
+  void wait_all() {
+    std::vector<std::shared_future<VkPipeline>> waiting;
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      for (auto &kv : pending) {
+        waiting.push_back(kv.second);
+      }
+    }
+    for (auto &f : waiting) {
+      f.wait();
+    }
+  }
+  pipeline_build_stats stats() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return counters;
+  }
+  void report(std::ostream &out) {
+    pipeline_build_stats s = stats();
+    out << "pipeline_builds.requested " << s.requested << std::endl;
+    out << "pipeline_builds.built " << s.built << std::endl;
+    out << "pipeline_builds.failed " << s.failed << std::endl;
+    out << "pipeline_builds.fallbacks " << s.fallbacks << std::endl;
+    out << "pipeline_builds.skipped " << s.skipped << std::endl;
+    out << "pipeline_builds.build_us " << s.build_us << std::endl;
+  }
+};
+
+} // namespace vtuto
@@ -0,0 +1,272 @@
+// pipeline cache kept on disk between runs
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <external.hpp>
+#include <mutex>
+#include <ostream>
+
+namespace vtuto {
+
+/** what the cache did for the pipelines created through it */
+struct pipeline_cache_stats {
+  /** bytes of the blob read at startup, 0 when none was accepted */
+  std::size_t loaded_bytes = 0;
+  /** why the blob on disk was ignored, empty when it was used */
+  std::string rejected;
+  std::size_t saved_bytes = 0;
+  uint64_t created = 0;
+  /** from creation feedback, unknown when the driver does not report */
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t unknown = 0;
+  double total_us = 0.0;
+  double max_us = 0.0;
+};
+
+/**
+  VkPipelineCache loaded from and saved to a file.
+
+  The blob is only handed to the driver when its header names the same
+  vendor, device and pipelineCacheUUID as the running device; a blob from
+  another driver version would otherwise be rejected by the driver, or
+  worse, silently ignored. Saving writes a temporary file next to the cache
+  and renames it over the old one, so an interrupted run never leaves a
+  truncated cache behind.
+
+  Pipelines created through create_graphics() and create_compute() are
+  timed and, when VK_EXT_pipeline_creation_feedback is enabled, counted as
+  cache hits or misses, which is what separates a cold from a warm start.
+  Both may be called from several threads at once: the driver synchronizes
+  the VkPipelineCache and a mutex the counters.
+ */
+class pipeline_cache {
+  VkPipelineCache cache = VK_NULL_HANDLE;
+  std::string path;
+  bool feedback = false;
+  pipeline_cache_stats counters;
+  std::mutex counters_mtx;
+
+  static std::vector<char> read_blob(const std::string &file) {
+    std::ifstream in(file, std::ios::ate | std::ios::binary);
+    if (!in.is_open()) {
+      return {};
+    }
+    std::vector<char> blob(static_cast<std::size_t>(in.tellg()));
+    in.seekg(0);
+    in.read(blob.data(), static_cast<std::streamsize>(blob.size()));
+    if (!in) {
+      return {};
+    }
+    return blob;
+  }
+  void add_feedback(const VkPipelineCreationFeedbackEXT &fb, double us) {
+    std::lock_guard<std::mutex> lock(counters_mtx);
+    counters.created++;
+    counters.total_us += us;
+    if (us > counters.max_us) {
+      counters.max_us = us;
+    }
+    const VkPipelineCreationFeedbackFlagsEXT hit =
+        VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT;
+    if (!(fb.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT)) {
+      counters.unknown++;
+    } else if (fb.flags & hit) {
+      counters.hits++;
+    } else {
+      counters.misses++;
+    }
+  }
+
+public:
+  pipeline_cache() {}
+
+  /**
+    Empty string when the blob may be given to the driver of props,
+    otherwise why it may not.
+   */
+  static std::string check_header(const std::vector<char> &blob,
+                                  const VkPhysicalDeviceProperties &props) {
+    VkPipelineCacheHeaderVersionOne header{};
+    const std::size_t header_bytes = 16 + VK_UUID_SIZE;
+    if (blob.size() < header_bytes) {
+      return "too small";
+    }
+    std::memcpy(&header.headerSize, blob.data(), 4);
+    uint32_t version = 0;
+    std::memcpy(&version, blob.data() + 4, 4);
+    std::memcpy(&header.vendorID, blob.data() + 8, 4);
+    std::memcpy(&header.deviceID, blob.data() + 12, 4);
+    std::memcpy(header.pipelineCacheUUID, blob.data() + 16, VK_UUID_SIZE);
+    if (header.headerSize < header_bytes || header.headerSize > blob.size()) {
+      return "bad header size";
+    }
+    if (version != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) {
+      return "unknown header version";
+    }
+    if (header.vendorID != props.vendorID) {
+      return "other vendor";
+    }
+    if (header.deviceID != props.deviceID) {
+      return "other device";
+    }
+    if (std::memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID,
+                    VK_UUID_SIZE) != 0) {
+      return "other driver version";
+    }
+    return "";
+  }
+
+  /**
+    Create the cache, seeded from file when its header matches pdev.
+    creation_feedback must only be true when the device enabled
+    VK_EXT_pipeline_creation_feedback.
+   */
+  VkResult create(VkPhysicalDevice pdev, VkDevice device,
+                  const std::string &file, bool creation_feedback) {
+    path = file;
+    feedback = creation_feedback;
+    counters = pipeline_cache_stats{};
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(pdev, &props);
+
+    std::vector<char> blob = read_blob(path);
+    if (blob.empty()) {
+      counters.rejected = "no cache file";
+    } else {
+      counters.rejected = check_header(blob, props);
+      if (!counters.rejected.empty()) {
+        blob.clear();
+      }
+    }
+    VkPipelineCacheCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    info.initialDataSize = blob.size();
+    info.pInitialData = blob.empty() ? nullptr : blob.data();
+    VkResult r = vkCreatePipelineCache(device, &info, nullptr, &cache);
+    if (r != VK_SUCCESS && !blob.empty()) {
+      // the driver refused data whose header looked right, start empty
+      counters.rejected = "refused by the driver";
+      info.initialDataSize = 0;
+      info.pInitialData = nullptr;
+      r = vkCreatePipelineCache(device, &info, nullptr, &cache);
+      blob.clear();
+    }
+    counters.loaded_bytes = blob.size();
+    return r;
+  }
+  VkPipelineCache handle() const { return cache; }
+
+  VkResult create_graphics(VkDevice device,
+                           const VkGraphicsPipelineCreateInfo &info,
+                           VkPipeline *pipeline) {
+    VkGraphicsPipelineCreateInfo chained = info;
+    VkPipelineCreationFeedbackEXT whole{};
+    std::vector<VkPipelineCreationFeedbackEXT> stages(info.stageCount);
+    VkPipelineCreationFeedbackCreateInfoEXT fb_info{};
+    if (feedback) {
+      fb_info.sType =
+          VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+      fb_info.pNext = info.pNext;
+      fb_info.pPipelineCreationFeedback = &whole;
+      fb_info.pipelineStageCreationFeedbackCount = info.stageCount;
+      fb_info.pPipelineStageCreationFeedbacks = stages.data();
+      chained.pNext = &fb_info;
+    }
+    auto start = std::chrono::steady_clock::now();
+    VkResult r = vkCreateGraphicsPipelines(device, cache, 1, &chained,
+                                           nullptr, pipeline);
+    std::chrono::duration<double, std::micro> took =
+        std::chrono::steady_clock::now() - start;
+    if (r == VK_SUCCESS) {
+      add_feedback(whole, took.count());
+    }
+    return r;
+  }
+  VkResult create_compute(VkDevice device,
+                          const VkComputePipelineCreateInfo &info,
+                          VkPipeline *pipeline) {
+    VkComputePipelineCreateInfo chained = info;
+    VkPipelineCreationFeedbackEXT whole{};
+    VkPipelineCreationFeedbackEXT stage{};
+    VkPipelineCreationFeedbackCreateInfoEXT fb_info{};
+    if (feedback) {
+      fb_info.sType =
+          VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+      fb_info.pNext = info.pNext;
+      fb_info.pPipelineCreationFeedback = &whole;
+      fb_info.pipelineStageCreationFeedbackCount = 1;
+      fb_info.pPipelineStageCreationFeedbacks = &stage;
+      chained.pNext = &fb_info;
+    }
+    auto start = std::chrono::steady_clock::now();
+    VkResult r = vkCreateComputePipelines(device, cache, 1, &chained,
+                                          nullptr, pipeline);
+    std::chrono::duration<double, std::micro> took =
+        std::chrono::steady_clock::now() - start;
+    if (r == VK_SUCCESS) {
+      add_feedback(whole, took.count());
+    }
+    return r;
+  }
+
+  /**
+    Write the cache to the file it was created from. The data goes to a
+    temporary file first which replaces the old cache only once complete.
+   */
+  bool save(VkDevice device) {
+    if (cache == VK_NULL_HANDLE) {
+      return false;
+    }
+    std::size_t size = 0;
+    if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS) {
+      return false;
+    }
+    std::vector<char> blob(size);
+    if (vkGetPipelineCacheData(device, cache, &size, blob.data()) !=
+        VK_SUCCESS) {
+      return false;
+    }
+    blob.resize(size);
+    const std::string tmp = path + ".tmp";
+    {
+      std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+      out.write(blob.data(), static_cast<std::streamsize>(blob.size()));
+      out.flush();
+      if (!out) {
+        std::remove(tmp.c_str());
+        return false;
+      }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+      std::remove(tmp.c_str());
+      return false;
+    }
+    counters.saved_bytes = blob.size();
+    return true;
+  }
+  void destroy(VkDevice device) {
+    if (cache != VK_NULL_HANDLE) {
+      vkDestroyPipelineCache(device, cache, nullptr);
+      cache = VK_NULL_HANDLE;
+    }
+  }
+  const pipeline_cache_stats &stats() const { return counters; }
+  void report(std::ostream &out) const {
+    out << "pipeline_cache.loaded_bytes " << counters.loaded_bytes
+        << std::endl;
+    if (!counters.rejected.empty()) {
+      out << "pipeline_cache.rejected " << counters.rejected << std::endl;
+    }
+    out << "pipeline_cache.saved_bytes " << counters.saved_bytes << std::endl;
+    out << "pipeline_cache.created " << counters.created << std::endl;
+    out << "pipeline_cache.hits " << counters.hits << std::endl;
+    out << "pipeline_cache.misses " << counters.misses << std::endl;
+    out << "pipeline_cache.unknown " << counters.unknown << std::endl;
+    out << "pipeline_cache.total_us " << counters.total_us << std::endl;
+    out << "pipeline_cache.max_us " << counters.max_us << std::endl;
+  }
+};
+
+} // namespace vtuto
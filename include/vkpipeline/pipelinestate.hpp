@@ -0,0 +1,394 @@
+// hashable graphics pipeline state and a map of the pipelines built from it
+#pragma once
+#include <cstring>
+#include <external.hpp>
+#include <ostream>
+#include <vkpipeline/pipelinecache.hpp>
+#include <vkshader/specialization.hpp>
+
+namespace vtuto {
+
+/** order dependent 64 bit mix of the fields fed to it */
+struct state_hasher {
+  uint64_t h = 14695981039346656037ull;
+
+  void add(uint64_t v) {
+    // boost style combine widened to 64 bits
+    h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+  }
+  void add(float f) {
+    uint32_t bits = 0;
+    std::memcpy(&bits, &f, sizeof(bits));
+    add(static_cast<uint64_t>(bits));
+  }
+  template <class Handle> void add_handle(Handle handle) {
+    uint64_t v = 0;
+    std::memcpy(&v, &handle, sizeof(Handle) < 8 ? sizeof(Handle) : 8);
+    add(v);
+  }
+};
+
+/**
+  Render passes are compatible when their attachments agree in format and
+  sample count, a pipeline built against one can be used with any other,
+  so pipelines are keyed by this instead of the VkRenderPass handle.
+ */
+inline uint64_t
+render_pass_compat_hash(const VkAttachmentDescription *attachments,
+                        std::size_t count) {
+  state_hasher s;
+  s.add(static_cast<uint64_t>(count));
+  for (std::size_t i = 0; i < count; i++) {
+    s.add(static_cast<uint64_t>(attachments[i].format));
+    s.add(static_cast<uint64_t>(attachments[i].samples));
+  }
+  return s.h;
+}
+
+/**
+  Everything a graphics pipeline is built from, in canonical form.
+
+  Equality and hash() cover shader contents, specialization constants,
+  vertex input, input assembly, rasterization, multisampling, depth,
+  blending, dynamic states, render pass compatibility, subpass, layout
+  and create flags. The module and render pass handles are only what the
+  pipeline is created with: two descriptions whose shaders have the same
+  bytes and whose passes are compatible are the same pipeline.
+ */
+struct graphics_pipeline_desc {
+  /** content hashes of the spir-v, see shader_registry::content_hash */
+  uint64_t vertex_shader = 0;
+  uint64_t fragment_shader = 0;
+  VkShaderModule vertex_module = VK_NULL_HANDLE;
+  VkShaderModule fragment_module = VK_NULL_HANDLE;
+  /** a variant per set of values, each built and cached once */
+  specialization_data vertex_constants;
+  specialization_data fragment_constants;
+
+  std::vector<VkVertexInputBindingDescription> bindings;
+  std::vector<VkVertexInputAttributeDescription> attributes;
+
+  VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  VkBool32 primitive_restart = VK_FALSE;
+
+  VkPolygonMode polygon_mode = VK_POLYGON_MODE_FILL;
+  VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
+  VkFrontFace front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  float line_width = 1.0f;
+
+  VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+
+  VkBool32 depth_test = VK_TRUE;
+  VkBool32 depth_write = VK_TRUE;
+  VkCompareOp depth_compare = VK_COMPARE_OP_LESS;
+
+  /** one color attachment, opaque by default */
+  VkPipelineColorBlendAttachmentState blend = opaque_blend();
+
+  std::vector<VkDynamicState> dynamic_states = {VK_DYNAMIC_STATE_VIEWPORT,
+                                                VK_DYNAMIC_STATE_SCISSOR};
+
+  VkRenderPass render_pass = VK_NULL_HANDLE;
+  uint64_t render_pass_compat = 0;
+  uint32_t subpass = 0;
+  VkPipelineLayout layout = VK_NULL_HANDLE;
+  /** e.g. VK_PIPELINE_CREATE_DISABLE_OPTIMIZATION_BIT, for a fallback the
+   * driver compiles quickly */
+  VkPipelineCreateFlags flags = 0;
+
+  static VkPipelineColorBlendAttachmentState opaque_blend() {
+    VkPipelineColorBlendAttachmentState b{};
+    b.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                       VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    b.blendEnable = VK_FALSE;
+    b.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    b.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+    b.colorBlendOp = VK_BLEND_OP_ADD;
+    b.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    b.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    b.alphaBlendOp = VK_BLEND_OP_ADD;
+    return b;
+  }
+
+  uint64_t hash() const {
+    state_hasher s;
+    s.add(vertex_shader);
+    s.add(fragment_shader);
+    s.add(vertex_constants.hash());
+    s.add(fragment_constants.hash());
+    s.add(static_cast<uint64_t>(bindings.size()));
+    for (const auto &b : bindings) {
+      s.add(static_cast<uint64_t>(b.binding));
+      s.add(static_cast<uint64_t>(b.stride));
+      s.add(static_cast<uint64_t>(b.inputRate));
+    }
+    s.add(static_cast<uint64_t>(attributes.size()));
+    for (const auto &a : attributes) {
+      s.add(static_cast<uint64_t>(a.location));
+      s.add(static_cast<uint64_t>(a.binding));
+      s.add(static_cast<uint64_t>(a.format));
+      s.add(static_cast<uint64_t>(a.offset));
+    }
+    s.add(static_cast<uint64_t>(topology));
+    s.add(static_cast<uint64_t>(primitive_restart));
+    s.add(static_cast<uint64_t>(polygon_mode));
+    s.add(static_cast<uint64_t>(cull_mode));
+    s.add(static_cast<uint64_t>(front_face));
+    s.add(line_width);
+    s.add(static_cast<uint64_t>(samples));
+    s.add(static_cast<uint64_t>(depth_test));
+    s.add(static_cast<uint64_t>(depth_write));
+    s.add(static_cast<uint64_t>(depth_compare));
+    s.add(static_cast<uint64_t>(blend.blendEnable));
+    s.add(static_cast<uint64_t>(blend.srcColorBlendFactor));
+    s.add(static_cast<uint64_t>(blend.dstColorBlendFactor));
+    s.add(static_cast<uint64_t>(blend.colorBlendOp));
+    s.add(static_cast<uint64_t>(blend.srcAlphaBlendFactor));
+    s.add(static_cast<uint64_t>(blend.dstAlphaBlendFactor));
+    s.add(static_cast<uint64_t>(blend.alphaBlendOp));
+    s.add(static_cast<uint64_t>(blend.colorWriteMask));
+    s.add(static_cast<uint64_t>(dynamic_states.size()));
+    for (VkDynamicState d : dynamic_states) {
+      s.add(static_cast<uint64_t>(d));
+    }
+    s.add(render_pass_compat);
+    s.add(static_cast<uint64_t>(subpass));
+    s.add_handle(layout);
+    s.add(static_cast<uint64_t>(flags));
+    return s.h;
+  }
+  bool operator==(const graphics_pipeline_desc &o) const {
+    auto same_binding = [](const VkVertexInputBindingDescription &a,
+                           const VkVertexInputBindingDescription &b) {
+      return a.binding == b.binding && a.stride == b.stride &&
+             a.inputRate == b.inputRate;
+    };
+    auto same_attribute = [](const VkVertexInputAttributeDescription &a,
+                             const VkVertexInputAttributeDescription &b) {
+      return a.location == b.location && a.binding == b.binding &&
+             a.format == b.format && a.offset == b.offset;
+    };
+    return vertex_shader == o.vertex_shader &&
+           fragment_shader == o.fragment_shader &&
+           vertex_constants == o.vertex_constants &&
+           fragment_constants == o.fragment_constants &&
+           std::equal(bindings.begin(), bindings.end(), o.bindings.begin(),
+                      o.bindings.end(), same_binding) &&
+           std::equal(attributes.begin(), attributes.end(),
+                      o.attributes.begin(), o.attributes.end(),
+                      same_attribute) &&
+           topology == o.topology &&
+           primitive_restart == o.primitive_restart &&
+           polygon_mode == o.polygon_mode && cull_mode == o.cull_mode &&
+           front_face == o.front_face && line_width == o.line_width &&
+           samples == o.samples && depth_test == o.depth_test &&
+           depth_write == o.depth_write &&
+           depth_compare == o.depth_compare &&
+           blend.blendEnable == o.blend.blendEnable &&
+           blend.srcColorBlendFactor == o.blend.srcColorBlendFactor &&
+           blend.dstColorBlendFactor == o.blend.dstColorBlendFactor &&
+           blend.colorBlendOp == o.blend.colorBlendOp &&
+           blend.srcAlphaBlendFactor == o.blend.srcAlphaBlendFactor &&
+           blend.dstAlphaBlendFactor == o.blend.dstAlphaBlendFactor &&
+           blend.alphaBlendOp == o.blend.alphaBlendOp &&
+           blend.colorWriteMask == o.blend.colorWriteMask &&
+           dynamic_states == o.dynamic_states &&
+           render_pass_compat == o.render_pass_compat &&
+           subpass == o.subpass && layout == o.layout && flags == o.flags;
+  }
+};
+
+struct graphics_pipeline_desc_hash {
+  std::size_t operator()(const graphics_pipeline_desc &d) const {
+    return static_cast<std::size_t>(d.hash());
+  }
+};
+
+/**
+  Graphics pipelines by description.
+
+  get() hands out the pipeline already built for an equal description and
+  only creates one, through the disk backed pipeline_cache, on a miss. The
+  library owns its pipelines: callers never destroy what get() returned,
+  everything goes with destroy() once the device is idle.
+ */
+class graphics_pipeline_library {
+  std::unordered_map<graphics_pipeline_desc, VkPipeline,
+                     graphics_pipeline_desc_hash>
+      pipelines;
+  uint64_t hit_count = 0;
+  uint64_t miss_count = 0;
+
+public:
+  graphics_pipeline_library() {}
+
+  /** build the pipeline a description stands for, no lookup */
+  static VkResult build(VkDevice device, pipeline_cache &cache,
+                        const graphics_pipeline_desc &d,
+                        VkPipeline &pipeline) {
+    std::array<VkPipelineShaderStageCreateInfo, 2> stages{};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = d.vertex_module;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = d.fragment_module;
+    stages[1].pName = "main";
+    // point into d, which outlives the create call
+    VkSpecializationInfo vertexSpec = d.vertex_constants.info();
+    VkSpecializationInfo fragmentSpec = d.fragment_constants.info();
+    if (!d.vertex_constants.empty()) {
+      stages[0].pSpecializationInfo = &vertexSpec;
+    }
+    if (!d.fragment_constants.empty()) {
+      stages[1].pSpecializationInfo = &fragmentSpec;
+    }
+
+    VkPipelineVertexInputStateCreateInfo vxInputInfo{};
+    vxInputInfo.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vxInputInfo.vertexBindingDescriptionCount =
+        static_cast<uint32_t>(d.bindings.size());
+    vxInputInfo.pVertexBindingDescriptions = d.bindings.data();
+    vxInputInfo.vertexAttributeDescriptionCount =
+        static_cast<uint32_t>(d.attributes.size());
+    vxInputInfo.pVertexAttributeDescriptions = d.attributes.data();
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = d.topology;
+    inputAssembly.primitiveRestartEnable = d.primitive_restart;
+
+    // viewport and scissor counts only, both are dynamic
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = d.polygon_mode;
+    rasterizer.lineWidth = d.line_width;
+    rasterizer.cullMode = d.cull_mode;
+    rasterizer.frontFace = d.front_face;
+    rasterizer.depthBiasEnable = VK_FALSE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = d.samples;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = d.depth_test;
+    depthStencil.depthWriteEnable = d.depth_write;
+    depthStencil.depthCompareOp = d.depth_compare;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.minDepthBounds = 0.0f;
+    depthStencil.maxDepthBounds = 1.0f;
+    depthStencil.stencilTestEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo colorBlend{};
+    colorBlend.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlend.logicOpEnable = VK_FALSE;
+    colorBlend.logicOp = VK_LOGIC_OP_COPY;
+    colorBlend.attachmentCount = 1;
+    colorBlend.pAttachments = &d.blend;
+
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount =
+        static_cast<uint32_t>(d.dynamic_states.size());
+    dynamicState.pDynamicStates = d.dynamic_states.data();
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.flags = d.flags;
+    pipelineInfo.stageCount = static_cast<uint32_t>(stages.size());
+    pipelineInfo.pStages = stages.data();
+    pipelineInfo.pVertexInputState = &vxInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlend;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = d.layout;
+    pipelineInfo.renderPass = d.render_pass;
+    pipelineInfo.subpass = d.subpass;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    return cache.create_graphics(device, pipelineInfo, &pipeline);
+  }
+
+  /** the pipeline of an equal description if one was built, no counting */
+  bool lookup(const graphics_pipeline_desc &d, VkPipeline &pipeline) const {
+    auto it = pipelines.find(d);
+    if (it == pipelines.end()) {
+      return false;
+    }
+    pipeline = it->second;
+    return true;
+  }
+  /** lookup() for a caller that would otherwise have built, a hit counts */
+  bool find(const graphics_pipeline_desc &d, VkPipeline &pipeline) {
+    if (!lookup(d, pipeline)) {
+      return false;
+    }
+    hit_count++;
+    return true;
+  }
+  /** take ownership of a pipeline built elsewhere for d */
+  void add(const graphics_pipeline_desc &d, VkPipeline pipeline) {
+    miss_count++;
+    pipelines.emplace(d, pipeline);
+  }
+  /** give up ownership of d's pipeline, VK_NULL_HANDLE when unknown */
+  VkPipeline take(const graphics_pipeline_desc &d) {
+    auto it = pipelines.find(d);
+    if (it == pipelines.end()) {
+      return VK_NULL_HANDLE;
+    }
+    VkPipeline pipeline = it->second;
+    pipelines.erase(it);
+    return pipeline;
+  }
+  /** the pipeline of an equal description, built on first use */
+  VkResult get(VkDevice device, pipeline_cache &cache,
+               const graphics_pipeline_desc &d, VkPipeline &pipeline) {
+    if (find(d, pipeline)) {
+      return VK_SUCCESS;
+    }
+    VkResult r = build(device, cache, d, pipeline);
+    if (r != VK_SUCCESS) {
+      return r;
+    }
+    add(d, pipeline);
+    return VK_SUCCESS;
+  }
+  std::size_t size() const { return pipelines.size(); }
+  uint64_t hits() const { return hit_count; }
+  uint64_t misses() const { return miss_count; }
+  void destroy(VkDevice device) {
+    for (auto &kv : pipelines) {
+      vkDestroyPipeline(device, kv.second, nullptr);
+    }
+    pipelines.clear();
+  }
+  void report(std::ostream &out) const {
+    out << "pipelines.unique " << pipelines.size() << std::endl;
+    out << "pipelines.hits " << hit_count << std::endl;
+    out << "pipelines.misses " << miss_count << std::endl;
+  }
+};
+
+} // namespace vtuto
@@ -0,0 +1,107 @@
+// gpu time of command buffers through timestamp queries
+#pragma once
+#include <external.hpp>
+#include <utils.hpp>
+
+namespace vtuto {
+
+/**
+  A begin and an end timestamp per slot.
+
+  A slot is whatever a command buffer is recorded for, a swapchain image
+  here. The queries are reset inside the command buffer before they are
+  written, so a prebaked buffer can be submitted again and again. Results
+  are read without waiting, once the caller knows the last submit of the
+  slot completed.
+ */
+class gpu_timer {
+  VkQueryPool pool = VK_NULL_HANDLE;
+  uint32_t slots = 0;
+  /** nanoseconds per timestamp tick */
+  double period_ns = 1.0;
+  /** mask of the valid timestamp bits of the queue family */
+  uint64_t valid_mask = ~0ull;
+  /** slots whose queries were submitted at least once, reading a query
+   * that was never reset is undefined */
+  std::vector<bool> submitted;
+
+public:
+  gpu_timer() {}
+  gpu_timer(VkPhysicalDevice pdev, VkDevice device, uint32_t queue_family,
+            uint32_t slot_count)
+      : slots(slot_count), submitted(slot_count, false) {
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(pdev, &props);
+    period_ns = props.limits.timestampPeriod;
+
+    uint32_t family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(pdev, &family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(pdev, &family_count,
+                                             families.data());
+    uint32_t bits = families[queue_family].timestampValidBits;
+    if (bits == 0) {
+      // no timestamps on this queue, the timer stays disabled
+      slots = 0;
+      return;
+    }
+    valid_mask = bits >= 64 ? ~0ull : ((1ull << bits) - 1);
+
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = 2 * slots;
+    CHECK_VK2(vkCreateQueryPool(device, &poolInfo, nullptr, &pool),
+              "failed to create timestamp query pool");
+  }
+  bool enabled() const { return pool != VK_NULL_HANDLE; }
+
+  /** record outside a render pass, before the timed commands */
+  void cmd_begin(VkCommandBuffer cb, uint32_t slot) const {
+    if (!enabled()) {
+      return;
+    }
+    vkCmdResetQueryPool(cb, pool, 2 * slot, 2);
+    vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pool,
+                        2 * slot);
+  }
+  /** record after the timed commands */
+  void cmd_end(VkCommandBuffer cb, uint32_t slot) const {
+    if (!enabled()) {
+      return;
+    }
+    vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pool,
+                        2 * slot + 1);
+  }
+  /** the slot's command buffer was handed to the queue */
+  void mark_submitted(uint32_t slot) {
+    if (enabled()) {
+      submitted[slot] = true;
+    }
+  }
+  /** gpu time of the slot's last completed submit in milliseconds, false
+   * when the slot has no result yet */
+  bool read_ms(VkDevice device, uint32_t slot, double &ms) const {
+    if (!enabled() || !submitted[slot]) {
+      return false;
+    }
+    uint64_t stamps[2] = {0, 0};
+    VkResult res =
+        vkGetQueryPoolResults(device, pool, 2 * slot, 2, sizeof(stamps),
+                              stamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (res == VK_NOT_READY) {
+      return false;
+    }
+    CHECK_VK2(res, "failed to read timestamp queries");
+    uint64_t ticks = ((stamps[1] & valid_mask) - (stamps[0] & valid_mask)) &
+                     valid_mask;
+    ms = static_cast<double>(ticks) * period_ns * 1e-6;
+    return true;
+  }
+  void destroy(VkDevice device) {
+    vkDestroyQueryPool(device, pool, nullptr);
+    pool = VK_NULL_HANDLE;
+  }
+};
+
+} // namespace vtuto
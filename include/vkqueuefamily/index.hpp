@@ -55,9 +55,29 @@ template <> struct VkOptional<queue_index_map> {
   }
 };
 
+/**
+  How much a family does besides the requested capability, lower is more
+  dedicated. A graphics capable family counts the most since that is the
+  queue everything else is already competing for.
+ */
+inline uint32_t queue_family_overlap(VkQueueFlags family_flags,
+                                     VkQueueFlagBits wanted) {
+  VkQueueFlags extra = family_flags & ~static_cast<VkQueueFlags>(wanted);
+  uint32_t score = 0;
+  if (extra & VK_QUEUE_GRAPHICS_BIT) {
+    score += 4;
+  }
+  if (extra & VK_QUEUE_COMPUTE_BIT) {
+    score += 2;
+  }
+  return score;
+}
+
 struct QueueFamilyIndices {
   queue_index_map qfamilies;
   PresentFamily presentFamily;
+  /** overlap score of the family chosen for each flag */
+  std::map<VkQueueFlagBits, uint32_t> qoverlap;
 
   bool isComplete() {
     return VkOptional<queue_index_map>::has_value(qfamilies) &&
@@ -66,7 +86,27 @@ struct QueueFamilyIndices {
   void set_qfamily(unsigned int i, VkQueueFlagBits flag) {
     qfamilies[flag] = i;
   }
+  /** take family i for flag if it is more dedicated than the current one.
+   * graphics keeps the first family that has it */
+  void offer_qfamily(unsigned int i, VkQueueFlagBits flag,
+                     VkQueueFlags family_flags) {
+    uint32_t score = queue_family_overlap(family_flags, flag);
+    bool taken = qfamilies[flag].has_value();
+    if (taken &&
+        (flag == VK_QUEUE_GRAPHICS_BIT || qoverlap[flag] <= score)) {
+      return;
+    }
+    set_qfamily(i, flag);
+    qoverlap[flag] = score;
+  }
   void set_pfamily(unsigned int i) { presentFamily = i; }
+  /** true when flag got a family other than the graphics one */
+  bool is_dedicated(VkQueueFlagBits flag) {
+    return qfamilies[flag].has_value() &&
+           qfamilies[VK_QUEUE_GRAPHICS_BIT].has_value() &&
+           qfamilies[flag].value() !=
+               qfamilies[VK_QUEUE_GRAPHICS_BIT].value();
+  }
   std::vector<uint32_t> queue_values() const {
     //
     std::vector<uint32_t> qs;
@@ -84,6 +124,29 @@ struct QueueFamilyIndices {
     }
     return qs;
   }
+  /**
+    Same as queue_values() but the storage comes from the given allocator,
+    so hot paths can hand in an arena_allocator and skip the heap.
+   */
+  template <class Alloc>
+  std::vector<uint32_t, Alloc> queue_values(const Alloc &alloc) const {
+    std::vector<uint32_t, Alloc> qs(alloc);
+    qs.reserve(qfamilies.size() + 1);
+    for (const auto &q : qfamilies) {
+      if (q.second.has_value()) {
+        qs.push_back(q.second.value());
+      }
+    }
+    return qs;
+  }
+  template <class Alloc>
+  std::vector<uint32_t, Alloc> values(const Alloc &alloc) const {
+    auto qs = queue_values(alloc);
+    if (presentFamily.has_value()) {
+      qs.push_back(presentFamily.value());
+    }
+    return qs;
+  }
   template <VkQueueFlagBits f> void index(uint32_t &i) {
     if (qfamilies[f].has_value()) {
       i = qfamilies[f].value();
@@ -96,7 +159,7 @@ void queue_insert(VkQueueFamilyProperties queueFamily, QueueFamilyIndices &q,
                   unsigned int i) {
   for (const auto &obj : VkQueueFlagList<Ts...>::flags) {
     if (queueFamily.queueFlags & obj) {
-      q.set_qfamily(i, obj);
+      q.offer_qfamily(i, obj, queueFamily.queueFlags);
     }
   }
 }
@@ -114,22 +177,28 @@ QueueFamilyIndices find_queue_families(const VkPhysicalDevice &device,
 
   QueueFamilyIndices indices;
 
-  // query present family
-
+  // every family is looked at: a dedicated transfer or compute family
+  // usually comes after the graphics one
+  std::vector<VkBool32> presents(queueFamilies.size(), false);
   for (unsigned int i = 0; i < queueFamilies.size(); i++) {
     VkQueueFamilyProperties queueFamily = queueFamilies[i];
 
     queue_insert<Fs...>(queueFamily, indices, i);
 
-    VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-
-    if (presentSupport) {
-      indices.set_pfamily(i);
-    }
-
-    if (indices.isComplete()) {
-      break;
+    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presents[i]);
+  }
+  // query present family, the graphics one if it can present
+  uint32_t graphics_family = 0;
+  bool has_graphics = indices.qfamilies[VK_QUEUE_GRAPHICS_BIT].has_value();
+  indices.index<VK_QUEUE_GRAPHICS_BIT>(graphics_family);
+  if (has_graphics && presents[graphics_family]) {
+    indices.set_pfamily(graphics_family);
+  } else {
+    for (unsigned int i = 0; i < presents.size(); i++) {
+      if (presents[i]) {
+        indices.set_pfamily(i);
+        break;
+      }
     }
   }
   return indices;
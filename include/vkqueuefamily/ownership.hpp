@@ -0,0 +1,113 @@
+// queue family ownership transfer barriers
+#pragma once
+#include <external.hpp>
+
+namespace vtuto {
+
+/**
+  Moving an exclusive resource between queue families.
+
+  A buffer or image created with VK_SHARING_MODE_EXCLUSIVE belongs to one
+  family at a time. Handing it over takes two barriers with the same
+  families, range and layouts: a release recorded on the source queue and
+  an acquire recorded on the destination queue, the latter submitted after
+  the former completed (semaphore, timeline value or a host fence wait).
+  The release only makes the source writes available, its dst access mask
+  and stage are ignored; the acquire does the visibility part, so its src
+  access mask is ignored. When both families are the same no transfer is
+  needed and a plain barrier does the job.
+ */
+struct queue_ownership {
+  uint32_t src_family = VK_QUEUE_FAMILY_IGNORED;
+  uint32_t dst_family = VK_QUEUE_FAMILY_IGNORED;
+
+  queue_ownership() {}
+  queue_ownership(uint32_t src, uint32_t dst)
+      : src_family(src), dst_family(dst) {}
+
+  bool needs_transfer() const { return src_family != dst_family; }
+};
+
+/** release half of a buffer ownership transfer */
+inline VkBufferMemoryBarrier
+buffer_release_barrier(const queue_ownership &own, VkBuffer buffer,
+                       VkAccessFlags src_access, VkDeviceSize offset = 0,
+                       VkDeviceSize size = VK_WHOLE_SIZE) {
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = src_access;
+  barrier.dstAccessMask = 0;
+  barrier.srcQueueFamilyIndex = own.src_family;
+  barrier.dstQueueFamilyIndex = own.dst_family;
+  barrier.buffer = buffer;
+  barrier.offset = offset;
+  barrier.size = size;
+  return barrier;
+}
+
+/** acquire half of a buffer ownership transfer */
+inline VkBufferMemoryBarrier
+buffer_acquire_barrier(const queue_ownership &own, VkBuffer buffer,
+                       VkAccessFlags dst_access, VkDeviceSize offset = 0,
+                       VkDeviceSize size = VK_WHOLE_SIZE) {
+  VkBufferMemoryBarrier barrier =
+      buffer_release_barrier(own, buffer, 0, offset, size);
+  barrier.dstAccessMask = dst_access;
+  return barrier;
+}
+
+/** release half of an image ownership transfer, layouts must match the
+ * acquire */
+inline VkImageMemoryBarrier
+image_release_barrier(const queue_ownership &own, VkImage image,
+                      const VkImageSubresourceRange &range,
+                      VkImageLayout old_layout, VkImageLayout new_layout,
+                      VkAccessFlags src_access) {
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = src_access;
+  barrier.dstAccessMask = 0;
+  barrier.oldLayout = old_layout;
+  barrier.newLayout = new_layout;
+  barrier.srcQueueFamilyIndex = own.src_family;
+  barrier.dstQueueFamilyIndex = own.dst_family;
+  barrier.image = image;
+  barrier.subresourceRange = range;
+  return barrier;
+}
+
+/** acquire half of an image ownership transfer */
+inline VkImageMemoryBarrier
+image_acquire_barrier(const queue_ownership &own, VkImage image,
+                      const VkImageSubresourceRange &range,
+                      VkImageLayout old_layout, VkImageLayout new_layout,
+                      VkAccessFlags dst_access) {
+  VkImageMemoryBarrier barrier = image_release_barrier(
+      own, image, range, old_layout, new_layout, 0);
+  barrier.dstAccessMask = dst_access;
+  return barrier;
+}
+
+/** record releases on the source queue after the stage that wrote */
+inline void cmd_release_ownership(
+    VkCommandBuffer cbuffer, VkPipelineStageFlags src_stage,
+    const std::vector<VkBufferMemoryBarrier> &buffers,
+    const std::vector<VkImageMemoryBarrier> &images = {}) {
+  vkCmdPipelineBarrier(cbuffer, src_stage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                       0, 0, nullptr, static_cast<uint32_t>(buffers.size()),
+                       buffers.data(), static_cast<uint32_t>(images.size()),
+                       images.data());
+}
+
+/** record acquires on the destination queue before the stage that reads */
+inline void cmd_acquire_ownership(
+    VkCommandBuffer cbuffer, VkPipelineStageFlags dst_stage,
+    const std::vector<VkBufferMemoryBarrier> &buffers,
+    const std::vector<VkImageMemoryBarrier> &images = {}) {
+  vkCmdPipelineBarrier(cbuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dst_stage,
+                       0, 0, nullptr, static_cast<uint32_t>(buffers.size()),
+                       buffers.data(), static_cast<uint32_t>(images.size()),
+                       images.data());
+}
+
+} // namespace vtuto
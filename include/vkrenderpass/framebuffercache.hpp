@@ -0,0 +1,173 @@
+// framebuffers by render pass, attachments and extent, least recently used
+// ones evicted
+#pragma once
+#include <algorithm>
+#include <external.hpp>
+#include <list>
+#include <ostream>
+#include <vkpipeline/pipelinestate.hpp>
+
+namespace vtuto {
+
+struct framebuffer_key {
+  VkRenderPass render_pass = VK_NULL_HANDLE;
+  std::vector<VkImageView> attachments;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t layers = 1;
+
+  uint64_t hash() const {
+    state_hasher s;
+    s.add_handle(render_pass);
+    s.add(static_cast<uint64_t>(attachments.size()));
+    for (VkImageView v : attachments) {
+      s.add_handle(v);
+    }
+    s.add(static_cast<uint64_t>(width));
+    s.add(static_cast<uint64_t>(height));
+    s.add(static_cast<uint64_t>(layers));
+    return s.h;
+  }
+  bool operator==(const framebuffer_key &o) const {
+    return render_pass == o.render_pass && attachments == o.attachments &&
+           width == o.width && height == o.height && layers == o.layers;
+  }
+};
+
+struct framebuffer_key_hash {
+  std::size_t operator()(const framebuffer_key &k) const {
+    return static_cast<std::size_t>(k.hash());
+  }
+};
+
+/**
+  VkFramebuffers by render pass, attachment views and extent.
+
+  Holds at most capacity framebuffers. Asking for one more evicts the one
+  asked for least recently; evicted framebuffers are not destroyed here
+  since a frame in flight may still render into them, the caller takes
+  them with evicted() and destroys them once unused, e.g. through the
+  deletion queue. The capacity must cover every framebuffer in use at
+  once, fit() raises it for that.
+
+  A framebuffer is only valid as long as its attachments: release() takes
+  out every framebuffer using a view about to be destroyed, which also
+  keeps a later view that happens to get the same handle from matching a
+  stale entry.
+ */
+class framebuffer_cache {
+  using lru_list = std::list<framebuffer_key>;
+  struct entry {
+    VkFramebuffer framebuffer;
+    lru_list::iterator position;
+  };
+  /** most recently used first */
+  lru_list order;
+  std::unordered_map<framebuffer_key, entry, framebuffer_key_hash> entries;
+  std::vector<VkFramebuffer> to_destroy;
+  std::size_t max_entries = 8;
+  uint64_t hit_count = 0;
+  uint64_t miss_count = 0;
+  uint64_t evict_count = 0;
+  uint64_t release_count = 0;
+
+  void evict_over(std::size_t limit) {
+    while (entries.size() > limit) {
+      auto it = entries.find(order.back());
+      to_destroy.push_back(it->second.framebuffer);
+      entries.erase(it);
+      order.pop_back();
+      evict_count++;
+    }
+  }
+
+public:
+  framebuffer_cache() {}
+  explicit framebuffer_cache(std::size_t capacity)
+      : max_entries(std::max<std::size_t>(capacity, 1)) {}
+
+  /** at least count framebuffers can be held at once */
+  void fit(std::size_t count) { max_entries = std::max(max_entries, count); }
+  std::size_t capacity() const { return max_entries; }
+
+  VkResult get(VkDevice device, VkRenderPass render_pass,
+               const std::vector<VkImageView> &attachments, VkExtent2D extent,
+               uint32_t layers, VkFramebuffer &framebuffer) {
+    framebuffer_key key;
+    key.render_pass = render_pass;
+    key.attachments = attachments;
+    key.width = extent.width;
+    key.height = extent.height;
+    key.layers = layers;
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+      hit_count++;
+      order.splice(order.begin(), order, it->second.position);
+      framebuffer = it->second.framebuffer;
+      return VK_SUCCESS;
+    }
+    VkFramebufferCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    info.renderPass = render_pass;
+    info.attachmentCount = static_cast<uint32_t>(attachments.size());
+    info.pAttachments = attachments.data();
+    info.width = extent.width;
+    info.height = extent.height;
+    info.layers = layers;
+    VkResult r = vkCreateFramebuffer(device, &info, nullptr, &framebuffer);
+    if (r != VK_SUCCESS) {
+      return r;
+    }
+    miss_count++;
+    evict_over(max_entries - 1);
+    order.push_front(key);
+    entries.emplace(std::move(key), entry{framebuffer, order.begin()});
+    return VK_SUCCESS;
+  }
+  /** framebuffers evicted since the last call, now the caller's */
+  std::vector<VkFramebuffer> evicted() {
+    std::vector<VkFramebuffer> fbs;
+    fbs.swap(to_destroy);
+    return fbs;
+  }
+  /** every framebuffer attaching view, no longer in the cache */
+  std::vector<VkFramebuffer> release(VkImageView view) {
+    std::vector<VkFramebuffer> released;
+    for (auto it = order.begin(); it != order.end();) {
+      const auto &views = it->attachments;
+      if (std::find(views.begin(), views.end(), view) == views.end()) {
+        ++it;
+        continue;
+      }
+      auto e = entries.find(*it);
+      released.push_back(e->second.framebuffer);
+      entries.erase(e);
+      it = order.erase(it);
+    }
+    release_count += released.size();
+    return released;
+  }
+  std::size_t size() const { return entries.size(); }
+  /** evicted framebuffers not taken yet go too */
+  void destroy(VkDevice device) {
+    for (auto &kv : entries) {
+      vkDestroyFramebuffer(device, kv.second.framebuffer, nullptr);
+    }
+    for (VkFramebuffer fb : to_destroy) {
+      vkDestroyFramebuffer(device, fb, nullptr);
+    }
+    entries.clear();
+    order.clear();
+    to_destroy.clear();
+  }
+  void report(std::ostream &out) const {
+    out << "framebuffers.size " << entries.size() << std::endl;
+    out << "framebuffers.capacity " << max_entries << std::endl;
+    out << "framebuffers.hits " << hit_count << std::endl;
+    out << "framebuffers.misses " << miss_count << std::endl;
+    out << "framebuffers.evicted " << evict_count << std::endl;
+    out << "framebuffers.released " << release_count << std::endl;
+  }
+};
+
+} // namespace vtuto
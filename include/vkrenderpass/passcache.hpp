@@ -0,0 +1,217 @@
+// render passes created once per distinct attachment and subpass layout
+#pragma once
+#include <algorithm>
+#include <external.hpp>
+#include <ostream>
+#include <vkpipeline/pipelinestate.hpp>
+
+namespace vtuto {
+
+/**
+  A subpass with its attachment references copied out of the pointers
+  of VkSubpassDescription, so it can be kept and compared.
+ */
+struct subpass_key {
+  VkSubpassDescriptionFlags flags = 0;
+  VkPipelineBindPoint bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  std::vector<VkAttachmentReference> inputs;
+  std::vector<VkAttachmentReference> colors;
+  /** empty or one per color attachment */
+  std::vector<VkAttachmentReference> resolves;
+  bool has_depth = false;
+  VkAttachmentReference depth{};
+  std::vector<uint32_t> preserves;
+
+  subpass_key() {}
+  explicit subpass_key(const VkSubpassDescription &s)
+      : flags(s.flags), bind_point(s.pipelineBindPoint),
+        inputs(s.pInputAttachments,
+               s.pInputAttachments + s.inputAttachmentCount),
+        colors(s.pColorAttachments,
+               s.pColorAttachments + s.colorAttachmentCount),
+        has_depth(s.pDepthStencilAttachment != nullptr),
+        preserves(s.pPreserveAttachments,
+                  s.pPreserveAttachments + s.preserveAttachmentCount) {
+    if (s.pResolveAttachments != nullptr) {
+      resolves.assign(s.pResolveAttachments,
+                      s.pResolveAttachments + s.colorAttachmentCount);
+    }
+    if (has_depth) {
+      depth = *s.pDepthStencilAttachment;
+    }
+  }
+};
+
+/**
+  Everything a render pass is created from: attachment formats, samples,
+  load and store ops and layouts, the subpasses and their dependencies.
+  Holds the descriptions AttachmentDescriptionVk and SubpassDescriptionVk
+  wrap, by value.
+ */
+struct render_pass_key {
+  VkRenderPassCreateFlags flags = 0;
+  std::vector<VkAttachmentDescription> attachments;
+  std::vector<subpass_key> subpasses;
+  std::vector<VkSubpassDependency> dependencies;
+
+  render_pass_key() {}
+  explicit render_pass_key(const VkRenderPassCreateInfo &info)
+      : flags(info.flags),
+        attachments(info.pAttachments,
+                    info.pAttachments + info.attachmentCount),
+        subpasses(info.pSubpasses, info.pSubpasses + info.subpassCount),
+        dependencies(info.pDependencies,
+                     info.pDependencies + info.dependencyCount) {}
+
+  uint64_t hash() const {
+    state_hasher s;
+    s.add(static_cast<uint64_t>(flags));
+    s.add(static_cast<uint64_t>(attachments.size()));
+    for (const auto &a : attachments) {
+      s.add(static_cast<uint64_t>(a.flags));
+      s.add(static_cast<uint64_t>(a.format));
+      s.add(static_cast<uint64_t>(a.samples));
+      s.add(static_cast<uint64_t>(a.loadOp));
+      s.add(static_cast<uint64_t>(a.storeOp));
+      s.add(static_cast<uint64_t>(a.stencilLoadOp));
+      s.add(static_cast<uint64_t>(a.stencilStoreOp));
+      s.add(static_cast<uint64_t>(a.initialLayout));
+      s.add(static_cast<uint64_t>(a.finalLayout));
+    }
+    auto add_refs = [&s](const std::vector<VkAttachmentReference> &refs) {
+      s.add(static_cast<uint64_t>(refs.size()));
+      for (const auto &r : refs) {
+        s.add(static_cast<uint64_t>(r.attachment));
+        s.add(static_cast<uint64_t>(r.layout));
+      }
+    };
+    s.add(static_cast<uint64_t>(subpasses.size()));
+    for (const auto &sp : subpasses) {
+      s.add(static_cast<uint64_t>(sp.flags));
+      s.add(static_cast<uint64_t>(sp.bind_point));
+      add_refs(sp.inputs);
+      add_refs(sp.colors);
+      add_refs(sp.resolves);
+      s.add(static_cast<uint64_t>(sp.has_depth));
+      s.add(static_cast<uint64_t>(sp.depth.attachment));
+      s.add(static_cast<uint64_t>(sp.depth.layout));
+      s.add(static_cast<uint64_t>(sp.preserves.size()));
+      for (uint32_t p : sp.preserves) {
+        s.add(static_cast<uint64_t>(p));
+      }
+    }
+    s.add(static_cast<uint64_t>(dependencies.size()));
+    for (const auto &d : dependencies) {
+      s.add(static_cast<uint64_t>(d.srcSubpass));
+      s.add(static_cast<uint64_t>(d.dstSubpass));
+      s.add(static_cast<uint64_t>(d.srcStageMask));
+      s.add(static_cast<uint64_t>(d.dstStageMask));
+      s.add(static_cast<uint64_t>(d.srcAccessMask));
+      s.add(static_cast<uint64_t>(d.dstAccessMask));
+      s.add(static_cast<uint64_t>(d.dependencyFlags));
+    }
+    return s.h;
+  }
+  bool operator==(const render_pass_key &o) const {
+    auto same_attachment = [](const VkAttachmentDescription &a,
+                              const VkAttachmentDescription &b) {
+      return a.flags == b.flags && a.format == b.format &&
+             a.samples == b.samples && a.loadOp == b.loadOp &&
+             a.storeOp == b.storeOp && a.stencilLoadOp == b.stencilLoadOp &&
+             a.stencilStoreOp == b.stencilStoreOp &&
+             a.initialLayout == b.initialLayout &&
+             a.finalLayout == b.finalLayout;
+    };
+    auto same_ref = [](const VkAttachmentReference &a,
+                       const VkAttachmentReference &b) {
+      return a.attachment == b.attachment && a.layout == b.layout;
+    };
+    auto same_refs = [&same_ref](const std::vector<VkAttachmentReference> &a,
+                                 const std::vector<VkAttachmentReference> &b) {
+      return std::equal(a.begin(), a.end(), b.begin(), b.end(), same_ref);
+    };
+    auto same_subpass = [&](const subpass_key &a, const subpass_key &b) {
+      return a.flags == b.flags && a.bind_point == b.bind_point &&
+             same_refs(a.inputs, b.inputs) && same_refs(a.colors, b.colors) &&
+             same_refs(a.resolves, b.resolves) && a.has_depth == b.has_depth &&
+             (!a.has_depth || same_ref(a.depth, b.depth)) &&
+             a.preserves == b.preserves;
+    };
+    auto same_dependency = [](const VkSubpassDependency &a,
+                              const VkSubpassDependency &b) {
+      return a.srcSubpass == b.srcSubpass && a.dstSubpass == b.dstSubpass &&
+             a.srcStageMask == b.srcStageMask &&
+             a.dstStageMask == b.dstStageMask &&
+             a.srcAccessMask == b.srcAccessMask &&
+             a.dstAccessMask == b.dstAccessMask &&
+             a.dependencyFlags == b.dependencyFlags;
+    };
+    return flags == o.flags &&
+           std::equal(attachments.begin(), attachments.end(),
+                      o.attachments.begin(), o.attachments.end(),
+                      same_attachment) &&
+           std::equal(subpasses.begin(), subpasses.end(),
+                      o.subpasses.begin(), o.subpasses.end(),
+                      same_subpass) &&
+           std::equal(dependencies.begin(), dependencies.end(),
+                      o.dependencies.begin(), o.dependencies.end(),
+                      same_dependency);
+  }
+};
+
+struct render_pass_key_hash {
+  std::size_t operator()(const render_pass_key &k) const {
+    return static_cast<std::size_t>(k.hash());
+  }
+};
+
+/**
+  VkRenderPasses by their attachments, subpasses and dependencies.
+
+  A swapchain rebuild that keeps the image format asks for the same pass
+  and gets the one it has; a format that comes back finds its pass still
+  here, as pipeline_library keeps the pipelines built against it. The
+  cache owns every pass it returned until destroy().
+ */
+class render_pass_cache {
+  std::unordered_map<render_pass_key, VkRenderPass, render_pass_key_hash>
+      passes;
+  uint64_t hit_count = 0;
+  uint64_t miss_count = 0;
+
+public:
+  render_pass_cache() {}
+
+  /** pNext chains are not part of the key, info must not have one */
+  VkResult get(VkDevice device, const VkRenderPassCreateInfo &info,
+               VkRenderPass &pass) {
+    render_pass_key key(info);
+    auto it = passes.find(key);
+    if (it != passes.end()) {
+      hit_count++;
+      pass = it->second;
+      return VK_SUCCESS;
+    }
+    VkResult r = vkCreateRenderPass(device, &info, nullptr, &pass);
+    if (r != VK_SUCCESS) {
+      return r;
+    }
+    miss_count++;
+    passes.emplace(std::move(key), pass);
+    return VK_SUCCESS;
+  }
+  std::size_t size() const { return passes.size(); }
+  void destroy(VkDevice device) {
+    for (auto &kv : passes) {
+      vkDestroyRenderPass(device, kv.second, nullptr);
+    }
+    passes.clear();
+  }
+  void report(std::ostream &out) const {
+    out << "render_passes.size " << passes.size() << std::endl;
+    out << "render_passes.hits " << hit_count << std::endl;
+    out << "render_passes.misses " << miss_count << std::endl;
+  }
+};
+
+} // namespace vtuto
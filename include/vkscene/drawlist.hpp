@@ -0,0 +1,53 @@
+// list of indexed draws recorded every frame
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vtuto {
+
+/** arguments of one vkCmdDrawIndexed */
+struct draw_item {
+  uint32_t index_count = 0;
+  uint32_t first_index = 0;
+  int32_t vertex_offset = 0;
+  uint32_t instance_count = 1;
+  uint32_t first_instance = 0;
+  /** scene node whose world matrix is pushed as the model matrix */
+  uint32_t transform_node = 0;
+  uint32_t material_index = 0;
+};
+
+/**
+  Draws to record into a frame's command buffer.
+
+  The list has a fixed capacity reserved up front: recording time grows with
+  the number of items, so capping them bounds the per frame recording cost
+  and keeps push() from allocating in the frame loop.
+ */
+class draw_list {
+  std::vector<draw_item> items;
+  std::size_t max_items = 0;
+  std::size_t dropped_items = 0;
+
+public:
+  explicit draw_list(std::size_t capacity = 4096) : max_items(capacity) {
+    items.reserve(capacity);
+  }
+  /** false when the list is full, the item is then dropped and counted */
+  bool push(const draw_item &item) {
+    if (items.size() >= max_items) {
+      dropped_items++;
+      return false;
+    }
+    items.push_back(item);
+    return true;
+  }
+  void clear() { items.clear(); }
+  const std::vector<draw_item> &draws() const { return items; }
+  std::size_t size() const { return items.size(); }
+  std::size_t capacity() const { return max_items; }
+  std::size_t dropped() const { return dropped_items; }
+};
+
+} // namespace vtuto
@@ -0,0 +1,120 @@
+// per instance transforms kept as structure of arrays
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <external.hpp>
+#include <vector>
+#include <vertex.hpp>
+#include <vkculling/simdcull.hpp>
+#include <vkscene/transform.hpp>
+
+namespace vtuto {
+
+/**
+  Transforms of every instance of a mesh, one array per component.
+
+  Updates touch a few components of many instances (move them, spin them),
+  so each component lives in its own contiguous array and a pass over one
+  of them streams through memory. add_nodes() turns them into nodes of a
+  transform_hierarchy, whose write_changed() copies the matrices that
+  moved into the InstanceData buffer the vertex shader reads.
+ */
+class instance_transforms {
+public:
+  std::vector<float> pos_x;
+  std::vector<float> pos_y;
+  std::vector<float> pos_z;
+  /** rotation around the z axis, in radians */
+  std::vector<float> yaw;
+  std::vector<float> scale;
+
+public:
+  instance_transforms() {}
+  explicit instance_transforms(std::size_t count) { resize(count); }
+
+  std::size_t size() const { return pos_x.size(); }
+  /** new instances sit at the origin with no rotation and unit scale */
+  void resize(std::size_t count) {
+    pos_x.resize(count, 0.0f);
+    pos_y.resize(count, 0.0f);
+    pos_z.resize(count, 0.0f);
+    yaw.resize(count, 0.0f);
+    scale.resize(count, 1.0f);
+  }
+  void set(std::size_t i, const glm::vec3 &position, float yaw_radians,
+           float uniform_scale) {
+    pos_x[i] = position.x;
+    pos_y[i] = position.y;
+    pos_z[i] = position.z;
+    yaw[i] = yaw_radians;
+    scale[i] = uniform_scale;
+  }
+
+  /**
+    Lay count instances on a square grid in the xy plane centered on the
+    origin, scaled down so the whole grid keeps roughly the footprint of a
+    single model.
+   */
+  void grid(std::size_t count, float extent = 2.0f) {
+    resize(count);
+    if (count == 1) {
+      set(0, glm::vec3(0.0f), 0.0f, 1.0f);
+      return;
+    }
+    std::size_t side = 1;
+    while (side * side < count) {
+      side++;
+    }
+    float cell = extent / static_cast<float>(side);
+    float origin = -0.5f * extent + 0.5f * cell;
+    for (std::size_t i = 0; i < count; i++) {
+      float x = origin + cell * static_cast<float>(i % side);
+      float y = origin + cell * static_cast<float>(i / side);
+      set(i, glm::vec3(x, y, 0.0f), 0.0f, cell * 0.5f);
+    }
+  }
+
+  /** one node per instance under parent, in instance order, placed by
+   * translate * rotate_z * scale; returns the first */
+  uint32_t add_nodes(transform_hierarchy &h, uint32_t parent) const {
+    const uint32_t first = static_cast<uint32_t>(h.size());
+    h.reserve(h.size() + size());
+    for (std::size_t i = 0; i < size(); i++) {
+      uint32_t node = h.add(parent);
+      h.set_translation(node, glm::vec3(pos_x[i], pos_y[i], pos_z[i]));
+      h.set_rotation(node, yaw[i], glm::vec3(0.0f, 0.0f, 1.0f));
+      h.set_scale(node, glm::vec3(scale[i]));
+    }
+    return first;
+  }
+
+  /**
+    Bounding sphere of every instance as xyz center and w radius, given the
+    sphere of the mesh in the space the instance transform maps from.
+   */
+  void write_bounds(glm::vec4 *out, const glm::vec3 &center,
+                    float radius) const {
+    for (std::size_t i = 0; i < size(); i++) {
+      out[i] = bounds(i, center, radius);
+    }
+  }
+  /** same spheres for the simd culler */
+  void write_bounds(sphere_soa &out, const glm::vec3 &center,
+                    float radius) const {
+    out.resize(size());
+    for (std::size_t i = 0; i < size(); i++) {
+      out.set(i, bounds(i, center, radius));
+    }
+  }
+  glm::vec4 bounds(std::size_t i, const glm::vec3 &center,
+                   float radius) const {
+    float c = std::cos(yaw[i]) * scale[i];
+    float s = std::sin(yaw[i]) * scale[i];
+    return glm::vec4(pos_x[i] + c * center.x - s * center.y,
+                     pos_y[i] + s * center.x + c * center.y,
+                     pos_z[i] + scale[i] * center.z,
+                     std::abs(scale[i]) * radius);
+  }
+};
+
+} // namespace vtuto
@@ -0,0 +1,332 @@
+// parent child transforms with dirty flags and simd matrix products
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <external.hpp>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include <vkutils/simd.hpp>
+
+namespace vtuto {
+
+/*
+  4x4 products on column major floats, out = a * b. Column j of out is the
+  columns of a weighted by column j of b, every path sums them in the same
+  order so they agree bit for bit. out must not alias a or b.
+ */
+inline void mat4_mul_scalar(const float *a, const float *b, float *out) {
+  for (int j = 0; j < 4; j++) {
+    const float *bj = b + 4 * j;
+    for (int i = 0; i < 4; i++) {
+      out[4 * j + i] = (a[i] * bj[0] + a[4 + i] * bj[1]) +
+                       (a[8 + i] * bj[2] + a[12 + i] * bj[3]);
+    }
+  }
+}
+#ifdef VTUTO_SIMD_X86
+__attribute__((target("sse2"))) inline void
+mat4_mul_sse(const float *a, const float *b, float *out) {
+  __m128 a0 = _mm_loadu_ps(a);
+  __m128 a1 = _mm_loadu_ps(a + 4);
+  __m128 a2 = _mm_loadu_ps(a + 8);
+  __m128 a3 = _mm_loadu_ps(a + 12);
+  for (int j = 0; j < 4; j++) {
+    const float *bj = b + 4 * j;
+    __m128 c = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(bj[0])),
+                   _mm_mul_ps(a1, _mm_set1_ps(bj[1]))),
+        _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(bj[2])),
+                   _mm_mul_ps(a3, _mm_set1_ps(bj[3]))));
+    _mm_storeu_ps(out + 4 * j, c);
+  }
+}
+/** two output columns per 256 bit register */
+__attribute__((target("avx2"))) inline void
+mat4_mul_avx2(const float *a, const float *b, float *out) {
+  __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(a));
+  __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(a + 4));
+  __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(a + 8));
+  __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(a + 12));
+  for (int j = 0; j < 4; j += 2) {
+    // b[j][k] in the low half, b[j + 1][k] in the high half
+    __m256 bk[4];
+    for (int k = 0; k < 4; k++) {
+      bk[k] = _mm256_insertf128_ps(
+          _mm256_castps128_ps256(_mm_set1_ps(b[4 * j + k])),
+          _mm_set1_ps(b[4 * (j + 1) + k]), 1);
+    }
+    __m256 c = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(a0, bk[0]), _mm256_mul_ps(a1, bk[1])),
+        _mm256_add_ps(_mm256_mul_ps(a2, bk[2]), _mm256_mul_ps(a3, bk[3])));
+    _mm256_storeu_ps(out + 4 * j, c);
+  }
+}
+__attribute__((target("sse2"))) inline void
+mat4_mul_batch_sse(const glm::mat4 *a, const glm::mat4 *b, glm::mat4 *out,
+                   std::size_t n) {
+  for (std::size_t i = 0; i < n; i++) {
+    mat4_mul_sse(&a[i][0][0], &b[i][0][0], &out[i][0][0]);
+  }
+}
+__attribute__((target("avx2"))) inline void
+mat4_mul_batch_avx2(const glm::mat4 *a, const glm::mat4 *b, glm::mat4 *out,
+                    std::size_t n) {
+  for (std::size_t i = 0; i < n; i++) {
+    mat4_mul_avx2(&a[i][0][0], &b[i][0][0], &out[i][0][0]);
+  }
+}
+#endif
+
+inline void mat4_mul(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out,
+                     simd_isa isa = best_simd_isa()) {
+#ifdef VTUTO_SIMD_X86
+  if (isa == simd_isa::avx2) {
+    mat4_mul_avx2(&a[0][0], &b[0][0], &out[0][0]);
+    return;
+  }
+  if (isa == simd_isa::sse) {
+    mat4_mul_sse(&a[0][0], &b[0][0], &out[0][0]);
+    return;
+  }
+#endif
+  (void)isa;
+  mat4_mul_scalar(&a[0][0], &b[0][0], &out[0][0]);
+}
+/** out[i] = a[i] * b[i] for n matrices, the isa must be supported */
+inline void mat4_mul_batch(const glm::mat4 *a, const glm::mat4 *b,
+                           glm::mat4 *out, std::size_t n,
+                           simd_isa isa = best_simd_isa()) {
+#ifdef VTUTO_SIMD_X86
+  if (isa == simd_isa::avx2) {
+    mat4_mul_batch_avx2(a, b, out, n);
+    return;
+  }
+  if (isa == simd_isa::sse) {
+    mat4_mul_batch_sse(a, b, out, n);
+    return;
+  }
+#endif
+  for (std::size_t i = 0; i < n; i++) {
+    mat4_mul_scalar(&a[i][0][0], &b[i][0][0], &out[i][0][0]);
+  }
+}
+
+/**
+  Translation, rotation and scale of many nodes, each relative to its
+  parent.
+
+  The local components live in one array each and only nodes marked dirty,
+  or below a node whose world matrix changed, are recomputed by update().
+  A parent is always added before its children, so a single pass in index
+  order sees every parent finished before its children. The products of
+  that pass are gathered and run through mat4_mul_batch, a batch only
+  ending where a node needs the world matrix of one still in it; a
+  changed parent with many children costs one batch per child list.
+  Each world matrix remembers the version of the update that last changed
+  it, a consumer keeps the version it copied last and write_changed()
+  hands it only the matrices that moved since, straight into mapped
+  memory.
+ */
+class transform_hierarchy {
+public:
+  static constexpr uint32_t no_parent = std::numeric_limits<uint32_t>::max();
+
+private:
+  std::vector<float> tx, ty, tz;
+  /** unit quaternion */
+  std::vector<float> qx, qy, qz, qw;
+  std::vector<float> sx, sy, sz;
+  std::vector<uint32_t> parents;
+  std::vector<uint8_t> dirty;
+  std::vector<glm::mat4> worlds;
+  /** update version that last wrote each world matrix */
+  std::vector<uint64_t> changed;
+  uint64_t current = 0;
+  std::size_t recomputed = 0;
+  simd_isa isa = best_simd_isa();
+  /** products of update() not run yet, kept to reuse their storage */
+  std::vector<uint32_t> batch_nodes;
+  std::vector<glm::mat4> batch_parents;
+  std::vector<glm::mat4> batch_locals;
+  std::vector<glm::mat4> batch_out;
+  /** nodes in the batch, their world matrix is not final yet */
+  std::vector<uint8_t> batched;
+
+public:
+  transform_hierarchy() {}
+  explicit transform_hierarchy(simd_isa kernel) : isa(kernel) {}
+
+  std::size_t size() const { return parents.size(); }
+  void reserve(std::size_t n) {
+    for (auto *v : {&tx, &ty, &tz, &qx, &qy, &qz, &qw, &sx, &sy, &sz}) {
+      v->reserve(n);
+    }
+    parents.reserve(n);
+    dirty.reserve(n);
+    worlds.reserve(n);
+    changed.reserve(n);
+    batched.reserve(n);
+  }
+  /** identity node under parent, returns its index */
+  uint32_t add(uint32_t parent = no_parent) {
+    if (parent != no_parent && parent >= size()) {
+      throw std::runtime_error("transform parent must be added first");
+    }
+    for (auto *v : {&tx, &ty, &tz, &qx, &qy, &qz, &sx, &sy, &sz}) {
+      v->push_back(0.0f);
+    }
+    qw.push_back(1.0f);
+    sx.back() = sy.back() = sz.back() = 1.0f;
+    parents.push_back(parent);
+    dirty.push_back(1);
+    worlds.push_back(glm::mat4(1.0f));
+    changed.push_back(0);
+    batched.push_back(0);
+    return static_cast<uint32_t>(size() - 1);
+  }
+  /** drop the nodes from n on; nodes before n keep their state since no
+   * parent comes after its children */
+  void truncate(std::size_t n) {
+    if (n >= size()) {
+      return;
+    }
+    for (auto *v : {&tx, &ty, &tz, &qx, &qy, &qz, &qw, &sx, &sy, &sz}) {
+      v->resize(n);
+    }
+    parents.resize(n);
+    dirty.resize(n);
+    worlds.resize(n);
+    changed.resize(n);
+    batched.resize(n);
+  }
+  uint32_t parent(uint32_t node) const { return parents[node]; }
+
+  void set_translation(uint32_t node, const glm::vec3 &t) {
+    tx[node] = t.x;
+    ty[node] = t.y;
+    tz[node] = t.z;
+    dirty[node] = 1;
+  }
+  /** angle in radians around a unit axis */
+  void set_rotation(uint32_t node, float angle, const glm::vec3 &axis) {
+    float s = std::sin(0.5f * angle);
+    qx[node] = axis.x * s;
+    qy[node] = axis.y * s;
+    qz[node] = axis.z * s;
+    qw[node] = std::cos(0.5f * angle);
+    dirty[node] = 1;
+  }
+  void set_scale(uint32_t node, const glm::vec3 &s) {
+    sx[node] = s.x;
+    sy[node] = s.y;
+    sz[node] = s.z;
+    dirty[node] = 1;
+  }
+
+  /** translate * rotate * scale of the node alone */
+  glm::mat4 local(uint32_t i) const {
+    float x = qx[i], y = qy[i], z = qz[i], w = qw[i];
+    glm::mat4 m(1.0f);
+    m[0] = glm::vec4(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z),
+                     2.0f * (x * z - w * y), 0.0f) *
+           sx[i];
+    m[1] = glm::vec4(2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z),
+                     2.0f * (y * z + w * x), 0.0f) *
+           sy[i];
+    m[2] = glm::vec4(2.0f * (x * z + w * y), 2.0f * (y * z - w * x),
+                     1.0f - 2.0f * (x * x + y * y), 0.0f) *
+           sz[i];
+    m[3] = glm::vec4(tx[i], ty[i], tz[i], 1.0f);
+    return m;
+  }
+
+  /**
+    Recompute the world matrix of every dirty node and of everything below
+    one, returns how many were recomputed. Nothing changes the version when
+    nothing was dirty.
+   */
+  std::size_t update() {
+    const uint64_t next = current + 1;
+    recomputed = 0;
+    for (std::size_t i = 0; i < size(); i++) {
+      uint32_t p = parents[i];
+      bool moved = p != no_parent && changed[p] == next;
+      if (!dirty[i] && !moved) {
+        continue;
+      }
+      if (p == no_parent) {
+        worlds[i] = local(static_cast<uint32_t>(i));
+      } else {
+        if (batched[p]) {
+          flush_batch();
+        }
+        batch_nodes.push_back(static_cast<uint32_t>(i));
+        batch_parents.push_back(worlds[p]);
+        batch_locals.push_back(local(static_cast<uint32_t>(i)));
+        batched[i] = 1;
+      }
+      dirty[i] = 0;
+      changed[i] = next;
+      recomputed++;
+    }
+    flush_batch();
+    if (recomputed > 0) {
+      current = next;
+    }
+    return recomputed;
+  }
+  /** bumped by every update that recomputed something, starts at 0 */
+  uint64_t version() const { return current; }
+  std::size_t last_recomputed() const { return recomputed; }
+  const glm::mat4 &world(uint32_t node) const { return worlds[node]; }
+  /** true when the node's world matrix changed after version since */
+  bool changed_since(uint32_t node, uint64_t since) const {
+    return changed[node] > since;
+  }
+
+  /**
+    Copy the world matrices of nodes [first, first + count) that changed
+    after version since to dst[node - first], the others are left as they
+    are. Out is any 64 byte matrix type, glm::mat4 or InstanceData, and dst
+    usually mapped memory. Returns how many were written.
+   */
+  template <class Out>
+  std::size_t write_changed(Out *dst, uint64_t since, uint32_t first,
+                            uint32_t count) const {
+    static_assert(sizeof(Out) == sizeof(glm::mat4),
+                  "write_changed copies whole 4x4 float matrices");
+    std::size_t written = 0;
+    for (uint32_t k = 0; k < count; k++) {
+      if (changed[first + k] > since) {
+        std::memcpy(static_cast<void *>(&dst[k]), &worlds[first + k],
+                    sizeof(glm::mat4));
+        written++;
+      }
+    }
+    return written;
+  }
+
+private:
+  /** run the gathered products and store them as world matrices */
+  void flush_batch() {
+    const std::size_t n = batch_nodes.size();
+    if (n == 0) {
+      return;
+    }
+    batch_out.resize(n);
+    mat4_mul_batch(batch_parents.data(), batch_locals.data(),
+                   batch_out.data(), n, isa);
+    for (std::size_t k = 0; k < n; k++) {
+      worlds[batch_nodes[k]] = batch_out[k];
+      batched[batch_nodes[k]] = 0;
+    }
+    batch_nodes.clear();
+    batch_parents.clear();
+    batch_locals.clear();
+  }
+};
+
+} // namespace vtuto
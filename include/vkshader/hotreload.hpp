@@ -0,0 +1,129 @@
+// results of rebuilding a graphics pipeline from shaders changed on disk
+#pragma once
+#include <cstring>
+#include <external.hpp>
+#include <ostream>
+#include <sstream>
+#include <vkpipeline/pipelinestate.hpp>
+#include <vkshader/watcher.hpp>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define VTUTO_HAS_SPAWN 1
+#include <errno.h>
+#include <spawn.h>
+#include <sys/wait.h>
+extern char **environ;
+#endif
+
+namespace vtuto {
+
+/** true for the glsl sources next to the spir-v, e.g. vulkansimple.frag */
+inline bool is_shader_source(const std::string &path) {
+  for (const char *ext : {".vert", ".frag", ".comp"}) {
+    const std::size_t n = std::strlen(ext);
+    if (path.size() > n && path.compare(path.size() - n, n, ext) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+/** where the sources are compiled to, vulkansimple.frag.spv */
+inline std::string spirv_path(const std::string &source) {
+  return source + ".spv";
+}
+/**
+  Run compiler on source, writing spirv_path(source), true when it exits
+  with 0. No shell is involved: compiler is split on spaces into the
+  program, looked up in PATH, and its leading arguments, the paths are
+  arguments of their own, so a file name is never read as a command.
+ */
+inline bool compile_shader(const std::string &compiler,
+                           const std::string &source) {
+#ifdef VTUTO_HAS_SPAWN
+  std::vector<std::string> args;
+  std::istringstream words(compiler);
+  for (std::string w; words >> w;) {
+    args.push_back(w);
+  }
+  if (args.empty()) {
+    return false;
+  }
+  args.push_back(source);
+  args.push_back("-o");
+  args.push_back(spirv_path(source));
+  std::vector<char *> argv;
+  for (std::string &a : args) {
+    argv.push_back(&a[0]);
+  }
+  argv.push_back(nullptr);
+
+  pid_t pid = 0;
+  if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) !=
+      0) {
+    return false;
+  }
+  int status = 0;
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR) {
+      return false;
+    }
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#else
+  (void)compiler;
+  (void)source;
+  return false;
+#endif
+}
+
+/**
+  A graphics pipeline rebuilt off the render thread.
+
+  Holds one reference on each of its modules; whoever takes the result
+  either keeps them with the pipeline or releases them. unchanged means
+  the files came back with the bytes already in use and nothing was
+  built.
+ */
+struct shader_reload {
+  graphics_pipeline_desc desc;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  std::array<VkShaderModule, 2> modules{};
+  VkResult result = VK_SUCCESS;
+  bool unchanged = false;
+  std::string error;
+  double us = 0.0;
+};
+
+/** what hot reloading did over a run */
+struct shader_reload_stats {
+  /** watched files written that a pipeline uses */
+  uint64_t changes = 0;
+  uint64_t rebuilds = 0;
+  uint64_t swaps = 0;
+  uint64_t unchanged = 0;
+  uint64_t failed = 0;
+  /** built against a render pass or layout replaced meanwhile */
+  uint64_t stale = 0;
+  double last_us = 0.0;
+  double max_us = 0.0;
+
+  void add(const shader_reload &r) {
+    rebuilds++;
+    last_us = r.us;
+    if (r.us > max_us) {
+      max_us = r.us;
+    }
+  }
+  void report(std::ostream &out) const {
+    out << "hotreload.changes " << changes << std::endl;
+    out << "hotreload.rebuilds " << rebuilds << std::endl;
+    out << "hotreload.swaps " << swaps << std::endl;
+    out << "hotreload.unchanged " << unchanged << std::endl;
+    out << "hotreload.failed " << failed << std::endl;
+    out << "hotreload.stale " << stale << std::endl;
+    out << "hotreload.last_us " << last_us << std::endl;
+    out << "hotreload.max_us " << max_us << std::endl;
+  }
+};
+
+} // namespace vtuto
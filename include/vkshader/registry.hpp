@@ -0,0 +1,218 @@
+// shader modules shared by content, created once per spir-v blob
+#pragma once
+
+#include <cstring>
+#include <external.hpp>
+#include <mutex>
+#include <vkutils/ioutils.hpp>
+
+namespace vtuto {
+
+/** 64 bit fnv-1a of a spir-v blob, seeded with its size */
+inline uint64_t spirv_hash(const char *bytes, std::size_t size) {
+  uint64_t h = 14695981039346656037ull ^ static_cast<uint64_t>(size);
+  for (std::size_t i = 0; i < size; i++) {
+    h ^= static_cast<unsigned char>(bytes[i]);
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+/** file and module traffic of a shader_registry */
+struct shader_registry_stats {
+  /** .spv files mapped and hashed */
+  uint64_t files_mapped = 0;
+  uint64_t bytes_mapped = 0;
+  uint64_t modules_created = 0;
+  uint64_t modules_destroyed = 0;
+  /** acquires answered from a path seen before, no file i/o */
+  uint64_t path_hits = 0;
+  /** new paths whose content an existing module already had */
+  uint64_t content_hits = 0;
+  /** different spir-v found under a hash already taken */
+  uint64_t hash_collisions = 0;
+};
+
+/**
+  VkShaderModules keyed by the hash of their spir-v.
+
+  A path is mapped and hashed the first time it is acquired, later acquires
+  of the same path only look it up, so rebuilding a pipeline reads nothing
+  from disk. Two paths with identical bytes share one module: each module
+  keeps a copy of its spir-v and a hash match only shares it when the
+  bytes match too. Different bytes under a taken hash move on to the next
+  free key, so a key always names one content. Each acquire takes a
+  reference and release() drops it; the module is destroyed with its last
+  reference, and the path is forgotten with it so a later acquire sees the
+  file as it is then. invalidate() forgets a path right away, for files
+  rewritten while their module is still held. Every method may be called
+  from any thread.
+ */
+class shader_registry {
+  struct entry {
+    VkShaderModule module = VK_NULL_HANDLE;
+    uint32_t refs = 0;
+    /** what the module was created from, compared on a hash match */
+    std::vector<char> code;
+  };
+  std::unordered_map<uint64_t, entry> modules;
+  std::unordered_map<std::string, uint64_t> paths;
+  shader_registry_stats counters;
+  mutable std::mutex mtx;
+
+  std::unordered_map<uint64_t, entry>::iterator
+  find_module(VkShaderModule module) {
+    for (auto it = modules.begin(); it != modules.end(); it++) {
+      if (it->second.module == module) {
+        return it;
+      }
+    }
+    return modules.end();
+  }
+  void forget_paths(uint64_t key) {
+    for (auto it = paths.begin(); it != paths.end();) {
+      if (it->second == key) {
+        it = paths.erase(it);
+      } else {
+        it++;
+      }
+    }
+  }
+
+public:
+  shader_registry() {}
+
+  /**
+    Module of the spir-v at path with one more reference. Returns
+    VK_ERROR_INITIALIZATION_FAILED when the file is missing or is not whole
+    32 bit words.
+   */
+  VkResult acquire(VkDevice device, const std::string &path,
+                   VkShaderModule &module) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto known = paths.find(path);
+    if (known != paths.end()) {
+      entry &e = modules[known->second];
+      e.refs++;
+      counters.path_hits++;
+      module = e.module;
+      return VK_SUCCESS;
+    }
+    mapped_file file(path);
+    if (!file.ok() || file.size() % sizeof(uint32_t) != 0) {
+      return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    counters.files_mapped++;
+    counters.bytes_mapped += file.size();
+    uint64_t key = spirv_hash(file.data(), file.size());
+    for (auto same = modules.find(key); same != modules.end();
+         same = modules.find(key)) {
+      const std::vector<char> &code = same->second.code;
+      if (code.size() == file.size() &&
+          std::memcmp(code.data(), file.data(), file.size()) == 0) {
+        same->second.refs++;
+        counters.content_hits++;
+        paths[path] = key;
+        module = same->second.module;
+        return VK_SUCCESS;
+      }
+      counters.hash_collisions++;
+      // 0 means no module to content_hash
+      key = key + 1 == 0 ? 1 : key + 1;
+    }
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = file.size();
+    createInfo.pCode = reinterpret_cast<const uint32_t *>(file.data());
+    VkShaderModule created = VK_NULL_HANDLE;
+    VkResult r = vkCreateShaderModule(device, &createInfo, nullptr, &created);
+    if (r != VK_SUCCESS) {
+      return r;
+    }
+    counters.modules_created++;
+    entry e;
+    e.module = created;
+    e.refs = 1;
+    e.code.assign(file.data(), file.data() + file.size());
+    modules[key] = std::move(e);
+    paths[path] = key;
+    module = created;
+    return VK_SUCCESS;
+  }
+  /** drop a reference taken by acquire, unknown handles are ignored */
+  void release(VkDevice device, VkShaderModule module) {
+    if (module == VK_NULL_HANDLE) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = find_module(module);
+    if (it == modules.end() || it->second.refs == 0) {
+      return;
+    }
+    if (--it->second.refs > 0) {
+      return;
+    }
+    vkDestroyShaderModule(device, it->second.module, nullptr);
+    counters.modules_destroyed++;
+    forget_paths(it->first);
+    modules.erase(it);
+  }
+  /** key of the module's spir-v, its hash unless that was taken by other
+   * bytes; 0 for a module not from this registry */
+  uint64_t content_hash(VkShaderModule module) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (const auto &kv : modules) {
+      if (kv.second.module == module) {
+        return kv.first;
+      }
+    }
+    return 0;
+  }
+  /** true without touching the disk when path is already registered */
+  bool available(const std::string &path) const {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (paths.count(path) > 0) {
+        return true;
+      }
+    }
+    return file_exists(path);
+  }
+  /**
+    Next acquire of path reads the file again. Modules already handed out
+    keep living until released, a changed file gets a module of its own.
+   */
+  void invalidate(const std::string &path) {
+    std::lock_guard<std::mutex> lock(mtx);
+    paths.erase(path);
+  }
+  std::size_t size() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return modules.size();
+  }
+  shader_registry_stats stats() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return counters;
+  }
+  /** destroy every module whatever its references */
+  void destroy(VkDevice device) {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (auto &kv : modules) {
+      vkDestroyShaderModule(device, kv.second.module, nullptr);
+      counters.modules_destroyed++;
+    }
+    modules.clear();
+    paths.clear();
+  }
+  void report(std::ostream &out) const {
+    shader_registry_stats s = stats();
+    out << "shaders.files_mapped " << s.files_mapped << std::endl;
+    out << "shaders.bytes_mapped " << s.bytes_mapped << std::endl;
+    out << "shaders.modules_created " << s.modules_created << std::endl;
+    out << "shaders.path_hits " << s.path_hits << std::endl;
+    out << "shaders.content_hits " << s.content_hits << std::endl;
+    out << "shaders.hash_collisions " << s.hash_collisions << std::endl;
+  }
+};
+
+} // namespace vtuto
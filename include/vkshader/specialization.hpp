@@ -0,0 +1,133 @@
+// specialization constants built from the fields of a c++ struct
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <external.hpp>
+#include <type_traits>
+
+namespace vtuto {
+
+/**
+  Specialization constants of one shader stage together with their bytes.
+
+  Values are copied in when added, so the VkSpecializationInfo handed out
+  by info() points into this object alone: it stays valid for as long as
+  the object lives unchanged, wherever the values came from. Entries are
+  kept sorted by constant id, which makes equal sets of constants compare
+  and hash equal whatever order they were added in.
+ */
+class specialization_data {
+  std::vector<VkSpecializationMapEntry> entries;
+  std::vector<char> bytes;
+
+public:
+  specialization_data() {}
+
+  /** set constant id, a second add of the same id replaces its value */
+  void add(uint32_t id, const void *value, std::size_t size) {
+    auto it = std::lower_bound(
+        entries.begin(), entries.end(), id,
+        [](const VkSpecializationMapEntry &e, uint32_t v) {
+          return e.constantID < v;
+        });
+    if (it != entries.end() && it->constantID == id) {
+      if (it->size != size) {
+        throw std::runtime_error("specialization constant " +
+                                 std::to_string(id) + " changed its size");
+      }
+      std::memcpy(bytes.data() + it->offset, value, size);
+      return;
+    }
+    VkSpecializationMapEntry e{};
+    e.constantID = id;
+    e.offset = static_cast<uint32_t>(bytes.size());
+    e.size = size;
+    entries.insert(it, e);
+    const char *v = static_cast<const char *>(value);
+    bytes.insert(bytes.end(), v, v + size);
+  }
+  bool empty() const { return entries.empty(); }
+  std::size_t size() const { return entries.size(); }
+
+  /** points into this object, keep it alive while the info is used */
+  VkSpecializationInfo info() const {
+    VkSpecializationInfo i{};
+    i.mapEntryCount = static_cast<uint32_t>(entries.size());
+    i.pMapEntries = entries.data();
+    i.dataSize = bytes.size();
+    i.pData = bytes.data();
+    return i;
+  }
+
+  uint64_t hash() const {
+    // fnv-1a over ids, sizes and values
+    uint64_t h = 14695981039346656037ull;
+    auto mix = [&h](const void *p, std::size_t n) {
+      const unsigned char *c = static_cast<const unsigned char *>(p);
+      for (std::size_t i = 0; i < n; i++) {
+        h ^= c[i];
+        h *= 1099511628211ull;
+      }
+    };
+    for (const auto &e : entries) {
+      uint64_t size = e.size;
+      mix(&e.constantID, sizeof(e.constantID));
+      mix(&size, sizeof(size));
+      mix(bytes.data() + e.offset, e.size);
+    }
+    return h;
+  }
+  bool operator==(const specialization_data &o) const {
+    if (entries.size() != o.entries.size()) {
+      return false;
+    }
+    // offsets depend on the order of the adds, compare the values
+    for (std::size_t i = 0; i < entries.size(); i++) {
+      const VkSpecializationMapEntry &e = entries[i];
+      const VkSpecializationMapEntry &f = o.entries[i];
+      if (e.constantID != f.constantID || e.size != f.size ||
+          std::memcmp(bytes.data() + e.offset, o.bytes.data() + f.offset,
+                      e.size) != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+  bool operator!=(const specialization_data &o) const { return !(*this == o); }
+};
+
+/**
+  Typed builder of specialization_data from a parameter struct.
+
+  Each constant names a field of Params by member pointer, so an id can
+  only be bound to a field that exists and has a type spir-v can
+  specialize: 32 or 64 bit integers and floats, VkBool32 for booleans.
+
+    struct cull_shader_constants { uint32_t workgroup_size; VkBool32 far; };
+    specialization<cull_shader_constants> spec(values);
+    spec.constant(0, &cull_shader_constants::workgroup_size)
+        .constant(1, &cull_shader_constants::far);
+    VkSpecializationInfo info = spec.data().info();
+ */
+template <class Params> class specialization {
+  Params values;
+  specialization_data constants;
+
+public:
+  explicit specialization(const Params &params) : values(params) {}
+
+  template <class Field>
+  specialization &constant(uint32_t id, Field Params::*field) {
+    static_assert(std::is_arithmetic<Field>::value &&
+                      !std::is_same<Field, bool>::value,
+                  "specialization constants are scalars, VkBool32 for bool");
+    static_assert(sizeof(Field) == 4 || sizeof(Field) == 8,
+                  "specialization constants are 32 or 64 bit wide");
+    constants.add(id, &(values.*field), sizeof(Field));
+    return *this;
+  }
+  const Params &params() const { return values; }
+  const specialization_data &data() const { return constants; }
+};
+
+} // namespace vtuto
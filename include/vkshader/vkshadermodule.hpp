@@ -2,6 +2,7 @@
 #pragma once
 
 #include <external.hpp>
+#include <vkshader/specialization.hpp>
 #include <vkutils/ioutils.hpp>
 
 namespace vtuto {
@@ -30,31 +31,45 @@ of the memory
 addressed by pCode.
  */
 struct ShaderModuleCreateInfoVk {
-  VkShaderModuleCreateInfo createInfo;
+  VkShaderModuleCreateInfo createInfo{};
+  /** code read from a path, createInfo.pCode points into it */
+  std::vector<char> ownedCode;
   //
 
+  /**
+    chain pNext, a pointer is stored as is, a value by its address inside
+    the optional: either must outlive the create call
+   */
   template <typename T> void set(std::optional<T> &pNext) {
     if (pNext.has_value()) {
-      auto val = pNext.value();
-      if (std::is_pointer(T)) {
-        createInfo.pNext = static_cast<void *>(val);
+      if constexpr (std::is_pointer<T>::value) {
+        createInfo.pNext = pNext.value();
       } else {
-        createInfo.pNext = static_cast<void *>(&val);
+        createInfo.pNext = &pNext.value();
       }
     }
   }
-  ShaderModuleCreateInfoVk(const std::array<char> &shaderCode) {
+  /** points at shaderCode, which must outlive the create call */
+  ShaderModuleCreateInfoVk(const std::vector<char> &shaderCode) {
     //
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     createInfo.codeSize = shaderCode.size();
     createInfo.pCode = reinterpret_cast<const uint32_t *>(shaderCode.data());
   }
-  ShaderModuleCreateInfoVk(const std::string &shaderPath) {
-    auto shaderCode = readFile(shaderPath);
+  ShaderModuleCreateInfoVk(const std::string &shaderPath)
+      : ownedCode(readFile(shaderPath)) {
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = shaderCode.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t *>(shaderCode.data());
+    createInfo.codeSize = ownedCode.size();
+    createInfo.pCode = reinterpret_cast<const uint32_t *>(ownedCode.data());
+  }
+  ShaderModuleCreateInfoVk(const ShaderModuleCreateInfoVk &o)
+      : createInfo(o.createInfo), ownedCode(o.ownedCode) {
+    if (!ownedCode.empty()) {
+      createInfo.pCode = reinterpret_cast<const uint32_t *>(ownedCode.data());
+    }
   }
+  ShaderModuleCreateInfoVk &operator=(const ShaderModuleCreateInfoVk &) =
+      delete;
 };
 /**
 typedef struct VkPipelineShaderStageCreateInfo {
@@ -93,46 +108,69 @@ described in Specialization Constants, or NULL.
  */
 struct PipelineShaderStageCreateInfoVk {
   //
-  VkPipelineShaderStageCreateInfo createInfo;
-
+  VkPipelineShaderStageCreateInfo createInfo{};
+  /** what pName and pSpecializationInfo point at, owned by the struct */
+  std::string entryName = "main";
+  specialization_data constants;
+  VkSpecializationInfo specialInfo{};
+
+  /**
+    chain pNext, a pointer is stored as is, a value by its address inside
+    the optional: either must outlive the create call
+   */
   template <typename T> void set(std::optional<T> &pNext) {
     if (pNext.has_value()) {
-      auto val = pNext.value();
-      if (std::is_pointer(T)) {
-        createInfo.pNext = static_cast<void *>(val);
+      if constexpr (std::is_pointer<T>::value) {
+        createInfo.pNext = pNext.value();
       } else {
-        createInfo.pNext = static_cast<void *>(&val);
+        createInfo.pNext = &pNext.value();
       }
     }
   }
-  template <VkShaderStageFlagBits stageFlag>
   PipelineShaderStageCreateInfoVk(
-      std::optional<std::array<VkPipelineShaderStageCreateFlagBits>>
-          &flagRefs, //
-      std::optional<std::string> &pname,
-      std::optional<VkSpecializationInfo> &specialInfoRef,
-      VkShaderModule &shaderModule) {
+      VkShaderStageFlagBits stageFlag,
+      const std::optional<VkPipelineShaderStageCreateFlags> &flagRefs, //
+      const std::optional<std::string> &pname,
+      const std::optional<specialization_data> &specialRefs,
+      VkShaderModule shaderModule) {
     createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     createInfo.stage = stageFlag;
     if (flagRefs.has_value()) {
-      auto flags = flagRefs.value();
-      VkPipelineShaderStageCreateFlags f = flags[0];
-      for (unsigned int i = 1; i < flags.size(); i++) {
-        f |= flags[i];
-      }
-      createInfo.flags = f;
+      createInfo.flags = flagRefs.value();
     }
     //
     createInfo.module = shaderModule;
 
     if (pname.has_value()) {
-      std::string sval = pname.value();
-      createInfo.pName = sval.c_str();
-    } else {
-      createInfo.pName = "main";
+      entryName = pname.value();
     }
-    if (specialInfoRef.has_value()) {
-      auto specialInfo = specialInfoRef.value();
+    if (specialRefs.has_value()) {
+      constants = specialRefs.value();
+    }
+    point_inside();
+  }
+  PipelineShaderStageCreateInfoVk(const PipelineShaderStageCreateInfoVk &o)
+      : createInfo(o.createInfo), entryName(o.entryName),
+        constants(o.constants) {
+    point_inside();
+  }
+  PipelineShaderStageCreateInfoVk &
+  operator=(const PipelineShaderStageCreateInfoVk &o) {
+    createInfo = o.createInfo;
+    entryName = o.entryName;
+    constants = o.constants;
+    point_inside();
+    return *this;
+  }
+
+private:
+  /** pointers of createInfo into this object, redone by every copy */
+  void point_inside() {
+    createInfo.pName = entryName.c_str();
+    if (constants.empty()) {
+      createInfo.pSpecializationInfo = nullptr;
+    } else {
+      specialInfo = constants.info();
       createInfo.pSpecializationInfo = &specialInfo;
     }
   }
@@ -0,0 +1,137 @@
+// files changed under a shader directory, reported without blocking
+#pragma once
+#include <external.hpp>
+#include <set>
+
+#if defined(__linux__)
+#define VTUTO_HAS_INOTIFY 1
+#include <dirent.h>
+#include <errno.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace vtuto {
+
+/**
+  Watches a directory tree for files written or moved into place.
+
+  Built on inotify where it exists: every directory under the root gets a
+  watch, including ones created later, and poll() drains the events on a
+  non blocking descriptor, so calling it every frame costs one read that
+  usually comes back empty. Several events for one file, as editors
+  produce when they save through a temporary, are reported once per
+  poll(). Without inotify start() fails and nothing is ever reported.
+ */
+class shader_watcher {
+#ifdef VTUTO_HAS_INOTIFY
+  int fd = -1;
+  std::unordered_map<int, std::string> dirs;
+
+  void watch_tree(const std::string &dir) {
+    int wd = inotify_add_watch(fd, dir.c_str(),
+                               IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (wd < 0) {
+      return;
+    }
+    dirs[wd] = dir;
+    DIR *d = opendir(dir.c_str());
+    if (d == nullptr) {
+      return;
+    }
+    while (dirent *e = readdir(d)) {
+      std::string name = e->d_name;
+      if (name == "." || name == "..") {
+        continue;
+      }
+      if (e->d_type == DT_DIR) {
+        watch_tree(dir + "/" + name);
+      }
+    }
+    closedir(d);
+  }
+#endif
+
+public:
+  shader_watcher() {}
+  shader_watcher(const shader_watcher &) = delete;
+  shader_watcher &operator=(const shader_watcher &) = delete;
+  ~shader_watcher() { stop(); }
+
+  /** false when the tree can not be watched */
+  bool start(const std::string &root) {
+#ifdef VTUTO_HAS_INOTIFY
+    stop();
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+      return false;
+    }
+    watch_tree(root);
+    if (dirs.empty()) {
+      stop();
+      return false;
+    }
+    return true;
+#else
+    (void)root;
+    return false;
+#endif
+  }
+  void stop() {
+#ifdef VTUTO_HAS_INOTIFY
+    if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+    dirs.clear();
+#endif
+  }
+  bool watching() const {
+#ifdef VTUTO_HAS_INOTIFY
+    return fd >= 0;
+#else
+    return false;
+#endif
+  }
+
+  /** paths written since the last poll, never blocks */
+  std::set<std::string> poll() {
+    std::set<std::string> changed;
+#ifdef VTUTO_HAS_INOTIFY
+    if (fd < 0) {
+      return changed;
+    }
+    alignas(inotify_event) char buffer[4096];
+    for (;;) {
+      ssize_t n = ::read(fd, buffer, sizeof(buffer));
+      if (n <= 0) {
+        // EAGAIN once drained
+        break;
+      }
+      for (ssize_t off = 0; off < n;) {
+        const inotify_event *ev =
+            reinterpret_cast<const inotify_event *>(buffer + off);
+        off += static_cast<ssize_t>(sizeof(inotify_event) + ev->len);
+        auto dir = dirs.find(ev->wd);
+        if (dir == dirs.end() || ev->len == 0) {
+          continue;
+        }
+        std::string path = dir->second + "/" + ev->name;
+        if (ev->mask & IN_ISDIR) {
+          if (ev->mask & IN_CREATE) {
+            watch_tree(path);
+          }
+          continue;
+        }
+        // created files are reported once written and closed
+        if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+          changed.insert(path);
+        }
+      }
+    }
+#endif
+    return changed;
+  }
+};
+
+} // namespace vtuto
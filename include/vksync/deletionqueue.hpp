@@ -0,0 +1,155 @@
+// deferred destruction of vulkan handles still referenced by frames in flight
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <external.hpp>
+#include <functional>
+#include <utility>
+
+namespace vtuto {
+
+/** counters of a deletion queue */
+struct deletion_queue_stats {
+  std::size_t pending = 0;
+  std::size_t peak_pending = 0;
+  uint64_t enqueued = 0;
+  uint64_t destroyed = 0;
+  uint64_t collections = 0;
+};
+
+/**
+  Queue of deleters that run once the gpu is done with a frame.
+
+  Each submitted frame gets a serial, its timeline value. A deleter pushed
+  while frames up to serial N are in flight is tagged with N and only runs
+  when collect() is told that N completed, that is after the cpu waited
+  for that value. Since reaching a value also covers what was submitted
+  before it on the queue, keying the entries by serial rather than by slot
+  index keeps the order correct even when a frame bails out before
+  submitting (out of date acquire). Deleters run in push order.
+ */
+class deletion_queue {
+  struct entry {
+    uint64_t serial;
+    std::function<void()> deleter;
+  };
+  std::deque<entry> entries;
+  uint64_t last_submitted = 0;
+  deletion_queue_stats qstats;
+
+public:
+  deletion_queue() {}
+  deletion_queue(const deletion_queue &) = delete;
+  deletion_queue &operator=(const deletion_queue &) = delete;
+
+  /** a frame with the given serial was handed to the queue */
+  void submitted(uint64_t serial) { last_submitted = serial; }
+  uint64_t submitted_serial() const { return last_submitted; }
+
+  /** defer fn until every frame submitted so far has completed */
+  void push(std::function<void()> fn) {
+    entries.push_back(entry{last_submitted, std::move(fn)});
+    qstats.enqueued++;
+    qstats.pending = entries.size();
+    if (qstats.pending > qstats.peak_pending) {
+      qstats.peak_pending = qstats.pending;
+    }
+  }
+
+  /** defer a vkDestroy* style call: destroy_fn(device, handle, nullptr) */
+  template <class Handle, class DestroyFn>
+  void destroy(VkDevice device, Handle handle, DestroyFn destroy_fn) {
+    if (handle == VK_NULL_HANDLE) {
+      return;
+    }
+    push([device, handle, destroy_fn]() {
+      destroy_fn(device, handle, nullptr);
+    });
+  }
+
+  /** run every deleter whose frames completed, returns how many ran */
+  std::size_t collect(uint64_t completed_serial) {
+    std::size_t count = 0;
+    while (!entries.empty() && entries.front().serial <= completed_serial) {
+      // pop first, a deleter may push new entries
+      auto fn = std::move(entries.front().deleter);
+      entries.pop_front();
+      fn();
+      count++;
+    }
+    qstats.collections++;
+    qstats.destroyed += count;
+    qstats.pending = entries.size();
+    return count;
+  }
+
+  /** run everything, the caller must know the device is idle */
+  std::size_t flush() { return collect(UINT64_MAX); }
+
+  bool empty() const { return entries.empty(); }
+  const deletion_queue_stats &stats() const { return qstats; }
+};
+
+/**
+  Owning handle whose destruction is deferred through a deletion queue.
+
+  Going out of scope or being reset hands the handle to the queue instead
+  of destroying it on the spot, so an object can be dropped while a frame
+  in flight still uses it. Move only.
+ */
+template <class Handle> class deferred {
+  Handle handle = VK_NULL_HANDLE;
+  deletion_queue *queue = nullptr;
+  std::function<void(Handle)> deleter;
+
+public:
+  deferred() {}
+  deferred(deletion_queue &q, Handle h, std::function<void(Handle)> d)
+      : handle(h), queue(&q), deleter(std::move(d)) {}
+  /** wrap a vkDestroy* style function */
+  template <class DestroyFn>
+  deferred(deletion_queue &q, VkDevice device, Handle h, DestroyFn destroy_fn)
+      : handle(h), queue(&q), deleter([device, destroy_fn](Handle x) {
+          destroy_fn(device, x, nullptr);
+        }) {}
+
+  deferred(const deferred &) = delete;
+  deferred &operator=(const deferred &) = delete;
+  deferred(deferred &&other) noexcept
+      : handle(other.handle), queue(other.queue),
+        deleter(std::move(other.deleter)) {
+    other.handle = VK_NULL_HANDLE;
+  }
+  deferred &operator=(deferred &&other) noexcept {
+    if (this != &other) {
+      reset();
+      handle = other.handle;
+      queue = other.queue;
+      deleter = std::move(other.deleter);
+      other.handle = VK_NULL_HANDLE;
+    }
+    return *this;
+  }
+  ~deferred() { reset(); }
+
+  Handle get() const { return handle; }
+  explicit operator bool() const { return handle != VK_NULL_HANDLE; }
+
+  /** enqueue the current handle for destruction and own h instead */
+  void reset(Handle h = VK_NULL_HANDLE) {
+    if (handle != VK_NULL_HANDLE && queue != nullptr) {
+      Handle old = handle;
+      auto fn = deleter;
+      queue->push([fn, old]() { fn(old); });
+    }
+    handle = h;
+  }
+  /** give up ownership without destroying */
+  Handle release() {
+    Handle h = handle;
+    handle = VK_NULL_HANDLE;
+    return h;
+  }
+};
+
+} // namespace vtuto
@@ -0,0 +1,191 @@
+// frame pacing settings and submit to present latency measurements
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <external.hpp>
+
+namespace vtuto {
+
+/**
+  Runtime frame pacing settings.
+
+  Throughput wants the cpu far ahead of the display: mailbox or immediate
+  present and three frames in flight. Latency wants the opposite: fifo,
+  one frame in flight and waiting for the previous frame before acquiring,
+  so input is sampled as late as possible.
+ */
+struct frame_pacing_config {
+  /** present modes in order of preference, fifo is always the fallback
+   * since every device supports it */
+  std::vector<VkPresentModeKHR> present_modes = {VK_PRESENT_MODE_MAILBOX_KHR};
+  /** frames the cpu may record ahead of the gpu */
+  std::size_t frames_in_flight = 2;
+  /** swapchain images, 0 takes the surface minimum plus one */
+  uint32_t image_count = 0;
+  /** wait for the last submitted frame before acquiring the next image */
+  bool wait_before_acquire = false;
+
+  static frame_pacing_config throughput() {
+    frame_pacing_config c;
+    c.present_modes = {VK_PRESENT_MODE_MAILBOX_KHR,
+                       VK_PRESENT_MODE_IMMEDIATE_KHR};
+    c.frames_in_flight = 3;
+    c.image_count = 3;
+    return c;
+  }
+  static frame_pacing_config low_latency() {
+    frame_pacing_config c;
+    c.present_modes = {VK_PRESENT_MODE_FIFO_KHR};
+    c.frames_in_flight = 1;
+    c.wait_before_acquire = true;
+    return c;
+  }
+  /** the preset called name, throughput or latency; false for others */
+  static bool preset(const std::string &name, frame_pacing_config &c) {
+    if (name == "throughput") {
+      c = throughput();
+    } else if (name == "latency") {
+      c = low_latency();
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  VkPresentModeKHR
+  choose_present_mode(const std::vector<VkPresentModeKHR> &availables) const {
+    for (VkPresentModeKHR wanted : present_modes) {
+      if (std::find(availables.begin(), availables.end(), wanted) !=
+          availables.end()) {
+        return wanted;
+      }
+    }
+    return VK_PRESENT_MODE_FIFO_KHR;
+  }
+  /** requested image count clamped to what the surface allows */
+  uint32_t choose_image_count(const VkSurfaceCapabilitiesKHR &caps) const {
+    uint32_t count = image_count == 0 ? caps.minImageCount + 1 : image_count;
+    count = std::max(count, caps.minImageCount);
+    if (caps.maxImageCount > 0) {
+      count = std::min(count, caps.maxImageCount);
+    }
+    return count;
+  }
+};
+
+inline const char *present_mode_name(VkPresentModeKHR mode) {
+  switch (mode) {
+  case VK_PRESENT_MODE_IMMEDIATE_KHR:
+    return "immediate";
+  case VK_PRESENT_MODE_MAILBOX_KHR:
+    return "mailbox";
+  case VK_PRESENT_MODE_FIFO_KHR:
+    return "fifo";
+  case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+    return "fifo_relaxed";
+  default:
+    return "other";
+  }
+}
+
+/** latency figures over the last samples, in microseconds */
+struct latency_stats {
+  std::size_t samples = 0;
+  double average_us = 0.0;
+  double p50_us = 0.0;
+  double p99_us = 0.0;
+  double max_us = 0.0;
+};
+
+/**
+  Submit to present latency per frame.
+
+  A frame is stamped when its graphics submit is handed to the queue and
+  closed when the cpu sees its timeline value reached; its present then
+  only waits for the display. The completion is observed at poll points,
+  so a sample is an upper bound that is exact when the cpu blocked on the
+  value (one frame in flight) and otherwise off by at most the time
+  between two polls. The time spent in vkQueuePresentKHR, which blocks in
+  fifo on some drivers, is tracked on its own.
+ */
+class latency_tracker {
+  typedef std::chrono::steady_clock clock;
+  struct pending {
+    uint64_t value;
+    clock::time_point submitted;
+  };
+  std::deque<pending> in_flight;
+  /** ring of the last samples */
+  std::vector<double> submit_to_done;
+  std::vector<double> present_call;
+  std::size_t window = 256;
+  std::size_t next_done = 0;
+  std::size_t next_present = 0;
+
+  static void push_sample(std::vector<double> &ring, std::size_t &next,
+                          std::size_t window, double v) {
+    if (ring.size() < window) {
+      ring.push_back(v);
+    } else {
+      ring[next] = v;
+    }
+    next = (next + 1) % window;
+  }
+  static latency_stats summarize(std::vector<double> samples) {
+    latency_stats s;
+    s.samples = samples.size();
+    if (samples.empty()) {
+      return s;
+    }
+    std::sort(samples.begin(), samples.end());
+    double total = 0.0;
+    for (double v : samples) {
+      total += v;
+    }
+    s.average_us = total / samples.size();
+    s.p50_us = samples[samples.size() / 2];
+    s.p99_us = samples[(samples.size() * 99) / 100];
+    s.max_us = samples.back();
+    return s;
+  }
+
+public:
+  latency_tracker() {}
+  explicit latency_tracker(std::size_t sample_window)
+      : window(std::max<std::size_t>(sample_window, 1)) {}
+
+  /** the frame signaling value was just submitted */
+  void submitted(uint64_t value) {
+    in_flight.push_back(pending{value, clock::now()});
+  }
+  /** close every frame whose value is not past completed */
+  void completed(uint64_t completed_value) {
+    auto now = clock::now();
+    while (!in_flight.empty() && in_flight.front().value <= completed_value) {
+      std::chrono::duration<double, std::micro> took =
+          now - in_flight.front().submitted;
+      push_sample(submit_to_done, next_done, window, took.count());
+      in_flight.pop_front();
+    }
+  }
+  /** duration of one vkQueuePresentKHR call */
+  void present_call_us(double us) {
+    push_sample(present_call, next_present, window, us);
+  }
+  /** frames in flight are dropped, e.g. when the settings change */
+  void reset() {
+    in_flight.clear();
+    submit_to_done.clear();
+    present_call.clear();
+    next_done = 0;
+    next_present = 0;
+  }
+  latency_stats submit_to_complete() const {
+    return summarize(submit_to_done);
+  }
+  latency_stats present() const { return summarize(present_call); }
+};
+
+} // namespace vtuto
@@ -0,0 +1,256 @@
+// frame pacing on timeline semaphores
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <external.hpp>
+#include <utils.hpp>
+
+namespace vtuto {
+
+/** queues that signal the shared timeline; compute dispatches are
+ * recorded into the graphics submits and signal the graphics lane */
+enum class timeline_lane : std::size_t { graphics = 0, transfer };
+constexpr std::size_t timeline_lane_count = 2;
+
+/** a timeline semaphore, its value only ever grows */
+class timeline_semaphore {
+public:
+  VkSemaphore semaphore = VK_NULL_HANDLE;
+
+  timeline_semaphore() {}
+  timeline_semaphore(VkDevice device, uint64_t initial_value = 0) {
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = initial_value;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+    CHECK_VK2(
+        vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore),
+        "failed to create timeline semaphore");
+  }
+  /** value the gpu (or host) reached so far */
+  uint64_t value(VkDevice device) const {
+    uint64_t v = 0;
+    CHECK_VK2(vkGetSemaphoreCounterValue(device, semaphore, &v),
+              "failed to read timeline semaphore value");
+    return v;
+  }
+  /** block until the semaphore reaches v, false on timeout */
+  bool wait(VkDevice device, uint64_t v,
+            uint64_t timeout = UINT64_MAX) const {
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &semaphore;
+    waitInfo.pValues = &v;
+    VkResult res = vkWaitSemaphores(device, &waitInfo, timeout);
+    if (res == VK_TIMEOUT) {
+      return false;
+    }
+    CHECK_VK2(res, "failed to wait on timeline semaphore");
+    return true;
+  }
+  void destroy(VkDevice device) {
+    vkDestroySemaphore(device, semaphore, nullptr);
+    semaphore = VK_NULL_HANDLE;
+  }
+};
+
+/** counters of a frame scheduler */
+struct frame_scheduler_stats {
+  uint64_t frames = 0;
+  /** waits that found their value already reached */
+  uint64_t ready_waits = 0;
+  /** waits that blocked the cpu */
+  uint64_t blocking_waits = 0;
+  /** time the cpu spent blocked in them */
+  double blocked_us = 0.0;
+};
+
+/**
+  Frame pacing on one monotonically increasing counter.
+
+  Every submit on the graphics or transfer queue, frames and one time
+  uploads alike, takes the next value of a single counter and signals it
+  on the semaphore of its queue. A timeline semaphore must only be
+  signaled with growing values and the queues run independently, so each lane has its own semaphore; since all
+  of them draw from the same counter a value still names one point in the
+  submission order, and waiting for it waits on the last value each lane
+  was given up to that point.
+
+  It replaces the per frame fences: a frame slot remembers the value its
+  last submit signaled and a swapchain image the value of the frame that
+  last rendered to it, the cpu then blocks on those values instead of
+  waiting for and resetting fences, and so do uploads waiting on their
+  transient_command_pool tickets. The number of frames in flight is a
+  runtime setting.
+ */
+class frame_scheduler {
+  std::array<timeline_semaphore, timeline_lane_count> lanes;
+  /** values handed to each lane and not yet known complete, ascending */
+  std::array<std::deque<uint64_t>, timeline_lane_count> issued;
+  uint64_t counter = 0;
+  std::vector<uint64_t> slot_values;
+  std::vector<uint64_t> image_values;
+  std::size_t slot = 0;
+  frame_scheduler_stats fstats;
+
+public:
+  frame_scheduler() {}
+  frame_scheduler(VkDevice device, std::size_t frames_in_flight,
+                  std::size_t image_count) {
+    for (auto &lane : lanes) {
+      lane = timeline_semaphore(device);
+    }
+    set_frames_in_flight(frames_in_flight);
+    set_image_count(image_count);
+  }
+
+  /** the caller must have waited for every slot, see wait_idle */
+  void set_frames_in_flight(std::size_t count) {
+    if (count == 0) {
+      throw std::runtime_error("at least one frame must be in flight");
+    }
+    slot_values.assign(count, 0);
+    slot = 0;
+  }
+  /** new swapchain images are not used by any frame */
+  void set_image_count(std::size_t count) { image_values.assign(count, 0); }
+
+  std::size_t frames_in_flight() const { return slot_values.size(); }
+  std::size_t current_slot() const { return slot; }
+  /** value the graphics queue reached so far */
+  uint64_t completed_value(VkDevice device) const {
+    return lanes[static_cast<std::size_t>(timeline_lane::graphics)].value(
+        device);
+  }
+  /** last value handed out on any lane */
+  uint64_t last_value() const { return counter; }
+  VkSemaphore semaphore(timeline_lane lane) const {
+    return lanes[static_cast<std::size_t>(lane)].semaphore;
+  }
+  /** value lane reached so far */
+  uint64_t lane_value(VkDevice device, timeline_lane lane) const {
+    return lanes[static_cast<std::size_t>(lane)].value(device);
+  }
+  /** non blocking, true once lane signaled value */
+  bool reached(VkDevice device, timeline_lane lane, uint64_t value) const {
+    return lane_value(device, lane) >= value;
+  }
+
+  /** take the next counter value for a submit on lane */
+  uint64_t next_value(timeline_lane lane) {
+    counter++;
+    issued[static_cast<std::size_t>(lane)].push_back(counter);
+    return counter;
+  }
+
+  /** block until every submit up to value completed on all lanes */
+  void wait(VkDevice device, uint64_t value) {
+    for (std::size_t i = 0; i < timeline_lane_count; i++) {
+      auto &values = issued[i];
+      // the lane's last value not past the one asked for
+      uint64_t target = 0;
+      while (!values.empty() && values.front() <= value) {
+        target = values.front();
+        values.pop_front();
+      }
+      if (target == 0) {
+        continue;
+      }
+      if (lanes[i].value(device) >= target) {
+        fstats.ready_waits++;
+        continue;
+      }
+      fstats.blocking_waits++;
+      auto start = std::chrono::steady_clock::now();
+      lanes[i].wait(device, target);
+      std::chrono::duration<double, std::micro> took =
+          std::chrono::steady_clock::now() - start;
+      fstats.blocked_us += took.count();
+    }
+  }
+  /** wait for everything submitted so far */
+  void wait_idle(VkDevice device) { wait(device, counter); }
+
+  /** wait until the current slot's previous frame completed, returns the
+   * value that is now known complete */
+  uint64_t begin_frame(VkDevice device) {
+    uint64_t v = slot_values[slot];
+    wait(device, v);
+    return v;
+  }
+  /** wait until no frame still renders to the image */
+  void wait_image(VkDevice device, uint32_t image_index) {
+    wait(device, image_values[image_index]);
+  }
+  /** value the graphics submit of the current frame signals */
+  uint64_t frame_value(uint32_t image_index) {
+    uint64_t v = next_value(timeline_lane::graphics);
+    slot_values[slot] = v;
+    image_values[image_index] = v;
+    return v;
+  }
+  void end_frame() {
+    slot = (slot + 1) % slot_values.size();
+    fstats.frames++;
+  }
+  const frame_scheduler_stats &stats() const { return fstats; }
+
+  void destroy(VkDevice device) {
+    for (auto &lane : lanes) {
+      lane.destroy(device);
+    }
+  }
+};
+
+/**
+  Submit info chain for a mix of binary and timeline semaphores.
+
+  Binary semaphores (swapchain acquire and present) ignore their value, it
+  is only there because the value arrays must match the semaphore counts.
+ */
+struct timeline_submit {
+  std::vector<VkSemaphore> wait_semaphores;
+  std::vector<VkPipelineStageFlags> wait_stages;
+  std::vector<uint64_t> wait_values;
+  std::vector<VkSemaphore> signal_semaphores;
+  std::vector<uint64_t> signal_values;
+  VkTimelineSemaphoreSubmitInfo timeline_info{};
+
+  void wait(VkSemaphore s, VkPipelineStageFlags stage, uint64_t value = 0) {
+    wait_semaphores.push_back(s);
+    wait_stages.push_back(stage);
+    wait_values.push_back(value);
+  }
+  void signal(VkSemaphore s, uint64_t value = 0) {
+    signal_semaphores.push_back(s);
+    signal_values.push_back(value);
+  }
+  /** fill the semaphore part of info, pointers stay valid while this
+   * object lives and is not modified */
+  void fill(VkSubmitInfo &info) {
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.waitSemaphoreValueCount =
+        static_cast<uint32_t>(wait_values.size());
+    timeline_info.pWaitSemaphoreValues = wait_values.data();
+    timeline_info.signalSemaphoreValueCount =
+        static_cast<uint32_t>(signal_values.size());
+    timeline_info.pSignalSemaphoreValues = signal_values.data();
+
+    info.pNext = &timeline_info;
+    info.waitSemaphoreCount = static_cast<uint32_t>(wait_semaphores.size());
+    info.pWaitSemaphores = wait_semaphores.data();
+    info.pWaitDstStageMask = wait_stages.data();
+    info.signalSemaphoreCount =
+        static_cast<uint32_t>(signal_semaphores.size());
+    info.pSignalSemaphores = signal_semaphores.data();
+  }
+};
+
+} // namespace vtuto
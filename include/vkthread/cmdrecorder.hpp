@@ -0,0 +1,170 @@
+// parallel recording of secondary command buffers
+#pragma once
+#include <chrono>
+#include <external.hpp>
+#include <ldevice.hpp>
+#include <utils.hpp>
+#include <vkthread/threadpool.hpp>
+
+namespace vtuto {
+
+/**
+  One command pool per worker thread.
+
+  A command pool is externally synchronized, so worker i only ever
+  allocates from and records into buffers of pools[i].
+ */
+class thread_command_pools {
+  std::vector<VkCommandPool> pools;
+
+public:
+  thread_command_pools() {}
+  thread_command_pools(VkDevice device, uint32_t queue_family,
+                       std::size_t count) {
+    pools.resize(count, VK_NULL_HANDLE);
+    for (auto &pool : pools) {
+      VkCommandPoolCreateInfo poolInfo{};
+      poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+      poolInfo.queueFamilyIndex = queue_family;
+      CHECK_VK2(vkCreateCommandPool(device, &poolInfo, nullptr, &pool),
+                "failed to create per thread command pool");
+    }
+  }
+  thread_command_pools(vulkan_device<VkDevice> &logical_dev,
+                       uint32_t queue_family, std::size_t count)
+      : thread_command_pools(logical_dev.device(), queue_family, count) {}
+  VkCommandPool get(std::size_t worker) const { return pools[worker]; }
+  std::size_t size() const { return pools.size(); }
+  void destroy(VkDevice device) {
+    for (auto pool : pools) {
+      vkDestroyCommandPool(device, pool, nullptr);
+    }
+    pools.clear();
+  }
+  void destroy(vulkan_device<VkDevice> &logical_dev) {
+    destroy(logical_dev.device());
+  }
+};
+
+/** a secondary buffer and the pool it must be freed to */
+struct recorded_secondary {
+  VkCommandPool pool = VK_NULL_HANDLE;
+  VkCommandBuffer buffer = VK_NULL_HANDLE;
+};
+
+/** time spent recording, split between workers and the calling thread */
+struct record_stats {
+  std::size_t threads = 0;
+  std::size_t jobs = 0;
+  /** wall time of the whole parallel recording */
+  double wall_us = 0.0;
+  /** sum of the time each job spent recording */
+  double job_us = 0.0;
+};
+
+/** records a part of a render pass into a secondary buffer */
+typedef std::function<void(VkCommandBuffer)> record_job;
+
+/**
+  Record every job into its own secondary command buffer in parallel.
+
+  The buffers continue the render pass described by inheritance. They are
+  returned in job order so the primary executes them deterministically.
+  Any failure in a job is rethrown here after every job finished.
+ */
+inline std::vector<recorded_secondary>
+record_secondaries(thread_pool &workers, const thread_command_pools &pools,
+                   VkDevice device,
+                   const VkCommandBufferInheritanceInfo &inheritance,
+                   const std::vector<record_job> &jobs,
+                   record_stats *stats = nullptr) {
+  if (workers.size() == 0 || pools.size() < workers.size()) {
+    throw std::runtime_error("need a started pool and a command pool each");
+  }
+  auto start = std::chrono::steady_clock::now();
+  std::vector<recorded_secondary> recorded(jobs.size());
+  std::vector<double> job_times(jobs.size(), 0.0);
+  std::vector<std::future<void>> done;
+  done.reserve(jobs.size());
+  for (std::size_t i = 0; i < jobs.size(); i++) {
+    done.push_back(workers.submit([&, i](std::size_t worker) {
+      auto job_start = std::chrono::steady_clock::now();
+      recorded_secondary &rec = recorded[i];
+      rec.pool = pools.get(worker);
+
+      VkCommandBufferAllocateInfo allocInfo{};
+      allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      allocInfo.commandPool = rec.pool;
+      allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+      allocInfo.commandBufferCount = 1;
+      CHECK_VK2(vkAllocateCommandBuffers(device, &allocInfo, &rec.buffer),
+                "failed to allocate secondary command buffer");
+
+      VkCommandBufferBeginInfo beginInfo{};
+      beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+      beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+      beginInfo.pInheritanceInfo = &inheritance;
+      CHECK_VK2(vkBeginCommandBuffer(rec.buffer, &beginInfo),
+                "failed to begin secondary command buffer");
+      jobs[i](rec.buffer);
+      CHECK_VK2(vkEndCommandBuffer(rec.buffer),
+                "failed to end secondary command buffer");
+
+      std::chrono::duration<double, std::micro> took =
+          std::chrono::steady_clock::now() - job_start;
+      job_times[i] = took.count();
+    }));
+  }
+  // wait for all of them before rethrowing, jobs reference locals
+  std::exception_ptr failure;
+  for (auto &f : done) {
+    try {
+      f.get();
+    } catch (...) {
+      if (!failure) {
+        failure = std::current_exception();
+      }
+    }
+  }
+  if (failure) {
+    for (auto &rec : recorded) {
+      if (rec.buffer != VK_NULL_HANDLE) {
+        vkFreeCommandBuffers(device, rec.pool, 1, &rec.buffer);
+      }
+    }
+    std::rethrow_exception(failure);
+  }
+  if (stats != nullptr) {
+    std::chrono::duration<double, std::micro> wall =
+        std::chrono::steady_clock::now() - start;
+    stats->threads = workers.size();
+    stats->jobs = jobs.size();
+    stats->wall_us = wall.count();
+    stats->job_us = 0.0;
+    for (double t : job_times) {
+      stats->job_us += t;
+    }
+  }
+  return recorded;
+}
+
+/** stitch secondaries into a primary inside a render pass begun with
+ * VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS */
+inline void execute_secondaries(VkCommandBuffer primary,
+                                const std::vector<recorded_secondary> &recs) {
+  std::vector<VkCommandBuffer> buffers(recs.size());
+  for (std::size_t i = 0; i < recs.size(); i++) {
+    buffers[i] = recs[i].buffer;
+  }
+  vkCmdExecuteCommands(primary, static_cast<uint32_t>(buffers.size()),
+                       buffers.data());
+}
+
+inline void free_secondaries(VkDevice device,
+                             const std::vector<recorded_secondary> &recs) {
+  for (const auto &rec : recs) {
+    vkFreeCommandBuffers(device, rec.pool, 1, &rec.buffer);
+  }
+}
+
+} // namespace vtuto
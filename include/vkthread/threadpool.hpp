@@ -0,0 +1,91 @@
+// fixed size worker pool whose jobs know the index of their worker
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vtuto {
+
+/**
+  Fixed set of worker threads fed from a single job queue.
+
+  Every job receives the index of the worker running it. Per thread vulkan
+  objects, most notably command pools which must not be used from two
+  threads at once, are kept in arrays indexed by that value so a job never
+  needs a lock to reach them.
+ */
+class thread_pool {
+  std::vector<std::thread> workers;
+  std::deque<std::function<void(std::size_t)>> jobs;
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool stopping = false;
+
+public:
+  thread_pool() {}
+  explicit thread_pool(std::size_t count) { start(count); }
+  thread_pool(const thread_pool &) = delete;
+  thread_pool &operator=(const thread_pool &) = delete;
+  ~thread_pool() { stop(); }
+
+  void start(std::size_t count) {
+    stop();
+    stopping = false;
+    for (std::size_t i = 0; i < count; i++) {
+      workers.emplace_back([this, i]() { run(i); });
+    }
+  }
+  /** finish queued jobs and join every worker */
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      stopping = true;
+    }
+    cv.notify_all();
+    for (auto &w : workers) {
+      w.join();
+    }
+    workers.clear();
+  }
+  std::size_t size() const { return workers.size(); }
+
+  /** queue fn(worker_index), exceptions surface through the future */
+  template <class Fn>
+  auto submit(Fn fn) -> std::future<decltype(fn(std::size_t()))> {
+    using R = decltype(fn(std::size_t()));
+    auto task = std::make_shared<std::packaged_task<R(std::size_t)>>(
+        std::move(fn));
+    std::future<R> result = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      jobs.emplace_back([task](std::size_t worker) { (*task)(worker); });
+    }
+    cv.notify_one();
+    return result;
+  }
+
+private:
+  void run(std::size_t index) {
+    for (;;) {
+      std::function<void(std::size_t)> job;
+      {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this]() { return stopping || !jobs.empty(); });
+        if (jobs.empty()) {
+          return;
+        }
+        job = std::move(jobs.front());
+        jobs.pop_front();
+      }
+      job(index);
+    }
+  }
+};
+
+} // namespace vtuto
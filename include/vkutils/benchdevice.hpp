@@ -0,0 +1,159 @@
+// headless device for the benchmarks, run from bin/
+#pragma once
+#include <external.hpp>
+#include <utils.hpp>
+#include <vkpipeline/pipelinestate.hpp>
+#include <vkshader/registry.hpp>
+
+namespace vtuto {
+
+/** instance, device and the objects every benchmark pipeline shares */
+struct bench_device {
+  VkInstance instance = VK_NULL_HANDLE;
+  VkPhysicalDevice pdev = VK_NULL_HANDLE;
+  VkDevice device = VK_NULL_HANDLE;
+  VkRenderPass render_pass = VK_NULL_HANDLE;
+  uint64_t render_pass_compat = 0;
+  VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+  VkPipelineLayout layout = VK_NULL_HANDLE;
+  shader_registry shaders;
+  VkShaderModule vertex = VK_NULL_HANDLE;
+  VkShaderModule fragment = VK_NULL_HANDLE;
+  std::string device_name;
+  uint32_t graphics_family = 0;
+
+  void create() {
+    VkApplicationInfo app{};
+    app.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    app.pApplicationName = "vtuto bench";
+    app.apiVersion = VK_API_VERSION_1_1;
+    VkInstanceCreateInfo instanceInfo{};
+    instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instanceInfo.pApplicationInfo = &app;
+    CHECK_VK2(vkCreateInstance(&instanceInfo, nullptr, &instance),
+              "failed to create instance");
+
+    uint32_t count = 0;
+    vkEnumeratePhysicalDevices(instance, &count, nullptr);
+    if (count == 0) {
+      throw std::runtime_error("no vulkan device");
+    }
+    std::vector<VkPhysicalDevice> pdevs(count);
+    vkEnumeratePhysicalDevices(instance, &count, pdevs.data());
+    pdev = pdevs[0];
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(pdev, &props);
+    device_name = props.deviceName;
+
+    uint32_t family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(pdev, &family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(pdev, &family_count,
+                                             families.data());
+    uint32_t graphics = family_count;
+    for (uint32_t i = 0; i < family_count; i++) {
+      if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        graphics = i;
+        break;
+      }
+    }
+    if (graphics == family_count) {
+      throw std::runtime_error("no graphics queue");
+    }
+    graphics_family = graphics;
+    float priority = 1.0f;
+    VkDeviceQueueCreateInfo queueInfo{};
+    queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueInfo.queueFamilyIndex = graphics;
+    queueInfo.queueCount = 1;
+    queueInfo.pQueuePriorities = &priority;
+    VkDeviceCreateInfo deviceInfo{};
+    deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceInfo.queueCreateInfoCount = 1;
+    deviceInfo.pQueueCreateInfos = &queueInfo;
+    CHECK_VK2(vkCreateDevice(pdev, &deviceInfo, nullptr, &device),
+              "failed to create logical device");
+
+    // one color attachment, no depth: depth state stays off below
+    VkAttachmentDescription color{};
+    color.format = VK_FORMAT_B8G8R8A8_UNORM;
+    color.samples = VK_SAMPLE_COUNT_1_BIT;
+    color.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    color.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    color.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    color.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    color.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    VkAttachmentReference colorRef{};
+    colorRef.attachment = 0;
+    colorRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorRef;
+    VkRenderPassCreateInfo passInfo{};
+    passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    passInfo.attachmentCount = 1;
+    passInfo.pAttachments = &color;
+    passInfo.subpassCount = 1;
+    passInfo.pSubpasses = &subpass;
+    CHECK_VK2(vkCreateRenderPass(device, &passInfo, nullptr, &render_pass),
+              "failed to create render pass");
+    render_pass_compat = render_pass_compat_hash(&color, 1);
+
+    // the bindings vulkansimple.vert and .frag declare
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    VkDescriptorSetLayoutCreateInfo setInfo{};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    setInfo.pBindings = bindings.data();
+    CHECK_VK2(
+        vkCreateDescriptorSetLayout(device, &setInfo, nullptr, &set_layout),
+        "failed to create descriptor set layout");
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &set_layout;
+    CHECK_VK2(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &layout),
+              "failed to create pipeline layout");
+
+    CHECK_VK2(shaders.acquire(device,
+                              "./shaders/vulkansimple/vulkansimple.vert.spv",
+                              vertex),
+              "failed to load vertex shader, run from bin/");
+    CHECK_VK2(shaders.acquire(device,
+                              "./shaders/vulkansimple/vulkansimple.frag.spv",
+                              fragment),
+              "failed to load fragment shader, run from bin/");
+  }
+  /** a memory type allowed by bits with every flag set */
+  uint32_t memory_type(uint32_t bits, VkMemoryPropertyFlags flags) const {
+    VkPhysicalDeviceMemoryProperties props{};
+    vkGetPhysicalDeviceMemoryProperties(pdev, &props);
+    for (uint32_t i = 0; i < props.memoryTypeCount; i++) {
+      if ((bits & (1u << i)) &&
+          (props.memoryTypes[i].propertyFlags & flags) == flags) {
+        return i;
+      }
+    }
+    throw std::runtime_error("no suitable memory type");
+  }
+  void destroy() {
+    shaders.destroy(device);
+    vkDestroyPipelineLayout(device, layout, nullptr);
+    vkDestroyDescriptorSetLayout(device, set_layout, nullptr);
+    vkDestroyRenderPass(device, render_pass, nullptr);
+    vkDestroyDevice(device, nullptr);
+    vkDestroyInstance(instance, nullptr);
+  }
+};
+
+} // namespace vtuto
@@ -3,24 +3,124 @@
 
 #include <external.hpp>
 
+#if defined(__unix__) || defined(__APPLE__)
+#define VTUTO_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace vtuto {
 
-std::array<char> readFile(const std::string &filename) {
+/** whole file as bytes, empty when it can not be read */
+inline std::vector<char> readFile(const std::string &filename) {
   std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
   if (!file.is_open()) {
     std::cerr << "failed to open file! " << filename << std::endl;
+    return {};
   }
 
   std::size_t fileSize = static_cast<std::size_t>(file.tellg());
-  std::array<char> buffer(fileSize);
+  std::vector<char> buffer(fileSize);
 
   file.seekg(0);
-  file.read(buffer.data(), fileSize);
+  file.read(buffer.data(), static_cast<std::streamsize>(fileSize));
 
   file.close();
 
   return buffer;
 }
 
+/**
+  Read only view of a whole file.
+
+  The pages are mapped instead of copied where mmap exists, elsewhere the
+  file is read into a buffer the view points at. Mappings are page aligned,
+  so the bytes can be handed to Vulkan as uint32_t words directly.
+ */
+class mapped_file {
+  const char *bytes = nullptr;
+  std::size_t length = 0;
+  bool mapped = false;
+  std::vector<char> copy;
+
+  void release() {
+#ifdef VTUTO_HAS_MMAP
+    if (mapped) {
+      munmap(const_cast<char *>(bytes), length);
+    }
+#endif
+    bytes = nullptr;
+    length = 0;
+    mapped = false;
+    copy.clear();
+  }
+
+public:
+  mapped_file() {}
+  /** check ok(), a missing or empty file gives an empty view */
+  explicit mapped_file(const std::string &path) {
+#ifdef VTUTO_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void *p = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ,
+                     MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED) {
+        bytes = static_cast<const char *>(p);
+        length = static_cast<std::size_t>(st.st_size);
+        mapped = true;
+      }
+    }
+    ::close(fd);
+#else
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+      return;
+    }
+    copy.resize(static_cast<std::size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(copy.data(), static_cast<std::streamsize>(copy.size()));
+    bytes = copy.data();
+    length = copy.size();
+#endif
+  }
+  mapped_file(const mapped_file &) = delete;
+  mapped_file &operator=(const mapped_file &) = delete;
+  mapped_file(mapped_file &&o) noexcept { *this = std::move(o); }
+  mapped_file &operator=(mapped_file &&o) noexcept {
+    if (this != &o) {
+      release();
+      copy = std::move(o.copy);
+      bytes = o.mapped ? o.bytes : copy.data();
+      length = o.length;
+      mapped = o.mapped;
+      o.bytes = nullptr;
+      o.length = 0;
+      o.mapped = false;
+    }
+    return *this;
+  }
+  ~mapped_file() { release(); }
+
+  bool ok() const { return bytes != nullptr && length > 0; }
+  const char *data() const { return bytes; }
+  std::size_t size() const { return length; }
+};
+
+/** true when path names something that can be opened */
+inline bool file_exists(const std::string &path) {
+#ifdef VTUTO_HAS_MMAP
+  struct stat st;
+  return ::stat(path.c_str(), &st) == 0;
+#else
+  return std::ifstream(path).good();
+#endif
+}
+
 }; // namespace vtuto
@@ -0,0 +1,55 @@
+#pragma once
+// instruction sets of the simd kernels and their runtime detection
+
+#if (defined(__x86_64__) || defined(__i386__)) &&                            \
+    (defined(__GNUC__) || defined(__clang__))
+#define VTUTO_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace vtuto {
+
+/**
+  Instruction set a kernel runs with. Kernels are compiled for each of them
+  with target attributes and picked at runtime, so the build needs no
+  -mavx2 and the binary still runs on older cpus.
+ */
+enum class simd_isa { scalar, sse, avx2 };
+
+inline const char *to_string(simd_isa isa) {
+  switch (isa) {
+  case simd_isa::scalar:
+    return "scalar";
+  case simd_isa::sse:
+    return "sse";
+  case simd_isa::avx2:
+    return "avx2";
+  }
+  return "scalar";
+}
+
+/** whether the running cpu has the instructions */
+inline bool simd_supported(simd_isa isa) {
+  switch (isa) {
+  case simd_isa::scalar:
+    return true;
+#ifdef VTUTO_SIMD_X86
+  case simd_isa::sse:
+    return __builtin_cpu_supports("sse2");
+  case simd_isa::avx2:
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
+inline simd_isa best_simd_isa() {
+  static const simd_isa best = simd_supported(simd_isa::avx2)
+                                   ? simd_isa::avx2
+                                   : simd_supported(simd_isa::sse)
+                                         ? simd_isa::sse
+                                         : simd_isa::scalar;
+  return best;
+}
+
+} // namespace vtuto
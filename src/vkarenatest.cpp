@@ -0,0 +1,109 @@
+// steady state frames through the frame arena never call operator new
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <vulkan/vulkan.hpp>
+//
+#include <vkmemory/framearena.hpp>
+
+using namespace vtuto;
+
+/** every global operator new in the process, arenas included */
+static std::atomic<std::size_t> new_calls{0};
+
+void *operator new(std::size_t bytes) {
+  new_calls++;
+  if (void *p = std::malloc(bytes == 0 ? 1 : bytes)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+void *operator new[](std::size_t bytes) { return operator new(bytes); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+
+/**
+  What a frame builds on the cpu side: descriptor writes with their
+  buffer infos, image barriers and the submit info array. The counts
+  change from frame to frame and repeat every 16 frames, so the peak is
+  seen within the warm up.
+ */
+void simulate_frame(frame_arena &arena, uint32_t frame) {
+  const std::size_t sets = 4 + (frame * 7) % 16;
+  auto writes = make_arena_vector<VkWriteDescriptorSet>(arena, sets);
+  VkDescriptorBufferInfo *buffers =
+      arena.alloc_array<VkDescriptorBufferInfo>(sets);
+  for (std::size_t i = 0; i < sets; i++) {
+    buffers[i].range = sizeof(float) * 16;
+    VkWriteDescriptorSet w{};
+    w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    w.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    w.descriptorCount = 1;
+    w.pBufferInfo = buffers + i;
+    writes.push_back(w);
+  }
+  // grown without reserve, leaves its old storage in the arena
+  arena_vector<VkImageMemoryBarrier> barriers{
+      arena_allocator<VkImageMemoryBarrier>(arena)};
+  for (uint32_t i = 0; i < 1 + frame % 4; i++) {
+    VkImageMemoryBarrier b{};
+    b.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    b.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    b.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers.push_back(b);
+  }
+  VkSubmitInfo *submits = arena.alloc_array<VkSubmitInfo>(2);
+  submits[0].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submits[1].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+}
+
+int main(int argc, char **argv) {
+  uint32_t frames = 1000;
+  if (argc > 1) {
+    frames = static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10));
+  }
+  const uint32_t in_flight = 2;
+  const uint32_t warm_up = 32;
+  // a small first block so the warm up has to grow the arenas
+  std::vector<frame_arena> arenas;
+  arenas.reserve(in_flight);
+  for (uint32_t i = 0; i < in_flight; i++) {
+    arenas.emplace_back(256);
+  }
+
+  uint32_t frame = 0;
+  for (; frame < warm_up; frame++) {
+    frame_arena &arena = arenas[frame % in_flight];
+    arena.reset();
+    simulate_frame(arena, frame);
+  }
+  std::size_t warm_blocks = 0;
+  for (const frame_arena &a : arenas) {
+    warm_blocks += a.stats().heap_allocations;
+  }
+
+  const std::size_t before = new_calls.load();
+  for (; frame < warm_up + frames; frame++) {
+    frame_arena &arena = arenas[frame % in_flight];
+    arena.reset();
+    simulate_frame(arena, frame);
+  }
+  const std::size_t steady_news = new_calls.load() - before;
+  std::size_t steady_blocks = 0;
+  for (const frame_arena &a : arenas) {
+    steady_blocks += a.stats().heap_allocations;
+  }
+
+  std::cout << "arenatest.frames " << frames << std::endl;
+  std::cout << "arenatest.warm_up_blocks " << warm_blocks << std::endl;
+  std::cout << "arenatest.steady_operator_new " << steady_news << std::endl;
+  std::cout << "arenatest.steady_blocks " << steady_blocks - warm_blocks
+            << std::endl;
+  if (warm_blocks == 0 || steady_news != 0 || steady_blocks != warm_blocks) {
+    std::cerr << "steady state frames allocated from the heap" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
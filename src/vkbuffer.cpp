@@ -19,7 +19,7 @@ void HelloTriangle::createVertexBuffer() {
 
   // create staging buffer
   createBuffer(device_size, stage_usage_flag, mem_flags, staging_buffer,
-               staging_memory);
+               staging_memory, memory_category::staging);
 
   void *data;
   vkMapMemory(logical_dev.device(), staging_memory, 0, device_size, 0, &data);
@@ -32,12 +32,11 @@ void HelloTriangle::createVertexBuffer() {
   auto vertex_mem_flag = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
   createBuffer(device_size, vertex_usage_flag, vertex_mem_flag, vertex_buffer,
-               vertex_buffer_memory);
+               vertex_buffer_memory, memory_category::geometry);
 
-  copyBuffer(staging_buffer, vertex_buffer, device_size);
-
-  vkDestroyBuffer(logical_dev.device(), staging_buffer, nullptr);
-  vkFreeMemory(logical_dev.device(), staging_memory, nullptr);
+  uploadBuffer(staging_buffer, staging_memory, vertex_buffer, device_size,
+               VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+               VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
 }
 void HelloTriangle::createIndexBuffer() {
   // 1. buffer related info
@@ -52,7 +51,7 @@ void HelloTriangle::createIndexBuffer() {
 
   // create staging buffer
   createBuffer(size, stage_usage_flag, mem_flags, staging_buffer,
-               staging_memory);
+               staging_memory, memory_category::staging);
   void *data;
   vkMapMemory(logical_dev.device(), staging_memory, 0, size, 0, &data);
   memcpy(data, indices.data(), static_cast<size_t>(size));
@@ -64,13 +63,13 @@ void HelloTriangle::createIndexBuffer() {
   auto index_mem_flag = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
   createBuffer(size, index_usage_flag, index_mem_flag, index_buffer,
-               index_buffer_memory);
+               index_buffer_memory, memory_category::geometry);
 
-  copyBuffer(staging_buffer, index_buffer, size);
-  vkDestroyBuffer(logical_dev.device(), staging_buffer, nullptr);
-  vkFreeMemory(logical_dev.device(), staging_memory, nullptr);
+  uploadBuffer(staging_buffer, staging_memory, index_buffer, size,
+               VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
 }
-void HelloTriangle::copyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size) {
+transient_submit HelloTriangle::copyBuffer(VkBuffer src, VkBuffer dst,
+                                           VkDeviceSize size) {
   //
   VkCommandBuffer cbuffer = beginSignalCommand();
 
@@ -80,20 +79,131 @@ void HelloTriangle::copyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size) {
   vkCmdCopyBuffer(cbuffer, src, dst, 1, &copyRegion);
 
   // end signal
-  endSignalCommand(cbuffer);
+  return endSignalCommand(cbuffer);
+}
+void HelloTriangle::uploadBuffer(VkBuffer staging,
+                                 VkDeviceMemory staging_memory, VkBuffer dst,
+                                 VkDeviceSize size, VkAccessFlags dst_access,
+                                 VkPipelineStageFlags dst_stage) {
+  auto free_staging = [this, staging, staging_memory]() {
+    vkDestroyBuffer(logical_dev.device(), staging, nullptr);
+    freeMemory(staging_memory);
+  };
+  if (!use_transfer_queue) {
+    upload_pool.release_after(copyBuffer(staging, dst, size), free_staging);
+    return;
+  }
+  // copy on the transfer queue, runs next to the graphics queue uploads
+  queue_ownership own(logical_dev.families.transfer_family.value(),
+                      logical_dev.families.graphics_family.value());
+  VkCommandBuffer cbuffer = transfer_pool.begin();
+  VkBufferCopy copyRegion{};
+  copyRegion.size = size;
+  vkCmdCopyBuffer(cbuffer, staging, dst, 1, &copyRegion);
+  cmd_release_ownership(
+      cbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      {buffer_release_barrier(own, dst, VK_ACCESS_TRANSFER_WRITE_BIT)});
+  transfer_pool.release_after(transfer_pool.submit(cbuffer), free_staging);
+
+  pending_acquires.push_back(buffer_acquire_barrier(own, dst, dst_access));
+  pending_acquire_stages |= dst_stage;
+}
+void HelloTriangle::finishUploads() {
+  if (!pending_acquires.empty()) {
+    // the acquires wait on the gpu for the transfer lane to reach its last
+    // release, the host does not
+    timeline_submit after_releases;
+    after_releases.wait(frames.semaphore(timeline_lane::transfer),
+                        pending_acquire_stages, transfer_pool.last_value());
+    VkCommandBuffer cbuffer = beginSignalCommand();
+    cmd_acquire_ownership(cbuffer, pending_acquire_stages, pending_acquires);
+    upload_pool.submit(cbuffer, after_releases);
+    pending_acquires.clear();
+    pending_acquire_stages = 0;
+  }
+  // a single value wait, covers the transfer lane's earlier copies too
+  upload_pool.wait_all();
+  if (use_transfer_queue) {
+    // nothing blocks here, their staging buffers are freed
+    transfer_pool.collect();
+  }
 }
 void HelloTriangle::createUniformBuffer() {
   VkDeviceSize b_size = sizeof(UniformBufferObject);
 
   uniform_buffers.resize(swap_chain.simages.size());
   uniform_buffer_memories.resize(swap_chain.simages.size());
+  uniform_mapped.resize(swap_chain.simages.size());
+  // a new extent means a new projection, every image is written again
+  updateCamera();
+  uniform_written.assign(swap_chain.simages.size(),
+                         std::numeric_limits<uint64_t>::max());
   for (std::size_t i = 0; i < swap_chain.simages.size(); i++) {
     //
     auto usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
     auto mem_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
     createBuffer(b_size, usage, mem_flags, uniform_buffers[i],
-                 uniform_buffer_memories[i]);
+                 uniform_buffer_memories[i], memory_category::uniform);
+    void *data;
+    CHECK_VK2(vkMapMemory(logical_dev.device(), uniform_buffer_memories[i], 0,
+                          b_size, 0, &data),
+              "failed to map uniform buffer");
+    uniform_mapped[i] = static_cast<UniformBufferObject *>(data);
+  }
+}
+void HelloTriangle::createInstanceBuffers() {
+  instance_capacity = std::max(instance_capacity, instance_count);
+  VkDeviceSize b_size = sizeof(InstanceData) * instance_capacity;
+
+  std::size_t images = swap_chain.simages.size();
+  instance_buffers.resize(images);
+  instance_buffer_memories.resize(images);
+  instance_mapped.resize(images);
+  // nothing written yet
+  instance_written.assign(images, 0);
+  for (std::size_t i = 0; i < images; i++) {
+    auto usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    auto mem_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    createBuffer(b_size, usage, mem_flags, instance_buffers[i],
+                 instance_buffer_memories[i], memory_category::geometry);
+    void *data;
+    CHECK_VK2(vkMapMemory(logical_dev.device(), instance_buffer_memories[i], 0,
+                          b_size, 0, &data),
+              "failed to map instance buffer");
+    instance_mapped[i] = static_cast<InstanceData *>(data);
+  }
+}
+void HelloTriangle::retireInstanceBuffers() {
+  VkDevice device = logical_dev.device();
+  for (std::size_t i = 0; i < instance_buffers.size(); i++) {
+    deletions.destroy(device, instance_buffers[i], vkDestroyBuffer);
+    // freeing mapped memory unmaps it
+    VkDeviceMemory memory = instance_buffer_memories[i];
+    deletions.push([this, memory]() { freeMemory(memory); });
+  }
+  instance_buffers.clear();
+  instance_buffer_memories.clear();
+  instance_mapped.clear();
+  instance_written.clear();
+}
+void HelloTriangle::writeInstances(uint32_t image_index) {
+  // the image's last frame completed, its buffer is free to overwrite;
+  // only instance nodes moved since its last write are copied
+  uint64_t &written = instance_written[image_index];
+  if (written != scene_graph.version()) {
+    scene_graph.write_changed(instance_mapped[image_index], written,
+                              instance_root + 1, instance_count);
+    written = scene_graph.version();
+  }
+  if (culling == cull_mode::gpu) {
+    cull_buffers &t = cull_targets[image_index];
+    if (t.bounds_version != instance_version) {
+      instances.write_bounds(t.bounds_mapped, glm::vec3(model_bounds),
+                             model_bounds.w);
+      t.bounds_version = instance_version;
+    }
   }
 }
 /**
@@ -102,7 +212,8 @@ void HelloTriangle::createUniformBuffer() {
 void HelloTriangle::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
                                  VkMemoryPropertyFlags mem_flags,
                                  VkBuffer &buffer,
-                                 VkDeviceMemory &buffer_memory) {
+                                 VkDeviceMemory &buffer_memory,
+                                 memory_category category) {
   // 1. create buffer info
   VkBufferCreateInfo bufferInfo{};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -125,12 +236,30 @@ void HelloTriangle::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
   CHECK_VK2(vkAllocateMemory(logical_dev.device(), &allocInfo, nullptr,
                              &buffer_memory),
             "failed to allocate memory from logical device");
+  memory_stats.track(buffer_memory, allocInfo.allocationSize,
+                     allocInfo.memoryTypeIndex, category);
 
   // 4. map host to device memory
   vkBindBufferMemory(logical_dev.device(), buffer, buffer_memory, 0);
 }
+void HelloTriangle::freeMemory(VkDeviceMemory memory) {
+  memory_stats.release(memory);
+  vkFreeMemory(logical_dev.device(), memory, nullptr);
+}
+void HelloTriangle::untrackSwapchainMemory() {
+  for (auto memory : uniform_buffer_memories) {
+    memory_stats.release(memory);
+  }
+  memory_stats.release(depth_image_memory);
+}
+void HelloTriangle::reportMemoryUsage() { memory_stats.report(std::cout); }
 
 void HelloTriangle::createCommandBuffers() {
+  if (recording_mode == command_recording::per_frame) {
+    // recorded by draw() from the frame pools
+    cmd_buffers.resize(0);
+    return;
+  }
   cmd_buffers.resize(swapchain_framebuffers.size());
 
   VkCommandBufferAllocateInfo comAllocInfo{};
@@ -143,13 +272,243 @@ void HelloTriangle::createCommandBuffers() {
                                      cmd_buffers.data()),
             "failed allocate for registering command buffers");
 
-  //
+  // a culled frame is one indirect draw, nothing to split across threads
+  if (record_workers.size() > 1 && culling == cull_mode::none) {
+    recordCommandBuffersParallel();
+    return;
+  }
+  auto start = std::chrono::steady_clock::now();
+  uint32_t copies = instancing ? instance_count : 1;
+  // prebaked buffers keep the values pushed at record time
+  DrawPushConstants constants = drawConstants(scene_draws.draws().front());
+  const DrawPushConstants *push =
+      use_push_constants ? &constants : nullptr;
   for (std::size_t i = 0; i < cmd_buffers.size(); i++) {
     //
+    VkBuffer ibuffer = instancing ? instance_buffers[i] : VK_NULL_HANDLE;
+    if (culling != cull_mode::none) {
+      vulkan_buffer<VkCommandBuffer> buffer;
+      buffer.buffer = cmd_buffers.get(i);
+      uint32_t image = static_cast<uint32_t>(i);
+      buffer.mk_indirect_cmd_buffer(
+          swapchain_framebuffers[i], render_pass, swap_chain.sextent,
+          graphics_pipeline, vertex_buffer, ibuffer, index_buffer,
+          descriptor_sets[i], pipeline_layout, cullDraws(image),
+          [this, image](VkCommandBuffer cb) { cmdCull(cb, image); },
+          &frame_timer, image, push, textureTableSet());
+      continue;
+    }
     auto buffer = vulkan_buffer<VkCommandBuffer>(
         cmd_buffers.get(i), swapchain_framebuffers[i], render_pass,
         swap_chain.sextent, graphics_pipeline, vertex_buffer, index_buffer,
-        indices, descriptor_sets[i], pipeline_layout);
+        indices, descriptor_sets[i], pipeline_layout, 0, 0,
+        {{0.0f, 0.0f, 0.0f, 1.0f}}, 1, VK_SUBPASS_CONTENTS_INLINE,
+        VK_PIPELINE_BIND_POINT_GRAPHICS, 3, copies, 0, 0, ibuffer,
+        &frame_timer, static_cast<uint32_t>(i), push, textureTableSet());
+  }
+  std::chrono::duration<double, std::micro> took =
+      std::chrono::steady_clock::now() - start;
+  last_record_stats = record_stats{};
+  last_record_stats.threads = 1;
+  last_record_stats.jobs = cmd_buffers.size();
+  last_record_stats.wall_us = took.count();
+  last_record_stats.job_us = took.count();
+}
+/**
+  Split the indexed draw into one range per worker, record each range into a
+  secondary buffer on its own thread and execute them from the primary.
+ */
+void HelloTriangle::recordCommandBuffersParallel() {
+  auto start = std::chrono::steady_clock::now();
+  std::size_t workers = record_workers.size();
+  // keep whole triangles in every range
+  uint32_t triangle_count = static_cast<uint32_t>(indices.size() / 3);
+  uint32_t per_job = static_cast<uint32_t>(
+      (triangle_count + workers - 1) / workers);
+
+  last_record_stats = record_stats{};
+  last_record_stats.threads = workers;
+  secondary_buffers.resize(cmd_buffers.size());
+  DrawPushConstants constants = drawConstants(scene_draws.draws().front());
+  for (std::size_t i = 0; i < cmd_buffers.size(); i++) {
+    VkCommandBufferInheritanceInfo inheritance{};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance.renderPass = render_pass;
+    inheritance.subpass = 0;
+    inheritance.framebuffer = swapchain_framebuffers[i].buffer;
+
+    std::vector<record_job> jobs;
+    for (uint32_t first = 0; first < triangle_count; first += per_job) {
+      uint32_t count = std::min(per_job, triangle_count - first);
+      VkDescriptorSet dset = descriptor_sets[i];
+      VkDescriptorSet tset = textureTableSet();
+      VkBuffer ibuffer = instance_buffers[i];
+      jobs.push_back([this, dset, tset, ibuffer, first, count,
+                      constants](VkCommandBuffer cb) {
+        if (graphics_pipeline == VK_NULL_HANDLE) {
+          return;
+        }
+        vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          graphics_pipeline);
+        // dynamic state is not inherited from the primary
+        cmd_set_viewport_scissor(cb, swap_chain.sextent);
+        VkDeviceSize offsets[] = {0};
+        vkCmdBindVertexBuffers(cb, 0, 1, &vertex_buffer, offsets);
+        uint32_t copies = 1;
+        if (instancing) {
+          vkCmdBindVertexBuffers(cb, 1, 1, &ibuffer, offsets);
+          copies = instance_count;
+        }
+        vkCmdBindIndexBuffer(cb, index_buffer, 0, VK_INDEX_TYPE_UINT32);
+        cmd_bind_draw_sets(cb, pipeline_layout, dset, tset);
+        if (use_push_constants) {
+          cmd_push_draw_constants(cb, pipeline_layout, constants);
+        }
+        vkCmdDrawIndexed(cb, count * 3, copies, first * 3, 0, 0);
+      });
+    }
+    record_stats image_stats;
+    secondary_buffers[i] =
+        record_secondaries(record_workers, record_pools, logical_dev.device(),
+                           inheritance, jobs, &image_stats);
+    last_record_stats.jobs += image_stats.jobs;
+    last_record_stats.job_us += image_stats.job_us;
+
+    // primary only opens the pass and runs the secondaries
+    VkCommandBuffer primary = cmd_buffers.get(i);
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    CHECK_VK2(vkBeginCommandBuffer(primary, &beginInfo),
+              "failed to begin recording commands");
+    frame_timer.cmd_begin(primary, static_cast<uint32_t>(i));
+
+    std::array<VkClearValue, 2> cvalues{};
+    cvalues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    cvalues[1].depthStencil = {1.0f, 0};
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = render_pass;
+    renderPassInfo.framebuffer = swapchain_framebuffers[i].buffer;
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = swap_chain.sextent;
+    renderPassInfo.clearValueCount = static_cast<uint32_t>(cvalues.size());
+    renderPassInfo.pClearValues = cvalues.data();
+
+    vkCmdBeginRenderPass(primary, &renderPassInfo,
+                         VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    execute_secondaries(primary, secondary_buffers[i]);
+    vkCmdEndRenderPass(primary);
+    frame_timer.cmd_end(primary, static_cast<uint32_t>(i));
+    CHECK_VK2(vkEndCommandBuffer(primary),
+              "failed to register command buffer");
+  }
+  std::chrono::duration<double, std::micro> took =
+      std::chrono::steady_clock::now() - start;
+  last_record_stats.wall_us = took.count();
+}
+VkCommandBuffer HelloTriangle::recordFrameCommands(uint32_t image_index) {
+  auto start = std::chrono::steady_clock::now();
+  VkCommandBuffer cb = frame_pools[current_frame].begin(logical_dev);
+  frame_timer.cmd_begin(cb, image_index);
+  cmdCull(cb, image_index);
+
+  std::array<VkClearValue, 2> cvalues{};
+  cvalues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+  cvalues[1].depthStencil = {1.0f, 0};
+  VkRenderPassBeginInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderPassInfo.renderPass = render_pass;
+  renderPassInfo.framebuffer = swapchain_framebuffers[image_index].buffer;
+  renderPassInfo.renderArea.offset = {0, 0};
+  renderPassInfo.renderArea.extent = swap_chain.sextent;
+  renderPassInfo.clearValueCount = static_cast<uint32_t>(cvalues.size());
+  renderPassInfo.pClearValues = cvalues.data();
+  vkCmdBeginRenderPass(cb, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+  // without a pipeline yet the pass only clears
+  if (graphics_pipeline != VK_NULL_HANDLE) {
+    vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline);
+    cmd_set_viewport_scissor(cb, swap_chain.sextent);
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(cb, 0, 1, &vertex_buffer, offsets);
+    if (instancing) {
+      vkCmdBindVertexBuffers(cb, 1, 1, &instance_buffers[image_index],
+                             offsets);
+    }
+    vkCmdBindIndexBuffer(cb, index_buffer, 0, VK_INDEX_TYPE_UINT32);
+    // materials switch textures by index, the table is bound once
+    cmd_bind_draw_sets(cb, pipeline_layout, descriptor_sets[image_index],
+                       textureTableSet());
+    if (culling != cull_mode::none) {
+      // one command per visible instance replaces the instanced draws
+      if (use_push_constants) {
+        cmd_push_draw_constants(cb, pipeline_layout,
+                                drawConstants(scene_draws.draws().front()));
+      }
+      cmd_draw_indexed_indirect(cb, cullDraws(image_index));
+    } else {
+      for (const draw_item &d : scene_draws.draws()) {
+        // per draw data costs no descriptor or buffer write
+        if (use_push_constants) {
+          cmd_push_draw_constants(cb, pipeline_layout, drawConstants(d));
+        }
+        // without the instanced pipeline every copy would land on the same
+        // spot
+        uint32_t copies = instancing ? d.instance_count : 1;
+        vkCmdDrawIndexed(cb, d.index_count, copies, d.first_index,
+                         d.vertex_offset, d.first_instance);
+      }
+    }
+  }
+  vkCmdEndRenderPass(cb);
+  frame_timer.cmd_end(cb, image_index);
+  CHECK_VK2(vkEndCommandBuffer(cb), "failed to record frame command buffer");
+
+  std::chrono::duration<double, std::micro> took =
+      std::chrono::steady_clock::now() - start;
+  frame_recording.add(took.count(), record_budget_us);
+  return cb;
+}
+void HelloTriangle::setInstanceCount(uint32_t count) {
+  instance_count = std::max<uint32_t>(count, 1);
+  instances.grid(instance_count);
+  placeInstances();
+  instance_version++;
+  draw_list draws(scene_draws.capacity());
+  for (draw_item d : scene_draws.draws()) {
+    d.instance_count = instance_count;
+    draws.push(d);
+  }
+  scene_draws = draws;
+  // frames in flight keep their buffers, they are retired like the
+  // swapchain ones
+  if (instance_count > instance_capacity) {
+    retireInstanceBuffers();
+    retireCullBuffers();
+    createInstanceBuffers();
+    createCullBuffers();
+  }
+  // prebaked buffers hold the old count
+  retireCommandBuffers();
+  createCommandBuffers();
+}
+void HelloTriangle::reportRecordStats() {
+  std::cout << "record.threads " << last_record_stats.threads << std::endl;
+  std::cout << "record.jobs " << last_record_stats.jobs << std::endl;
+  std::cout << "record.wall_us " << last_record_stats.wall_us << std::endl;
+  std::cout << "record.job_us " << last_record_stats.job_us << std::endl;
+  if (recording_mode != command_recording::per_frame) {
+    return;
   }
+  std::cout << "record.frame.count " << frame_recording.frames << std::endl;
+  std::cout << "record.frame.draws " << scene_draws.size() << std::endl;
+  std::cout << "record.frame.dropped_draws " << scene_draws.dropped()
+            << std::endl;
+  std::cout << "record.frame.last_us " << frame_recording.last_us << std::endl;
+  std::cout << "record.frame.avg_us " << frame_recording.average_us()
+            << std::endl;
+  std::cout << "record.frame.max_us " << frame_recording.max_us << std::endl;
+  std::cout << "record.frame.over_budget " << frame_recording.over_budget
+            << std::endl;
 }
 } // namespace vtuto
@@ -0,0 +1,371 @@
+// main file
+#include <hellotriangle.hpp>
+
+using namespace vtuto;
+
+namespace vtuto {
+
+void HelloTriangle::computeModelBounds() {
+  // center of the axis aligned box, radius to the farthest vertex
+  glm::vec3 lo(std::numeric_limits<float>::max());
+  glm::vec3 hi(-std::numeric_limits<float>::max());
+  for (const auto &v : vertices) {
+    lo = glm::min(lo, v.pos);
+    hi = glm::max(hi, v.pos);
+  }
+  glm::vec3 center = vertices.empty() ? glm::vec3(0.0f) : 0.5f * (lo + hi);
+  float radius = 0.0f;
+  for (const auto &v : vertices) {
+    radius = std::max(radius, glm::length(v.pos - center));
+  }
+  // instances transform what the uniform model matrix produced, it only
+  // rotates so the radius holds
+  glm::mat4 model = frameUniforms().model;
+  model_bounds = glm::vec4(glm::vec3(model * glm::vec4(center, 1.0f)), radius);
+}
+void HelloTriangle::createCullPipeline() {
+  VkPhysicalDeviceProperties props{};
+  vkGetPhysicalDeviceProperties(physical_dev.device(), &props);
+  max_indirect_draws = props.limits.maxDrawIndirectCount;
+
+  // one indirect command per instance picks its transform with
+  // firstInstance, without that feature every instance is drawn
+  const std::string cullShaderPath = "./shaders/culling/cull.comp.spv";
+  culling = cull_mode::none;
+  if (culling_enabled && instancing &&
+      logical_dev.enabled_features.drawIndirectFirstInstance) {
+    bool gpu = logical_dev.enabled12.drawIndirectCount &&
+               shaders.available(cullShaderPath);
+    culling = gpu ? cull_mode::gpu : cull_mode::cpu;
+  }
+  std::cout << "cull.mode " << to_string(culling) << std::endl;
+  if (culling != cull_mode::gpu) {
+    return;
+  }
+
+  std::array<VkDescriptorSetLayoutBinding, 4> bindings{};
+  for (uint32_t i = 0; i < bindings.size(); i++) {
+    bindings[i].binding = i;
+    bindings[i].descriptorCount = 1;
+    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  CHECK_VK2(descriptor_layouts.get(logical_dev.device(), bindings.data(),
+                                   bindings.size(), cull_set_layout),
+            "failed to create culling descriptor set layout");
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &cull_set_layout;
+  CHECK_VK2(vkCreatePipelineLayout(logical_dev.device(), &pipelineLayoutInfo,
+                                   nullptr, &cull_pipeline_layout),
+            "failed to create culling pipeline layout");
+
+  // as wide as the device allows, the cache keeps one variant per value
+  cull_constants.workgroup_size =
+      std::min(cull_constants.workgroup_size,
+               std::min(props.limits.maxComputeWorkGroupSize[0],
+                        props.limits.maxComputeWorkGroupInvocations));
+  specialization<cull_shader_constants> spec(cull_constants);
+  spec.constant(0, &cull_shader_constants::workgroup_size)
+      .constant(1, &cull_shader_constants::far_plane);
+  VkSpecializationInfo specInfo = spec.data().info();
+
+  auto cullModule = acquireShader(cullShaderPath);
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = cullModule;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.stage.pSpecializationInfo = &specInfo;
+  pipelineInfo.layout = cull_pipeline_layout;
+  CHECK_VK2(pipelines.create_compute(logical_dev.device(), pipelineInfo,
+                                     &cull_pipeline),
+            "failed to create culling pipeline");
+  // built once, the module is not needed past pipeline creation
+  shaders.release(logical_dev.device(), cullModule);
+}
+void HelloTriangle::createCullBuffers() {
+  if (culling == cull_mode::none) {
+    return;
+  }
+  VkDevice device = logical_dev.device();
+  const std::size_t images = swap_chain.simages.size();
+  const VkDeviceSize objects = instance_capacity;
+  const auto host = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  auto map = [device](VkDeviceMemory memory, VkDeviceSize size) {
+    void *data;
+    CHECK_VK2(vkMapMemory(device, memory, 0, size, 0, &data),
+              "failed to map culling buffer");
+    return data;
+  };
+  bool gpu = culling == cull_mode::gpu;
+  cull_targets.assign(images, cull_buffers{});
+  for (auto &t : cull_targets) {
+    VkDeviceSize commandsSize = sizeof(VkDrawIndexedIndirectCommand) * objects;
+    if (gpu) {
+      // written and read by the gpu only
+      createBuffer(commandsSize,
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                       VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, t.commands,
+                   t.commands_memory, memory_category::geometry);
+      createBuffer(sizeof(cull_params), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                   host, t.params, t.params_memory, memory_category::uniform);
+      t.params_mapped = static_cast<cull_params *>(
+          map(t.params_memory, sizeof(cull_params)));
+      createBuffer(sizeof(glm::vec4) * objects,
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host, t.bounds,
+                   t.bounds_memory, memory_category::geometry);
+      t.bounds_mapped = static_cast<glm::vec4 *>(
+          map(t.bounds_memory, sizeof(glm::vec4) * objects));
+      // host visible so the visible count can be read back
+      createBuffer(sizeof(uint32_t),
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                       VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                       VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                   host, t.count, t.count_memory, memory_category::other);
+      t.count_mapped =
+          static_cast<uint32_t *>(map(t.count_memory, sizeof(uint32_t)));
+    } else {
+      createBuffer(commandsSize, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, host,
+                   t.commands, t.commands_memory, memory_category::geometry);
+      t.commands_mapped = static_cast<VkDrawIndexedIndirectCommand *>(
+          map(t.commands_memory, commandsSize));
+    }
+  }
+  if (!gpu) {
+    return;
+  }
+
+  cull_descriptors.init({{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f},
+                         {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3.0f}},
+                        static_cast<uint32_t>(images));
+  frame_arena &arena = frame_arenas[current_frame];
+  VkDescriptorSetLayout *layouts =
+      arena.alloc_array<VkDescriptorSetLayout>(images);
+  for (std::size_t i = 0; i < images; i++) {
+    layouts[i] = cull_set_layout;
+  }
+  cull_sets.resize(images);
+  CHECK_VK2(cull_descriptors.allocate(device, layouts, images,
+                                      cull_sets.data()),
+            "failed to allocate culling descriptor sets");
+
+  auto *binfos = arena.alloc_array<VkDescriptorBufferInfo>(4 * images);
+  auto writes = make_arena_vector<VkWriteDescriptorSet>(arena, 4 * images);
+  for (std::size_t i = 0; i < images; i++) {
+    const cull_buffers &t = cull_targets[i];
+    VkBuffer buffers[] = {t.params, t.bounds, t.commands, t.count};
+    for (uint32_t b = 0; b < 4; b++) {
+      VkDescriptorBufferInfo &binfo = binfos[4 * i + b];
+      binfo.buffer = buffers[b];
+      binfo.offset = 0;
+      binfo.range = VK_WHOLE_SIZE;
+      VkWriteDescriptorSet w{};
+      w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      w.dstSet = cull_sets[i];
+      w.dstBinding = b;
+      w.descriptorCount = 1;
+      w.descriptorType = b == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+                                : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      w.pBufferInfo = &binfo;
+      writes.push_back(w);
+    }
+  }
+  vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()),
+                         writes.data(), 0, nullptr);
+}
+void HelloTriangle::retireCullBuffers() {
+  VkDevice device = logical_dev.device();
+  for (auto &t : cull_targets) {
+    VkBuffer buffers[] = {t.params, t.bounds, t.commands, t.count};
+    VkDeviceMemory memories[] = {t.params_memory, t.bounds_memory,
+                                 t.commands_memory, t.count_memory};
+    for (int i = 0; i < 4; i++) {
+      if (buffers[i] == VK_NULL_HANDLE) {
+        continue;
+      }
+      deletions.destroy(device, buffers[i], vkDestroyBuffer);
+      VkDeviceMemory memory = memories[i];
+      deletions.push([this, memory]() { freeMemory(memory); });
+    }
+  }
+  cull_targets.clear();
+  // sets go back to their pools once no frame reads them
+  auto pools = cull_descriptors.detach();
+  if (!pools.empty()) {
+    deletions.push(
+        [this, device, pools]() { cull_descriptors.recycle(device, pools); });
+  }
+  cull_sets.clear();
+}
+void HelloTriangle::readCulling(uint32_t image_index) {
+  if (culling != cull_mode::gpu) {
+    return;
+  }
+  // the image's last frame completed, its count and bounds are the ones
+  // the compute pass saw
+  cull_buffers &t = cull_targets[image_index];
+  if (!t.submitted) {
+    return;
+  }
+  culled.last_objects = t.culled_objects;
+  culled.last_visible = *t.count_mapped;
+  if (!verify_culling) {
+    return;
+  }
+  uint32_t *visible =
+      frame_arenas[current_frame].alloc_array<uint32_t>(t.culled_objects);
+  // the same planes the pipeline's farPlane constant left in
+  int planes = cull_constants.far_plane ? 6 : 5;
+  std::size_t expected = cull_spheres(t.culled_with, t.bounds_mapped,
+                                      t.culled_objects, visible, planes);
+  culled.verified++;
+  if (expected != culled.last_visible) {
+    culled.mismatches++;
+  }
+}
+void HelloTriangle::writeCulling(uint32_t image_index) {
+  if (culling == cull_mode::none) {
+    return;
+  }
+  frustum f = extract_frustum(frameUniforms());
+  cull_buffers &t = cull_targets[image_index];
+  t.culled_with = f;
+  t.culled_objects = instance_count;
+  culled.frames++;
+  if (culling == cull_mode::gpu) {
+    cull_params &p = *t.params_mapped;
+    for (int i = 0; i < 6; i++) {
+      p.planes[i] = f.planes[i];
+    }
+    p.object_count = instance_count;
+    p.index_count = static_cast<uint32_t>(indices.size());
+    p.first_index = 0;
+    p.vertex_offset = 0;
+    t.submitted = true;
+    return;
+  }
+  // cpu: compact the visible instances to the front, the tail draws nothing
+  if (instance_spheres_version != instance_version) {
+    instances.write_bounds(instance_spheres, glm::vec3(model_bounds),
+                           model_bounds.w);
+    instance_spheres_version = instance_version;
+  }
+  uint32_t *visible =
+      frame_arenas[current_frame].alloc_array<uint32_t>(instance_count);
+  std::size_t n = cull_parallel(record_workers, f, instance_spheres, visible);
+  for (std::size_t k = 0; k < instance_count; k++) {
+    VkDrawIndexedIndirectCommand &cmd = t.commands_mapped[k];
+    cmd.indexCount = static_cast<uint32_t>(indices.size());
+    cmd.instanceCount = k < n ? 1 : 0;
+    cmd.firstIndex = 0;
+    cmd.vertexOffset = 0;
+    cmd.firstInstance = k < n ? visible[k] : 0;
+  }
+  culled.last_objects = instance_count;
+  culled.last_visible = static_cast<uint32_t>(n);
+}
+void HelloTriangle::cmdCull(VkCommandBuffer cb, uint32_t image_index) {
+  if (culling != cull_mode::gpu) {
+    return;
+  }
+  const cull_buffers &t = cull_targets[image_index];
+  vkCmdFillBuffer(cb, t.count, 0, sizeof(uint32_t), 0);
+  VkBufferMemoryBarrier cleared{};
+  cleared.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  cleared.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  cleared.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  cleared.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  cleared.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  cleared.buffer = t.count;
+  cleared.offset = 0;
+  cleared.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1,
+                       &cleared, 0, nullptr);
+
+  vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline);
+  vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          cull_pipeline_layout, 0, 1, &cull_sets[image_index],
+                          0, nullptr);
+  // the object count comes from the params buffer, dispatch for all of
+  // them so a prebaked buffer survives count changes within capacity
+  const uint32_t group = cull_constants.workgroup_size;
+  vkCmdDispatch(cb, (instance_capacity + group - 1) / group, 1, 1);
+
+  // commands and count feed the draw, the count is also read on the host
+  std::array<VkBufferMemoryBarrier, 2> written{};
+  VkBuffer buffers[] = {t.commands, t.count};
+  for (std::size_t i = 0; i < written.size(); i++) {
+    written[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    written[i].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    written[i].dstAccessMask =
+        VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    written[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    written[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    written[i].buffer = buffers[i];
+    written[i].offset = 0;
+    written[i].size = VK_WHOLE_SIZE;
+  }
+  vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                           VK_PIPELINE_STAGE_HOST_BIT,
+                       0, 0, nullptr,
+                       static_cast<uint32_t>(written.size()), written.data(),
+                       0, nullptr);
+}
+indirect_draw_source HelloTriangle::cullDraws(uint32_t image_index) const {
+  const cull_buffers &t = cull_targets[image_index];
+  indirect_draw_source src;
+  src.commands = t.commands;
+  src.max_draws = std::min(instance_capacity, max_indirect_draws);
+  src.multi_draw = logical_dev.enabled_features.multiDrawIndirect;
+  if (culling == cull_mode::gpu) {
+    src.count = t.count;
+  } else {
+    // every written command is drawn, the culled ones with no instance
+    src.max_draws = std::min(instance_count, src.max_draws);
+  }
+  return src;
+}
+void HelloTriangle::destroyCulling() {
+  VkDevice device = logical_dev.device();
+  for (auto &t : cull_targets) {
+    VkBuffer buffers[] = {t.params, t.bounds, t.commands, t.count};
+    VkDeviceMemory memories[] = {t.params_memory, t.bounds_memory,
+                                 t.commands_memory, t.count_memory};
+    for (int i = 0; i < 4; i++) {
+      if (buffers[i] != VK_NULL_HANDLE) {
+        vkDestroyBuffer(device, buffers[i], nullptr);
+        freeMemory(memories[i]);
+      }
+    }
+  }
+  cull_targets.clear();
+  cull_descriptors.destroy(device);
+  vkDestroyPipeline(device, cull_pipeline, nullptr);
+  vkDestroyPipelineLayout(device, cull_pipeline_layout, nullptr);
+  // cull_set_layout belongs to descriptor_layouts
+}
+void HelloTriangle::reportCullStats() {
+  std::cout << "cull.mode " << to_string(culling) << std::endl;
+  if (culling == cull_mode::none) {
+    return;
+  }
+  std::cout << "cull.frames " << culled.frames << std::endl;
+  std::cout << "cull.objects " << culled.last_objects << std::endl;
+  std::cout << "cull.visible " << culled.last_visible << std::endl;
+  if (verify_culling) {
+    std::cout << "cull.verified " << culled.verified << std::endl;
+    std::cout << "cull.mismatches " << culled.mismatches << std::endl;
+  }
+}
+} // namespace vtuto
@@ -0,0 +1,107 @@
+// cpu frustum culling throughput, no window or device needed
+#include <chrono>
+#include <external.hpp>
+#include <random>
+#include <ubo.hpp>
+#include <vkculling/simdcull.hpp>
+
+using namespace vtuto;
+
+/** the camera of HelloTriangle pulled back so the scene extends past it */
+UniformBufferObject bench_camera() {
+  UniformBufferObject ubo;
+  ubo.model = glm::mat4(1.0f);
+  ubo.view = glm::lookAt(glm::vec3(60.0f), glm::vec3(0.0f),
+                         glm::vec3(0.0f, 0.0f, 1.0f));
+  ubo.proj = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f,
+                              100.0f);
+  ubo.proj[1][1] *= -1;
+  return ubo;
+}
+
+/** best of a few runs of fn, in seconds */
+template <class Fn> double best_seconds(int runs, Fn fn) {
+  double best = 1e30;
+  for (int i = 0; i < runs; i++) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double> took =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, took.count());
+  }
+  return best;
+}
+
+template <class Bounds>
+void bench(const std::string &name, const frustum &f, const Bounds &bounds,
+           thread_pool &pool, int runs) {
+  const std::size_t count = bounds.size();
+  std::vector<uint32_t> reference(count);
+  std::vector<uint32_t> visible(count);
+  std::size_t expected = cull_range(f, bounds, 0, count, reference.data(),
+                                    simd_isa::scalar);
+  std::cout << "cullbench." << name << ".objects " << count << std::endl;
+  std::cout << "cullbench." << name << ".visible " << expected << std::endl;
+
+  auto report = [&](const std::string &label, double seconds,
+                    std::size_t found) {
+    bool same = found == expected &&
+                std::equal(visible.begin(), visible.begin() + found,
+                           reference.begin());
+    std::string prefix = "cullbench." + name + "." + label;
+    std::cout << prefix << ".objects_per_s " << count / seconds << std::endl;
+    std::cout << prefix << ".mismatch " << (same ? 0 : 1) << std::endl;
+  };
+  for (simd_isa isa : {simd_isa::scalar, simd_isa::sse, simd_isa::avx2}) {
+    if (!simd_supported(isa)) {
+      std::cout << "cullbench." << name << "." << to_string(isa)
+                << ".skipped 1" << std::endl;
+      continue;
+    }
+    std::size_t found = 0;
+    double s = best_seconds(runs, [&]() {
+      found = cull_range(f, bounds, 0, count, visible.data(), isa);
+    });
+    report(to_string(isa), s, found);
+  }
+  std::size_t found = 0;
+  double s = best_seconds(runs, [&]() {
+    found = cull_parallel(pool, f, bounds, visible.data());
+  });
+  report(std::string("threads") + std::to_string(pool.size()) + "." +
+             to_string(best_simd_isa()),
+         s, found);
+}
+
+int main(int argc, char **argv) {
+  std::size_t count = 1 << 20;
+  int runs = 20;
+  if (argc > 1) {
+    count = std::strtoul(argv[1], nullptr, 10);
+  }
+  if (argc > 2) {
+    runs = std::atoi(argv[2]);
+  }
+  // objects scattered well beyond the view so a good share is culled
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> coord(-100.0f, 100.0f);
+  std::uniform_real_distribution<float> size(0.25f, 2.0f);
+  sphere_soa spheres;
+  aabb_soa boxes;
+  spheres.resize(count);
+  boxes.resize(count);
+  for (std::size_t i = 0; i < count; i++) {
+    glm::vec3 c(coord(rng), coord(rng), coord(rng));
+    float r = size(rng);
+    spheres.set(i, glm::vec4(c, r));
+    boxes.set(i, c - glm::vec3(r), c + glm::vec3(r));
+  }
+  frustum f = extract_frustum(bench_camera());
+
+  std::size_t cores = std::max<std::size_t>(
+      std::thread::hardware_concurrency(), 1);
+  thread_pool pool(cores);
+  bench("sphere", f, spheres, pool, runs);
+  bench("aabb", f, boxes, pool, runs);
+  return EXIT_SUCCESS;
+}
@@ -5,77 +5,71 @@ using namespace vtuto;
 
 namespace vtuto {
 void HelloTriangle::createDescriptorPool() {
-  //
-  std::array<VkDescriptorPoolSize, 2> poolSizes{};
-  poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  poolSizes[0].descriptorCount =
-      static_cast<uint32_t>(swap_chain.simages.size());
-  poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  poolSizes[1].descriptorCount =
-      static_cast<uint32_t>(swap_chain.simages.size());
-
-  // create descriptor pool
-  VkDescriptorPoolCreateInfo pinfo{};
-  pinfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  pinfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-  pinfo.pPoolSizes = poolSizes.data();
-  pinfo.maxSets = static_cast<uint32_t>(swap_chain.simages.size());
-
-  CHECK_VK2(vkCreateDescriptorPool(logical_dev.device(), &pinfo, nullptr,
-                                   &descriptor_pool),
-            "failed to create descriptor pool");
+  // what the object sets need per set, pools double when sets of other
+  // layouts or more objects come along
+  const std::vector<descriptor_pool_ratio> ratios = {
+      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f},
+      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.0f}};
+  descriptors.init(ratios, static_cast<uint32_t>(swap_chain.simages.size()));
 }
 void HelloTriangle::createDescriptorSets() {
-  std::vector<VkDescriptorSetLayout> layouts(swap_chain.simages.size(),
-                                             descriptor_set_layout);
+  frame_arena &arena = frame_arenas[current_frame];
+  const std::size_t set_count = swap_chain.simages.size();
+  VkDescriptorSetLayout *layouts =
+      arena.alloc_array<VkDescriptorSetLayout>(set_count);
+  for (std::size_t i = 0; i < set_count; i++) {
+    layouts[i] = descriptor_set_layout;
+  }
   //
-  VkDescriptorSetAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  allocInfo.descriptorPool = descriptor_pool;
-  allocInfo.descriptorSetCount =
-      static_cast<uint32_t>(swap_chain.simages.size());
-  allocInfo.pSetLayouts = layouts.data();
-
-  descriptor_sets.resize(swap_chain.simages.size());
-  CHECK_VK2(vkAllocateDescriptorSets(logical_dev.device(), &allocInfo,
-                                     descriptor_sets.data()),
+  descriptor_sets.resize(set_count);
+  CHECK_VK2(descriptors.allocate(logical_dev.device(), layouts, set_count,
+                                 descriptor_sets.data()),
             "failed to allocate descriptor sets");
 
-  //
-  for (std::size_t i = 0; i < swap_chain.simages.size(); i++) {
-    VkDescriptorBufferInfo binfo{};
-    binfo.buffer = uniform_buffers[i];
-    binfo.offset = 0;
-    binfo.range = sizeof(UniformBufferObject);
-    //
-    VkDescriptorImageInfo imageInfo{};
-    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    imageInfo.imageView = texture_image_view;
-    imageInfo.sampler = texture_sampler;
-    //
-    std::array<VkWriteDescriptorSet, 2> dwset{};
-
-    dwset[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    dwset[0].dstSet = descriptor_sets[i];
-    dwset[0].dstBinding = 0;
-    dwset[0].dstArrayElement = 0;
-    dwset[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    dwset[0].descriptorCount = 1;
-    dwset[0].pBufferInfo = &binfo;
-    //
-    dwset[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    dwset[1].dstSet = descriptor_sets[i];
-    dwset[1].dstBinding = 1;
-    dwset[1].dstArrayElement = 0;
-    dwset[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    dwset[1].descriptorCount = 1;
-    dwset[1].pImageInfo = &imageInfo;
-
-    //
-    vkUpdateDescriptorSets(logical_dev.device(),
-                           static_cast<uint32_t>(dwset.size()), dwset.data(), 0,
-                           nullptr);
+  // infos and writes live in the arena so that every set is written with a
+  // single vkUpdateDescriptorSets call
+  auto dwset = make_arena_vector<VkWriteDescriptorSet>(arena, 2 * set_count);
+  for (std::size_t i = 0; i < set_count; i++) {
+    writeDrawSet(descriptor_sets[i], i, dwset);
   }
+  //
+  vkUpdateDescriptorSets(logical_dev.device(),
+                         static_cast<uint32_t>(dwset.size()), dwset.data(), 0,
+                         nullptr);
+}
+void HelloTriangle::writeDrawSet(VkDescriptorSet set, std::size_t image,
+                                 arena_vector<VkWriteDescriptorSet> &writes) {
+  frame_arena &arena = frame_arenas[current_frame];
+  VkDescriptorBufferInfo *binfo = arena.alloc_array<VkDescriptorBufferInfo>(1);
+  binfo->buffer = uniform_buffers[image];
+  binfo->offset = 0;
+  binfo->range = sizeof(UniformBufferObject);
+  //
+  VkDescriptorImageInfo *imageInfo =
+      arena.alloc_array<VkDescriptorImageInfo>(1);
+  imageInfo->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  imageInfo->imageView = texture_image_view;
+  imageInfo->sampler = texture_sampler;
+  //
+  VkWriteDescriptorSet ubo_write{};
+  ubo_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  ubo_write.dstSet = set;
+  ubo_write.dstBinding = 0;
+  ubo_write.dstArrayElement = 0;
+  ubo_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  ubo_write.descriptorCount = 1;
+  ubo_write.pBufferInfo = binfo;
+  writes.push_back(ubo_write);
+  //
+  VkWriteDescriptorSet sampler_write{};
+  sampler_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  sampler_write.dstSet = set;
+  sampler_write.dstBinding = 1;
+  sampler_write.dstArrayElement = 0;
+  sampler_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  sampler_write.descriptorCount = 1;
+  sampler_write.pImageInfo = imageInfo;
+  writes.push_back(sampler_write);
 }
 /** Descriptor layout for binding*/
 void HelloTriangle::createDescriptorSetLayout() {
@@ -98,14 +92,44 @@ void HelloTriangle::createDescriptorSetLayout() {
   std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding,
                                                           samplerLayoutBinding};
   //
-  VkDescriptorSetLayoutCreateInfo layoutInfo{};
-  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-  layoutInfo.pBindings = bindings.data();
-
-  CHECK_VK2(vkCreateDescriptorSetLayout(logical_dev.device(), &layoutInfo,
-                                        nullptr, &descriptor_set_layout),
+  CHECK_VK2(descriptor_layouts.get(logical_dev.device(), bindings.data(),
+                                   bindings.size(), descriptor_set_layout),
             "descriptor set layout creation failed");
 }
+void HelloTriangle::createTextureTable() {
+  if (!bindless_enabled) {
+    return;
+  }
+  if (!bindless_texture_table::supported(logical_dev.enabled12)) {
+    std::cout << "bindless textures disabled, descriptor indexing is not "
+                 "supported"
+              << std::endl;
+    return;
+  }
+  uint32_t capacity = bindless_texture_table::device_capacity(
+      physical_dev.device(), texture_table_capacity);
+  CHECK_VK2(texture_table.create(logical_dev.device(), capacity,
+                                 logical_dev.enabled12),
+            "failed to create bindless texture table");
+}
+void HelloTriangle::addTableTextures() {
+  if (!texture_table.valid()) {
+    return;
+  }
+  CHECK_VK2(texture_table.add(logical_dev.device(), texture_image_view,
+                              texture_sampler, model_texture_slot),
+            "failed to add the model texture to the bindless table");
+}
+VkDescriptorSet HelloTriangle::textureTableSet() const {
+  return use_bindless ? texture_table.set() : VK_NULL_HANDLE;
+}
+void HelloTriangle::reportDescriptorStats() {
+  descriptor_layouts.report(std::cout);
+  if (texture_table.valid()) {
+    texture_table.report(std::cout);
+  }
+  descriptors.report(std::cout, "swapchain");
+  cull_descriptors.report(std::cout, "cull");
+}
 
 } // namespace vtuto
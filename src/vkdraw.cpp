@@ -7,8 +7,32 @@ using namespace vtuto;
 namespace vtuto {
 
 void HelloTriangle::draw() {
-  vkWaitForFences(logical_dev.device(), 1, &current_fences[current_frame],
-                  VK_TRUE, UINT64_MAX);
+  current_frame = frames.current_slot();
+  uint64_t completed = frames.begin_frame(logical_dev.device());
+  // everything allocated during this frame slot's last use is now free
+  frame_arenas[current_frame].reset();
+  // so is every frame submitted before it, release what they still used
+  deletions.collect(completed);
+  // a pipeline rebuilt from changed shaders is swapped in here, between
+  // frames, the one it replaces goes through deletions
+  if (hot_reload_enabled) {
+    pollShaderChanges();
+  }
+  // the fallback is drawn until a worker finished the optimized pipeline
+  VkPipeline ready = pipeline_builds.ready_or_fallback(graphics_desc);
+  if (ready != graphics_pipeline) {
+    graphics_pipeline = ready;
+    if (recording_mode != command_recording::per_frame) {
+      // prebaked buffers bind the one drawn so far
+      retireCommandBuffers();
+      createCommandBuffers();
+    }
+  }
+  if (pacing.wait_before_acquire) {
+    // latency over throughput: nothing queued when input is sampled
+    frames.wait(logical_dev.device(), frames.last_value());
+  }
+  frame_latency.completed(frames.completed_value(logical_dev.device()));
 
   uint32_t image_index;
   VkResult res = vkAcquireNextImageKHR(
@@ -23,38 +47,52 @@ void HelloTriangle::draw() {
     throw std::runtime_error("swap chain image request failed");
   }
 
-  if (images_in_flight[image_index] != VK_NULL_HANDLE) {
-    vkWaitForFences(logical_dev.device(), 1, &images_in_flight[image_index],
-                    VK_TRUE, UINT64_MAX);
+  // another slot may still render to this image
+  frames.wait_image(logical_dev.device(), image_index);
+  double gpu_ms = 0.0;
+  if (frame_timer.read_ms(logical_dev.device(), image_index, gpu_ms)) {
+    gpu_time_ms_total += gpu_ms;
+    gpu_time_samples++;
   }
-  images_in_flight[image_index] = current_fences[current_frame];
+
+  // before the bounds are rewritten, they are what the gpu tested
+  readCulling(image_index);
 
   // update uniform
   updateUniformBuffer(image_index);
+  writeInstances(image_index);
+  writeCulling(image_index);
 
   VkSubmitInfo submitInfo{};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-  VkSemaphore waitSemaphores[] = {image_available_semaphores[current_frame]};
-  VkPipelineStageFlags waitStages[] = {
-      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-  submitInfo.waitSemaphoreCount = 1;
-  submitInfo.pWaitSemaphores = waitSemaphores;
-  submitInfo.pWaitDstStageMask = waitStages;
-
   submitInfo.commandBufferCount = 1;
-  auto v = cmd_buffers.get(image_index);
+  VkCommandBuffer v;
+  if (recording_mode == command_recording::per_frame) {
+    // the slot's previous frame completed above, its pool can be reset
+    v = recordFrameCommands(image_index);
+  } else {
+    v = cmd_buffers.get(image_index);
+  }
   submitInfo.pCommandBuffers = &v;
 
+  // binary semaphores for the swapchain, the timeline value for the cpu
+  uint64_t frame_value = frames.frame_value(image_index);
   VkSemaphore signalSemaphores[] = {render_finished_semaphores[current_frame]};
-  submitInfo.signalSemaphoreCount = 1;
-  submitInfo.pSignalSemaphores = signalSemaphores;
+  timeline_submit sems;
+  sems.wait(image_available_semaphores[current_frame],
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+  sems.signal(signalSemaphores[0]);
+  sems.signal(frames.semaphore(timeline_lane::graphics), frame_value);
+  sems.fill(submitInfo);
 
-  vkResetFences(logical_dev.device(), 1, &current_fences[current_frame]);
   //
   CHECK_VK2(vkQueueSubmit(logical_dev.graphics_queue, 1, &submitInfo,
-                          current_fences[current_frame]),
+                          VK_NULL_HANDLE),
             "failed to submit draw command buffer");
+  deletions.submitted(frame_value);
+  frame_timer.mark_submitted(image_index);
+  frame_latency.submitted(frame_value);
   //
   VkPresentInfoKHR presentInfo{};
   presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -67,7 +105,12 @@ void HelloTriangle::draw() {
   presentInfo.pSwapchains = swap_chains;
   presentInfo.pImageIndices = &image_index;
 
+  auto present_start = std::chrono::steady_clock::now();
   res = vkQueuePresentKHR(logical_dev.present_queue, &presentInfo);
+  std::chrono::duration<double, std::micro> present_took =
+      std::chrono::steady_clock::now() - present_start;
+  frame_latency.present_call_us(present_took.count());
+  frame_latency.completed(frames.completed_value(logical_dev.device()));
 
   if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR ||
       framebuffer_resized) {
@@ -79,6 +122,6 @@ void HelloTriangle::draw() {
   }
 
   //
-  current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+  frames.end_frame();
 }
 }
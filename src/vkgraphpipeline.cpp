@@ -7,160 +7,130 @@ namespace vtuto {
 //
 
 void HelloTriangle::createGraphicsPipeline() {
-  auto vxShaderCode =
-      read_shader_file("./shaders/vulkansimple/vulkansimple.vert.spv");
-  auto fragShaderCode =
-      read_shader_file("./shaders/vulkansimple/vulkansimple.frag.spv");
-
-  auto vertexModule = createShaderModule(vxShaderCode);
-  auto fragModule = createShaderModule(fragShaderCode);
-  //
-  VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-  vertShaderStageInfo.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-  vertShaderStageInfo.module = vertexModule;
-  vertShaderStageInfo.pName = "main";
-
-  VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-  fragShaderStageInfo.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-  fragShaderStageInfo.module = fragModule;
-  fragShaderStageInfo.pName = "main";
-
-  //
-  VkPipelineShaderStageCreateInfo stages[] = {vertShaderStageInfo,
-                                              fragShaderStageInfo};
-
-  // vertex input pipeline creation
-  VkPipelineVertexInputStateCreateInfo vxInputInfo{};
-  vxInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-  auto bindingDescr = Vertex::getBindingDescription();
-  auto attrDescr = Vertex::getAttributeDescriptions();
-  vxInputInfo.vertexBindingDescriptionCount = 1;
-  vxInputInfo.vertexAttributeDescriptionCount =
-      static_cast<uint32_t>(attrDescr.size());
-  vxInputInfo.pVertexBindingDescriptions = &bindingDescr;
-  vxInputInfo.pVertexAttributeDescriptions = attrDescr.data();
-
-  // input assembly pipeline creation
-  VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-  inputAssembly.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-  inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-  inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-  // viewport configuration
-  VkViewport viewport{};
-  viewport.x = 0.0f;
-  viewport.y = 0.0f;
-  viewport.width = (float)swap_chain.sextent.width;
-  viewport.height = (float)swap_chain.sextent.height;
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
-
-  // scissoring area configuration
-  VkRect2D scissor{};
-  scissor.offset = {0, 0};
-  scissor.extent = swap_chain.sextent;
-
-  // viewport state change configuration
-  VkPipelineViewportStateCreateInfo viewportState{};
-  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-  viewportState.viewportCount = 1;
-  viewportState.pViewports = &viewport;
-  viewportState.scissorCount = 1;
-  viewportState.pScissors = &scissor;
-
-  // rasterization state configuration
-  VkPipelineRasterizationStateCreateInfo rasterizer{};
-  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-  rasterizer.depthClampEnable = VK_FALSE;
-  rasterizer.rasterizerDiscardEnable = VK_FALSE;
-  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-  rasterizer.lineWidth = 1.0f;
-  rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-  rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-  rasterizer.depthBiasEnable = VK_FALSE;
-
-  // multisample state configuration
-  VkPipelineMultisampleStateCreateInfo multisampling{};
-  multisampling.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-  multisampling.sampleShadingEnable = VK_FALSE;
-  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-  // depth attachment state configuration
-  VkPipelineDepthStencilStateCreateInfo depthStencil{};
-  depthStencil.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-  depthStencil.depthTestEnable = VK_TRUE;
-  depthStencil.depthWriteEnable = VK_TRUE;
-  depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-  depthStencil.depthBoundsTestEnable = VK_FALSE;
-  depthStencil.minDepthBounds = 0.0f;
-  depthStencil.maxDepthBounds = 1.0f;
-  depthStencil.stencilTestEnable = VK_FALSE;
-  depthStencil.front = {};
-  depthStencil.back = {};
-
-  // color blend attachement state configuration
-  VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-  colorBlendAttachment.colorWriteMask =
-      VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-  colorBlendAttachment.blendEnable = VK_FALSE;
-
-  //
-  // color blend state configuration
-  VkPipelineColorBlendStateCreateInfo colorBlend{};
-  colorBlend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-  colorBlend.logicOpEnable = VK_FALSE;
-  colorBlend.logicOp = VK_LOGIC_OP_COPY;
-  colorBlend.attachmentCount = 1;
-  colorBlend.pAttachments = &colorBlendAttachment;
-  colorBlend.blendConstants[0] = 0.0f;
-  colorBlend.blendConstants[1] = 0.0f;
-  colorBlend.blendConstants[2] = 0.0f;
-  colorBlend.blendConstants[3] = 0.0f;
-
-  // pipeline layout create info configuration
-  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  //
-  pipelineLayoutInfo.setLayoutCount = 1;
-  pipelineLayoutInfo.pSetLayouts = &descriptor_set_layout;
-  //
-  // pipelineLayoutInfo.pushConstantRangeCount = 0;
-
-  CHECK_VK2(vkCreatePipelineLayout(logical_dev.device(), &pipelineLayoutInfo,
-                                   nullptr, &pipeline_layout),
-            "failed to create pipeline layout");
-
-  // create pipeline object
-  VkGraphicsPipelineCreateInfo pipelineInfo{};
-  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  pipelineInfo.stageCount = 2;
-  pipelineInfo.pStages = stages;
-  pipelineInfo.pVertexInputState = &vxInputInfo;
-  pipelineInfo.pInputAssemblyState = &inputAssembly;
-  pipelineInfo.pViewportState = &viewportState;
-  pipelineInfo.pRasterizationState = &rasterizer;
-  pipelineInfo.pMultisampleState = &multisampling;
-  pipelineInfo.pDepthStencilState = &depthStencil;
-  pipelineInfo.pColorBlendState = &colorBlend;
-  pipelineInfo.layout = pipeline_layout;
-  pipelineInfo.renderPass = render_pass;
-  pipelineInfo.subpass = 0;
-  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-  CHECK_VK2(vkCreateGraphicsPipelines(logical_dev.device(), VK_NULL_HANDLE, 1,
-                                      &pipelineInfo, nullptr,
-                                      &graphics_pipeline),
-            "failed to create graphics pipeline");
-
-  vkDestroyShaderModule(logical_dev.device(), fragModule, nullptr);
-  vkDestroyShaderModule(logical_dev.device(), vertexModule, nullptr);
+  // the instanced shader reads a transform per instance from binding 1,
+  // without its spir-v a single copy is drawn with the plain shader
+  const std::string instancedShaderPath =
+      "./shaders/vulkansimple/instanced.vert.spv";
+  instancing = shaders.available(instancedShaderPath);
+  if (!instancing) {
+    std::cout << "instancing disabled, " << instancedShaderPath
+              << " not found" << std::endl;
+  }
+  // the push constant variants take the model matrix from the draw, the
+  // uniform buffer then only changes with the camera
+  const std::string pushShaderPath =
+      instancing ? "./shaders/vulkansimple/pushconst_instanced.vert.spv"
+                 : "./shaders/vulkansimple/pushconst.vert.spv";
+  use_push_constants =
+      push_constants_enabled && shaders.available(pushShaderPath);
+  if (push_constants_enabled && !use_push_constants) {
+    std::cout << "push constants disabled, " << pushShaderPath
+              << " not found" << std::endl;
+  }
+  std::string vxShaderPath =
+      instancing ? instancedShaderPath
+                 : "./shaders/vulkansimple/vulkansimple.vert.spv";
+  // the bindless fragment shader indexes the texture table with the
+  // pushed material, without push constants it has no index to read
+  const std::string bindlessShaderPath =
+      "./shaders/vulkansimple/bindless.frag.spv";
+  use_bindless = texture_table.valid() && use_push_constants &&
+                 shaders.available(bindlessShaderPath);
+  if (texture_table.valid() && !use_bindless) {
+    std::cout << "bindless textures disabled, "
+              << (use_push_constants ? bindlessShaderPath + " not found"
+                                     : std::string("no push constants"))
+              << std::endl;
+  }
+  std::string fragShaderPath =
+      use_bindless ? bindlessShaderPath
+                   : "./shaders/vulkansimple/vulkansimple.frag.spv";
+  graphics_shader_paths = {use_push_constants ? pushShaderPath : vxShaderPath,
+                           fragShaderPath};
+  // registered modules are reused, only the first build maps the files
+  auto vertexModule = acquireShader(graphics_shader_paths[0]);
+  auto fragModule = acquireShader(graphics_shader_paths[1]);
+
+  // the layout only depends on the descriptor set layout and the push
+  // range, it outlives rebuilds so equal descriptions stay equal. A
+  // shader appearing or going between swapchains changes the set count
+  // or the push range, the old layout then goes once frames in flight
+  // are done with it
+  if (pipeline_layout != VK_NULL_HANDLE &&
+      (layout_push_constants != use_push_constants ||
+       layout_bindless != use_bindless)) {
+    deletions.destroy(logical_dev.device(), pipeline_layout,
+                      vkDestroyPipelineLayout);
+    pipeline_layout = VK_NULL_HANDLE;
+  }
+  if (pipeline_layout == VK_NULL_HANDLE) {
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    //
+    // set 1 is the texture table, when there is one
+    std::array<VkDescriptorSetLayout, 2> setLayouts = {descriptor_set_layout,
+                                                       texture_table.layout()};
+    pipelineLayoutInfo.setLayoutCount = use_bindless ? 2 : 1;
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+    //
+    VkPushConstantRange pushRange = DrawPushConstants::range();
+    pipelineLayoutInfo.pushConstantRangeCount = use_push_constants ? 1 : 0;
+    pipelineLayoutInfo.pPushConstantRanges =
+        use_push_constants ? &pushRange : nullptr;
+
+    CHECK_VK2(vkCreatePipelineLayout(logical_dev.device(),
+                                     &pipelineLayoutInfo, nullptr,
+                                     &pipeline_layout),
+              "failed to create pipeline layout");
+    layout_push_constants = use_push_constants;
+    layout_bindless = use_bindless;
+  }
+
+  graphics_pipeline_desc desc;
+  desc.vertex_module = vertexModule;
+  desc.fragment_module = fragModule;
+  desc.vertex_shader = shaders.content_hash(vertexModule);
+  desc.fragment_shader = shaders.content_hash(fragModule);
+
+  // vertex input, per instance transforms come from binding 1
+  desc.bindings.push_back(Vertex::getBindingDescription());
+  auto vertexAttrs = Vertex::getAttributeDescriptions();
+  desc.attributes.assign(vertexAttrs.begin(), vertexAttrs.end());
+  if (instancing) {
+    desc.bindings.push_back(InstanceData::getBindingDescription());
+    auto instanceAttrs = InstanceData::getAttributeDescriptions();
+    desc.attributes.insert(desc.attributes.end(), instanceAttrs.begin(),
+                           instanceAttrs.end());
+  }
+  // triangle lists, back faces culled, depth tested and written, opaque,
+  // viewport and scissor dynamic: the description's defaults
+  desc.render_pass = render_pass;
+  desc.render_pass_compat = render_pass_compat;
+  desc.subpass = 0;
+  desc.layout = pipeline_layout;
+
+  // nothing waits for the optimized pipeline: a worker compiles it while
+  // draws use a copy built without optimization, which the driver turns
+  // around much faster. An equal description built before, e.g. by the
+  // previous swapchain, comes back from the library for both without a
+  // driver call
+  graphics_pipeline_desc quick = desc;
+  quick.flags = VK_PIPELINE_CREATE_DISABLE_OPTIMIZATION_BIT;
+  try {
+    pipeline_builds.set_fallback(desc, pipeline_builds.request(quick).get());
+  } catch (const std::exception &e) {
+    throw std::runtime_error(std::string("failed to create graphics "
+                                         "pipeline: ") +
+                             e.what());
+  }
+  graphics_pipeline = pipeline_builds.ready_or_fallback(desc);
+
+  // the previous pipeline's modules go only now that the new one holds
+  // its own references, unchanged files keep their module
+  for (VkShaderModule previous : graphics_modules) {
+    shaders.release(logical_dev.device(), previous);
+  }
+  graphics_modules = {vertexModule, fragModule};
+  graphics_desc = desc;
 }
 } // namespace vtuto
@@ -0,0 +1,183 @@
+// shader hot reload
+#include <hellotriangle.hpp>
+
+using namespace vtuto;
+
+namespace vtuto {
+
+void HelloTriangle::startHotReload() {
+  const std::string root = "./shaders";
+  if (!shader_changes.start(root)) {
+    std::cerr << "hot reload disabled, can not watch " << root << std::endl;
+    hot_reload_enabled = false;
+    return;
+  }
+  reload_worker.start(1);
+  std::cout << "hotreload.watching " << root << std::endl;
+}
+void HelloTriangle::pollShaderChanges() {
+  for (const std::string &path : shader_changes.poll()) {
+    // a source counts when the spir-v it compiles to is in use
+    const std::string used = is_shader_source(path) ? spirv_path(path) : path;
+    if (std::find(graphics_shader_paths.begin(), graphics_shader_paths.end(),
+                  used) != graphics_shader_paths.end()) {
+      reload_queued.insert(path);
+      reload_stats.changes++;
+    }
+  }
+  if (pending_reload.valid()) {
+    if (pending_reload.wait_for(std::chrono::seconds(0)) !=
+        std::future_status::ready) {
+      return;
+    }
+    shader_reload done = pending_reload.get();
+    applyShaderReload(done);
+  }
+  if (reload_queued.empty()) {
+    return;
+  }
+  std::set<std::string> changed;
+  changed.swap(reload_queued);
+  graphics_pipeline_desc base = graphics_desc;
+  std::array<std::string, 2> paths = graphics_shader_paths;
+  pending_reload = reload_worker.submit([this, changed, base,
+                                         paths](std::size_t) {
+    return rebuildGraphicsPipeline(changed, base, paths);
+  });
+}
+shader_reload
+HelloTriangle::rebuildGraphicsPipeline(std::set<std::string> changed,
+                                       graphics_pipeline_desc base,
+                                       std::array<std::string, 2> paths) {
+  auto start = std::chrono::steady_clock::now();
+  VkDevice device = logical_dev.device();
+  shader_reload r;
+  r.desc = base;
+  auto finish = [&r, start]() {
+    std::chrono::duration<double, std::micro> took =
+        std::chrono::steady_clock::now() - start;
+    r.us = took.count();
+  };
+  for (const std::string &path : changed) {
+    if (is_shader_source(path) && !shader_compiler.empty() &&
+        !compile_shader(shader_compiler, path)) {
+      r.result = VK_ERROR_INITIALIZATION_FAILED;
+      r.error = "failed to compile " + path;
+      finish();
+      return r;
+    }
+  }
+  // the registry would answer from the modules it already has
+  for (std::size_t i = 0; i < paths.size(); i++) {
+    shaders.invalidate(paths[i]);
+  }
+  for (std::size_t i = 0; i < paths.size(); i++) {
+    r.result = shaders.acquire(device, paths[i], r.modules[i]);
+    if (r.result != VK_SUCCESS) {
+      r.error = "failed to load " + paths[i];
+      for (VkShaderModule m : r.modules) {
+        shaders.release(device, m);
+      }
+      r.modules = {};
+      finish();
+      return r;
+    }
+  }
+  r.desc.vertex_module = r.modules[0];
+  r.desc.fragment_module = r.modules[1];
+  r.desc.vertex_shader = shaders.content_hash(r.modules[0]);
+  r.desc.fragment_shader = shaders.content_hash(r.modules[1]);
+  if (r.desc == base) {
+    // saved without changes, or the spir-v of a source compiled before
+    r.unchanged = true;
+    finish();
+    return r;
+  }
+  // vkCreateGraphicsPipelines synchronizes the cache itself, the render
+  // thread and the build workers keep using it meanwhile
+  r.result = graphics_pipeline_library::build(device, pipelines, r.desc,
+                                              r.pipeline);
+  if (r.result != VK_SUCCESS) {
+    r.error = "failed to build the reloaded graphics pipeline";
+    for (VkShaderModule m : r.modules) {
+      shaders.release(device, m);
+    }
+    r.modules = {};
+  }
+  finish();
+  return r;
+}
+void HelloTriangle::applyShaderReload(shader_reload &reload) {
+  VkDevice device = logical_dev.device();
+  reload_stats.add(reload);
+  if (reload.result != VK_SUCCESS) {
+    // keep drawing with what we have until the next save
+    reload_stats.failed++;
+    std::cerr << "hot reload: " << reload.error << std::endl;
+    return;
+  }
+  auto release_modules = [this, device, &reload]() {
+    for (VkShaderModule m : reload.modules) {
+      shaders.release(device, m);
+    }
+  };
+  if (reload.unchanged) {
+    reload_stats.unchanged++;
+    release_modules();
+    return;
+  }
+  // only the shaders may differ from what is drawn now, a swapchain
+  // rebuild meanwhile may have replaced the render pass
+  graphics_pipeline_desc expected = graphics_desc;
+  expected.vertex_shader = reload.desc.vertex_shader;
+  expected.fragment_shader = reload.desc.fragment_shader;
+  if (!(expected == reload.desc)) {
+    reload_stats.stale++;
+    vkDestroyPipeline(device, reload.pipeline, nullptr);
+    release_modules();
+    reload_queued.insert(graphics_shader_paths.begin(),
+                         graphics_shader_paths.end());
+    return;
+  }
+  VkPipeline fresh = pipeline_builds.adopt(reload.desc, reload.pipeline);
+  // frames in flight still bind the old pipeline, it goes once they are
+  // done
+  deletions.destroy(device, pipeline_builds.retire(graphics_desc),
+                    vkDestroyPipeline);
+  for (VkShaderModule previous : graphics_modules) {
+    shaders.release(device, previous);
+  }
+  graphics_modules = reload.modules;
+  graphics_desc = reload.desc;
+  graphics_pipeline = fresh;
+  if (recording_mode != command_recording::per_frame) {
+    // prebaked buffers bind the old pipeline
+    retireCommandBuffers();
+    createCommandBuffers();
+  }
+  reload_stats.swaps++;
+  std::cout << "hotreload.swapped_after_us " << reload.us << std::endl;
+}
+void HelloTriangle::waitShaderReload() {
+  if (pending_reload.valid()) {
+    pending_reload.wait();
+  }
+}
+void HelloTriangle::stopHotReload() {
+  if (!hot_reload_enabled) {
+    return;
+  }
+  shader_changes.stop();
+  if (pending_reload.valid()) {
+    // finished or not, it is never swapped in
+    shader_reload r = pending_reload.get();
+    vkDestroyPipeline(logical_dev.device(), r.pipeline, nullptr);
+    for (VkShaderModule m : r.modules) {
+      shaders.release(logical_dev.device(), m);
+    }
+  }
+  reload_worker.stop();
+  reload_stats.report(std::cout);
+}
+
+} // namespace vtuto
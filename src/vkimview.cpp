@@ -12,7 +12,7 @@ void HelloTriangle::createDepthRessources() {
   auto usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
   auto memflag = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
   createImage(width, height, depth_format, tiling, usage, memflag, depth_image,
-              depth_image_memory);
+              depth_image_memory, memory_category::attachment);
   depth_image_view =
       createImageView(depth_image, depth_format, VK_IMAGE_ASPECT_DEPTH_BIT);
   // transitionImageLayout(
@@ -32,10 +32,11 @@ VkImageView HelloTriangle::createImageView(VkImage image, VkFormat image_format,
   createInfo.subresourceRange.levelCount = 1;
   createInfo.subresourceRange.baseArrayLayer = 0;
   createInfo.subresourceRange.layerCount = 1;
+  // the same view of the same image is created once, it goes when the
+  // image is released from the cache
   VkImageView imview;
-  CHECK_VK2(
-      vkCreateImageView(logical_dev.device(), &createInfo, nullptr, &imview),
-      "failed to create texture image view");
+  CHECK_VK2(view_cache.get(logical_dev.device(), createInfo, imview),
+            "failed to create texture image view");
   return imview;
 }
 void HelloTriangle::createTextureImageView() {
@@ -4,6 +4,17 @@ using namespace vtuto;
 namespace vtuto {
 void HelloTriangle::createLogicalDevice() {
   logical_dev = vulkan_device<VkDevice>(enableValidationLayers, physical_dev);
+  memory_stats = memory_tracker(
+      physical_dev.device(),
+      logical_dev.is_enabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME));
+  CHECK_VK2(pipelines.create(
+                physical_dev.device(), logical_dev.device(),
+                pipeline_cache_path,
+                logical_dev.is_enabled(
+                    VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME)),
+            "failed to create pipeline cache");
+  pipeline_builds.bind(logical_dev.device(), pipelines, pipeline_library,
+                       &record_workers);
 }
 
 } // namespace vtuto
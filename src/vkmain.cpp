@@ -19,12 +19,59 @@
 #include "vkimview.cpp"
 #include "vkphydevice.cpp"
 #include "vklogdevice.cpp"
+#include "vkcull.cpp"
+#include "vkhotreload.cpp"
 
 using namespace vtuto;
 
-extern "C" int main() {
+/** true and the text after the = when arg is --name=value*/
+bool option_value(const char *arg, const std::string &name,
+                  std::string &value) {
+  std::string a(arg);
+  std::string prefix = "--" + name + "=";
+  if (a.compare(0, prefix.size(), prefix) != 0) {
+    return false;
+  }
+  value = a.substr(prefix.size());
+  return true;
+}
+
+extern "C" int main(int argc, char **argv) {
   std::string wtitle = "Vulkan Window Title";
   HelloTriangle hello(wtitle, (uint32_t)WIDTH, (uint32_t)HEIGHT);
+  for (int i = 1; i < argc; i++) {
+    std::string value;
+    if (std::string(argv[i]) == "--bench-instances") {
+      hello.instance_benchmark = true;
+    } else if (std::string(argv[i]) == "--no-cull") {
+      hello.culling_enabled = false;
+    } else if (std::string(argv[i]) == "--verify-cull") {
+      hello.verify_culling = true;
+    } else if (std::string(argv[i]) == "--cull-no-far") {
+      // the culling shader is specialized without its far plane test
+      hello.cull_constants.far_plane = VK_FALSE;
+    } else if (std::string(argv[i]) == "--no-push-constants") {
+      hello.push_constants_enabled = false;
+    } else if (std::string(argv[i]) == "--no-bindless") {
+      hello.bindless_enabled = false;
+    } else if (std::string(argv[i]) == "--rebuild-pipeline-on-resize") {
+      hello.rebuild_pipeline_on_resize = true;
+    } else if (std::string(argv[i]) == "--hot-reload") {
+      hello.hot_reload_enabled = true;
+    } else if (std::string(argv[i]) == "--record-per-frame") {
+      hello.recording_mode = command_recording::per_frame;
+    } else if (option_value(argv[i], "pacing", value)) {
+      // before run(), the device is created with these settings
+      if (!frame_pacing_config::preset(value, hello.pacing)) {
+        std::cerr << "unknown pacing " << value
+                  << ", expected throughput or latency" << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if (option_value(argv[i], "record-threads", value)) {
+      // 0 is one per core, 1 records serially on the main thread
+      hello.record_threads = std::strtoul(value.c_str(), nullptr, 10);
+    }
+  }
 
   try {
     hello.run();
@@ -0,0 +1,217 @@
+// pipeline compilation time against worker count, headless, run from bin/
+// e.g. VK_ICD_FILENAMES=.../lvp_icd.x86_64.json ./vkpipelinebench.out 8
+#include <chrono>
+#include <cstdlib>
+#include <external.hpp>
+#include <utils.hpp>
+#include <vertex.hpp>
+#include <vkpipeline/buildqueue.hpp>
+#include <vkutils/benchdevice.hpp>
+
+using namespace vtuto;
+
+/**
+  Every combination of cull mode, front face, blending and topology, the
+  kind of variants a material system asks for at startup.
+ */
+std::vector<graphics_pipeline_desc> permutations(const bench_device &bd) {
+  graphics_pipeline_desc base;
+  base.vertex_module = bd.vertex;
+  base.fragment_module = bd.fragment;
+  base.vertex_shader = bd.shaders.content_hash(bd.vertex);
+  base.fragment_shader = bd.shaders.content_hash(bd.fragment);
+  base.bindings.push_back(Vertex::getBindingDescription());
+  auto attrs = Vertex::getAttributeDescriptions();
+  base.attributes.assign(attrs.begin(), attrs.end());
+  base.depth_test = VK_FALSE;
+  base.depth_write = VK_FALSE;
+  base.render_pass = bd.render_pass;
+  base.render_pass_compat = bd.render_pass_compat;
+  base.layout = bd.layout;
+
+  std::vector<graphics_pipeline_desc> descs;
+  for (VkCullModeFlags cull :
+       {VK_CULL_MODE_NONE, VK_CULL_MODE_FRONT_BIT, VK_CULL_MODE_BACK_BIT,
+        VK_CULL_MODE_FRONT_AND_BACK}) {
+    for (VkFrontFace face :
+         {VK_FRONT_FACE_COUNTER_CLOCKWISE, VK_FRONT_FACE_CLOCKWISE}) {
+      for (VkBool32 blend : {VK_FALSE, VK_TRUE}) {
+        for (VkPrimitiveTopology topology :
+             {VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+              VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+              VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN}) {
+          graphics_pipeline_desc d = base;
+          d.cull_mode = cull;
+          d.front_face = face;
+          d.topology = topology;
+          d.blend.blendEnable = blend;
+          if (blend) {
+            d.blend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+            d.blend.dstColorBlendFactor =
+                VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+          }
+          descs.push_back(d);
+        }
+      }
+    }
+  }
+  return descs;
+}
+
+/** request every description and wait for all, in milliseconds */
+double build_all(bench_device &bd, pipeline_cache &cache,
+                 graphics_pipeline_library &library, thread_pool *pool,
+                 const std::vector<graphics_pipeline_desc> &descs,
+                 pipeline_build_queue &queue) {
+  queue.bind(bd.device, cache, library, pool);
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::shared_future<VkPipeline>> futures;
+  futures.reserve(descs.size());
+  for (const auto &d : descs) {
+    futures.push_back(queue.request(d));
+  }
+  for (auto &f : futures) {
+    f.get();
+  }
+  std::chrono::duration<double, std::milli> took =
+      std::chrono::steady_clock::now() - start;
+  return took.count();
+}
+
+/**
+  What frames draw while the optimized pipelines compile: every
+  description gets a fallback built without optimization on the caller,
+  then each frame asks ready_or_fallback() for all of them until no build
+  is pending. Prints how many draws got the fallback meanwhile.
+ */
+void fallback_frames(bench_device &bd,
+                     const std::vector<graphics_pipeline_desc> &descs,
+                     std::size_t threads) {
+  pipeline_cache cache;
+  CHECK_VK2(cache.create(bd.pdev, bd.device, "", false),
+            "failed to create pipeline cache");
+  graphics_pipeline_library library;
+  thread_pool pool;
+  pool.start(threads);
+  pipeline_build_queue queue;
+  queue.bind(bd.device, cache, library, &pool);
+
+  std::vector<VkPipeline> fallbacks;
+  for (const auto &d : descs) {
+    graphics_pipeline_desc quick = d;
+    quick.flags = VK_PIPELINE_CREATE_DISABLE_OPTIMIZATION_BIT;
+    VkPipeline fallback = VK_NULL_HANDLE;
+    CHECK_VK2(graphics_pipeline_library::build(bd.device, cache, quick,
+                                               fallback),
+              "failed to build fallback pipeline");
+    queue.set_fallback(d, fallback);
+    fallbacks.push_back(fallback);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  uint64_t frames = 0;
+  uint64_t first_frame_fallbacks = 0;
+  uint64_t fallback_draws = 0;
+  std::size_t pending = descs.size();
+  while (pending > 0) {
+    pending = 0;
+    for (std::size_t i = 0; i < descs.size(); i++) {
+      VkPipeline pipeline = queue.ready_or_fallback(descs[i]);
+      if (pipeline == VK_NULL_HANDLE) {
+        throw std::runtime_error("draw without pipeline or fallback");
+      }
+      if (pipeline == fallbacks[i]) {
+        pending++;
+      }
+    }
+    if (frames == 0) {
+      first_frame_fallbacks = pending;
+    }
+    fallback_draws += pending;
+    frames++;
+    // a failed build would hand out its fallback for good
+    if (queue.stats().failed > 0) {
+      throw std::runtime_error("failed to build queued graphics pipeline");
+    }
+    // the rest of a frame
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  std::chrono::duration<double, std::milli> took =
+      std::chrono::steady_clock::now() - start;
+  std::cout << "pipelinebench.fallback.threads " << threads << std::endl;
+  std::cout << "pipelinebench.fallback.frames " << frames << std::endl;
+  std::cout << "pipelinebench.fallback.first_frame_fallbacks "
+            << first_frame_fallbacks << std::endl;
+  std::cout << "pipelinebench.fallback.fallback_draws " << fallback_draws
+            << std::endl;
+  std::cout << "pipelinebench.fallback.all_ready_ms " << took.count()
+            << std::endl;
+
+  pool.stop();
+  for (VkPipeline fallback : fallbacks) {
+    vkDestroyPipeline(bd.device, fallback, nullptr);
+  }
+  library.destroy(bd.device);
+  cache.destroy(bd.device);
+}
+
+int main(int argc, char **argv) {
+  // the driver's own disk cache would turn every run after the first warm
+  setenv("MESA_SHADER_CACHE_DISABLE", "true", 1);
+  setenv("MESA_GLSL_CACHE_DISABLE", "true", 1);
+
+  std::size_t max_threads = std::thread::hardware_concurrency();
+  if (argc > 1) {
+    max_threads = std::strtoul(argv[1], nullptr, 10);
+  }
+  max_threads = std::max<std::size_t>(max_threads, 1);
+
+  bench_device bd;
+  bd.create();
+  std::vector<graphics_pipeline_desc> descs = permutations(bd);
+  std::cout << "pipelinebench.device " << bd.device_name << std::endl;
+  std::cout << "pipelinebench.pipelines " << descs.size() << std::endl;
+
+  std::vector<std::size_t> counts;
+  for (std::size_t n = 1; n < max_threads; n *= 2) {
+    counts.push_back(n);
+  }
+  counts.push_back(max_threads);
+
+  double single_ms = 0.0;
+  for (std::size_t threads : counts) {
+    // everything fresh so each count compiles cold, no file behind the
+    // cache
+    pipeline_cache cache;
+    CHECK_VK2(cache.create(bd.pdev, bd.device, "", false),
+              "failed to create pipeline cache");
+    graphics_pipeline_library library;
+    thread_pool pool;
+    // one thread is the caller itself, as at startup without workers
+    if (threads > 1) {
+      pool.start(threads);
+    }
+    pipeline_build_queue cold;
+    double cold_ms = build_all(bd, cache, library, &pool, descs, cold);
+    if (threads == 1) {
+      single_ms = cold_ms;
+    }
+    std::string prefix = "pipelinebench.threads." + std::to_string(threads);
+    std::cout << prefix << ".cold_ms " << cold_ms << std::endl;
+    std::cout << prefix << ".speedup " << single_ms / cold_ms << std::endl;
+
+    // the same descriptions again in a new library, now from the cache
+    graphics_pipeline_library warm_library;
+    pipeline_build_queue warm;
+    double warm_ms = build_all(bd, cache, warm_library, &pool, descs, warm);
+    std::cout << prefix << ".warm_ms " << warm_ms << std::endl;
+
+    pool.stop();
+    library.destroy(bd.device);
+    warm_library.destroy(bd.device);
+    cache.destroy(bd.device);
+  }
+  fallback_frames(bd, descs, max_threads);
+  bd.destroy();
+  return 0;
+}
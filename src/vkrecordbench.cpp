@@ -0,0 +1,195 @@
+// secondary command buffer recording time against worker count, headless,
+// run from bin/, e.g. ./vkrecordbench.out 8 20000
+#include <chrono>
+#include <commandbuffer.hpp>
+#include <cstdlib>
+#include <external.hpp>
+#include <utils.hpp>
+#include <vertex.hpp>
+#include <vkthread/cmdrecorder.hpp>
+#include <vkutils/benchdevice.hpp>
+
+using namespace vtuto;
+
+/** what the recorded draws bind, never submitted so never filled */
+struct record_scene {
+  pipeline_cache cache;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VkBuffer vertex_buffer = VK_NULL_HANDLE;
+  VkBuffer index_buffer = VK_NULL_HANDLE;
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+  VkDescriptorSet set = VK_NULL_HANDLE;
+  VkPipelineLayout layout = VK_NULL_HANDLE;
+  VkExtent2D extent = {800, 600};
+
+  void create(bench_device &bd) {
+    CHECK_VK2(cache.create(bd.pdev, bd.device, "", false),
+              "failed to create pipeline cache");
+    graphics_pipeline_desc d;
+    d.vertex_module = bd.vertex;
+    d.fragment_module = bd.fragment;
+    d.bindings.push_back(Vertex::getBindingDescription());
+    auto attrs = Vertex::getAttributeDescriptions();
+    d.attributes.assign(attrs.begin(), attrs.end());
+    d.depth_test = VK_FALSE;
+    d.depth_write = VK_FALSE;
+    d.render_pass = bd.render_pass;
+    d.render_pass_compat = bd.render_pass_compat;
+    d.layout = bd.layout;
+    layout = bd.layout;
+    CHECK_VK2(graphics_pipeline_library::build(bd.device, cache, d, pipeline),
+              "failed to build pipeline");
+
+    // one triangle, every draw reads the same three indices
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = sizeof(Vertex) * 3;
+    bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    CHECK_VK2(vkCreateBuffer(bd.device, &bufferInfo, nullptr, &vertex_buffer),
+              "failed to create vertex buffer");
+    bufferInfo.size = sizeof(uint32_t) * 3;
+    bufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+    CHECK_VK2(vkCreateBuffer(bd.device, &bufferInfo, nullptr, &index_buffer),
+              "failed to create index buffer");
+    VkMemoryRequirements vreq{};
+    vkGetBufferMemoryRequirements(bd.device, vertex_buffer, &vreq);
+    VkMemoryRequirements ireq{};
+    vkGetBufferMemoryRequirements(bd.device, index_buffer, &ireq);
+    VkDeviceSize index_offset =
+        (vreq.size + ireq.alignment - 1) / ireq.alignment * ireq.alignment;
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = index_offset + ireq.size;
+    allocInfo.memoryTypeIndex = bd.memory_type(
+        vreq.memoryTypeBits & ireq.memoryTypeBits,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    CHECK_VK2(vkAllocateMemory(bd.device, &allocInfo, nullptr, &memory),
+              "failed to allocate buffer memory");
+    vkBindBufferMemory(bd.device, vertex_buffer, memory, 0);
+    vkBindBufferMemory(bd.device, index_buffer, memory, index_offset);
+
+    std::array<VkDescriptorPoolSize, 2> sizes{};
+    sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    sizes[0].descriptorCount = 1;
+    sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    sizes[1].descriptorCount = 1;
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(sizes.size());
+    poolInfo.pPoolSizes = sizes.data();
+    CHECK_VK2(vkCreateDescriptorPool(bd.device, &poolInfo, nullptr,
+                                     &descriptor_pool),
+              "failed to create descriptor pool");
+    VkDescriptorSetAllocateInfo setInfo{};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = descriptor_pool;
+    setInfo.descriptorSetCount = 1;
+    setInfo.pSetLayouts = &bd.set_layout;
+    CHECK_VK2(vkAllocateDescriptorSets(bd.device, &setInfo, &set),
+              "failed to allocate descriptor set");
+  }
+  void destroy(bench_device &bd) {
+    vkDestroyDescriptorPool(bd.device, descriptor_pool, nullptr);
+    vkDestroyBuffer(bd.device, index_buffer, nullptr);
+    vkDestroyBuffer(bd.device, vertex_buffer, nullptr);
+    vkFreeMemory(bd.device, memory, nullptr);
+    vkDestroyPipeline(bd.device, pipeline, nullptr);
+    cache.destroy(bd.device);
+  }
+};
+
+/**
+  The draws split into one range per worker, as
+  HelloTriangle::recordCommandBuffersParallel splits its triangles: each
+  job binds what the draw needs, then records its range.
+ */
+std::vector<record_job> record_jobs(const record_scene &scene,
+                                    uint32_t draws, std::size_t workers) {
+  uint32_t per_job = static_cast<uint32_t>((draws + workers - 1) / workers);
+  std::vector<record_job> jobs;
+  for (uint32_t first = 0; first < draws; first += per_job) {
+    uint32_t count = std::min(per_job, draws - first);
+    jobs.push_back([&scene, first, count](VkCommandBuffer cb) {
+      vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, scene.pipeline);
+      cmd_set_viewport_scissor(cb, scene.extent);
+      VkDeviceSize offsets[] = {0};
+      vkCmdBindVertexBuffers(cb, 0, 1, &scene.vertex_buffer, offsets);
+      vkCmdBindIndexBuffer(cb, scene.index_buffer, 0, VK_INDEX_TYPE_UINT32);
+      cmd_bind_draw_sets(cb, scene.layout, scene.set, VK_NULL_HANDLE);
+      for (uint32_t i = first; i < first + count; i++) {
+        vkCmdDrawIndexed(cb, 3, 1, 0, 0, i);
+      }
+    });
+  }
+  return jobs;
+}
+
+int main(int argc, char **argv) {
+  std::size_t max_threads = std::thread::hardware_concurrency();
+  if (argc > 1) {
+    max_threads = std::strtoul(argv[1], nullptr, 10);
+  }
+  max_threads = std::max<std::size_t>(max_threads, 1);
+  uint32_t draws = 20000;
+  if (argc > 2) {
+    draws = static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10));
+  }
+  draws = std::max<uint32_t>(draws, 1);
+  const int rounds = 20;
+
+  bench_device bd;
+  bd.create();
+  record_scene scene;
+  scene.create(bd);
+  std::cout << "recordbench.device " << bd.device_name << std::endl;
+  std::cout << "recordbench.draws " << draws << std::endl;
+
+  std::vector<std::size_t> counts;
+  for (std::size_t n = 1; n < max_threads; n *= 2) {
+    counts.push_back(n);
+  }
+  counts.push_back(max_threads);
+
+  VkCommandBufferInheritanceInfo inheritance{};
+  inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritance.renderPass = bd.render_pass;
+  inheritance.subpass = 0;
+
+  double single_us = 0.0;
+  for (std::size_t threads : counts) {
+    thread_pool pool;
+    pool.start(threads);
+    thread_command_pools pools(bd.device, bd.graphics_family, threads);
+    std::vector<record_job> jobs = record_jobs(scene, draws, threads);
+    // the first round allocates the pools' memory, it is not timed
+    free_secondaries(bd.device, record_secondaries(pool, pools, bd.device,
+                                                   inheritance, jobs));
+    record_stats total;
+    for (int r = 0; r < rounds; r++) {
+      record_stats s;
+      std::vector<recorded_secondary> recorded =
+          record_secondaries(pool, pools, bd.device, inheritance, jobs, &s);
+      free_secondaries(bd.device, recorded);
+      total.wall_us += s.wall_us;
+      total.job_us += s.job_us;
+    }
+    double wall_us = total.wall_us / rounds;
+    if (threads == 1) {
+      single_us = wall_us;
+    }
+    std::string prefix = "recordbench.threads." + std::to_string(threads);
+    std::cout << prefix << ".record.wall_us " << wall_us << std::endl;
+    std::cout << prefix << ".record.job_us " << total.job_us / rounds
+              << std::endl;
+    std::cout << prefix << ".speedup " << single_us / wall_us << std::endl;
+
+    pool.stop();
+    pools.destroy(bd.device);
+  }
+  scene.destroy(bd);
+  bd.destroy();
+  return 0;
+}
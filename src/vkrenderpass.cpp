@@ -60,6 +60,8 @@ void HelloTriangle::createRenderPass() {
 
   std::array<VkAttachmentDescription, 2> attachments = {colorAttachment,
                                                         depthAttachment};
+  render_pass_compat =
+      render_pass_compat_hash(attachments.data(), attachments.size());
 
   // render pass create info
   VkRenderPassCreateInfo renderPassInfo{};
@@ -71,9 +73,9 @@ void HelloTriangle::createRenderPass() {
   renderPassInfo.dependencyCount = 1;
   renderPassInfo.pDependencies = &deps;
 
-  //
-  CHECK_VK2(vkCreateRenderPass(logical_dev.device(), &renderPassInfo, nullptr,
-                               &render_pass),
+  // the same attachments and subpasses give back the pass made before
+  CHECK_VK2(render_passes.get(logical_dev.device(), renderPassInfo,
+                              render_pass),
             "failed to create render pass");
 }
 
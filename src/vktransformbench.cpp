@@ -0,0 +1,132 @@
+// transform hierarchy and matrix product throughput, no window or device
+#include <chrono>
+#include <external.hpp>
+#include <random>
+#include <vertex.hpp>
+#include <vkscene/transform.hpp>
+
+using namespace vtuto;
+
+/** best of a few runs of fn, in seconds */
+template <class Fn> double best_seconds(int runs, Fn fn) {
+  double best = 1e30;
+  for (int i = 0; i < runs; i++) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double> took =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, took.count());
+  }
+  return best;
+}
+
+/** a root, groups under it and leaves under every group */
+transform_hierarchy make_scene(simd_isa isa, uint32_t groups,
+                               uint32_t leaves) {
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<float> coord(-10.0f, 10.0f);
+  std::uniform_real_distribution<float> angle(0.0f, 6.28f);
+  transform_hierarchy h(isa);
+  h.reserve(1 + groups * (1 + leaves));
+  uint32_t root = h.add();
+  h.set_rotation(root, 0.3f, glm::vec3(0.0f, 0.0f, 1.0f));
+  for (uint32_t g = 0; g < groups; g++) {
+    uint32_t group = h.add(root);
+    h.set_translation(group, glm::vec3(coord(rng), coord(rng), 0.0f));
+    for (uint32_t l = 0; l < leaves; l++) {
+      uint32_t leaf = h.add(group);
+      h.set_translation(leaf, glm::vec3(coord(rng), coord(rng), coord(rng)));
+      h.set_rotation(leaf, angle(rng), glm::vec3(0.0f, 0.0f, 1.0f));
+      h.set_scale(leaf, glm::vec3(0.5f));
+    }
+  }
+  h.update();
+  return h;
+}
+
+int main(int argc, char **argv) {
+  uint32_t groups = 100;
+  uint32_t leaves = 1000;
+  int runs = 20;
+  if (argc > 1) {
+    groups = static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10));
+  }
+  if (argc > 2) {
+    leaves = static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10));
+  }
+  const uint32_t nodes = 1 + groups * (1 + leaves);
+  std::cout << "transformbench.nodes " << nodes << std::endl;
+
+  // what updateUniformBuffer used to do for every object every frame
+  {
+    std::vector<glm::mat4> out(nodes);
+    double s = best_seconds(runs, [&]() {
+      for (uint32_t i = 0; i < nodes; i++) {
+        glm::mat4 m = glm::translate(glm::mat4(1.0f), glm::vec3(float(i)));
+        out[i] = glm::rotate(m, 0.3f, glm::vec3(0.0f, 0.0f, 1.0f));
+      }
+    });
+    std::cout << "transformbench.glm_recompute.nodes_per_s " << nodes / s
+              << std::endl;
+  }
+
+  transform_hierarchy reference = make_scene(simd_isa::scalar, groups, leaves);
+  for (simd_isa isa : {simd_isa::scalar, simd_isa::sse, simd_isa::avx2}) {
+    std::string prefix = std::string("transformbench.") + to_string(isa);
+    if (!simd_supported(isa)) {
+      std::cout << prefix << ".skipped 1" << std::endl;
+      continue;
+    }
+    transform_hierarchy h = make_scene(isa, groups, leaves);
+    // root moved: the whole tree is recomputed
+    double full = best_seconds(runs, [&]() {
+      h.set_rotation(0, 0.3f, glm::vec3(0.0f, 0.0f, 1.0f));
+      h.update();
+    });
+    std::cout << prefix << ".full.nodes_per_s " << nodes / full << std::endl;
+    // one group moved: only its subtree is
+    uint32_t group = 1 + (groups / 2) * (1 + leaves);
+    std::size_t touched = 0;
+    double partial = best_seconds(runs, [&]() {
+      h.set_translation(group, glm::vec3(1.0f, 2.0f, 0.0f));
+      touched = h.update();
+    });
+    std::cout << prefix << ".subtree.recomputed " << touched << std::endl;
+    std::cout << prefix << ".subtree.us " << partial * 1e6 << std::endl;
+
+    // copy what changed since the previous version, as into a mapped buffer
+    std::vector<InstanceData> mapped(nodes);
+    h.write_changed(mapped.data(), 0, 0, nodes);
+    uint64_t seen = h.version();
+    h.set_translation(group, glm::vec3(2.0f, 1.0f, 0.0f));
+    h.update();
+    std::size_t written = h.write_changed(mapped.data(), seen, 0, nodes);
+    std::cout << prefix << ".subtree.written " << written << std::endl;
+
+    // same transforms as the scalar scene
+    h.set_translation(group, glm::vec3(0.0f));
+    reference.set_translation(group, glm::vec3(0.0f));
+    h.update();
+    reference.update();
+    std::size_t mismatches = 0;
+    for (uint32_t i = 0; i < nodes; i++) {
+      if (std::memcmp(&h.world(i), &reference.world(i), sizeof(glm::mat4))) {
+        mismatches++;
+      }
+    }
+    std::cout << prefix << ".mismatches " << mismatches << std::endl;
+
+    // independent products, the batch kernel alone
+    std::vector<glm::mat4> a(nodes), b(nodes), out(nodes);
+    for (uint32_t i = 0; i < nodes; i++) {
+      a[i] = h.world(i);
+      b[i] = reference.local(i);
+    }
+    double batch = best_seconds(runs, [&]() {
+      mat4_mul_batch(a.data(), b.data(), out.data(), nodes, isa);
+    });
+    std::cout << prefix << ".batch.products_per_s " << nodes / batch
+              << std::endl;
+  }
+  return EXIT_SUCCESS;
+}
@@ -35,7 +35,11 @@ void HelloTriangle::run() {
   initVulkan();
 
   // 3. main loop
-  renderLoop();
+  if (instance_benchmark) {
+    runInstanceBenchmark();
+  } else {
+    renderLoop();
+  }
 
   // 4. clean up ressources
   cleanUp();
@@ -66,6 +70,8 @@ Steps to initialize a vulkan api
 1. Create a vulkan instance
 */
 void HelloTriangle::initVulkan() {
+  // 0. transient arenas used by the setup helpers and the draw loop
+  frame_arenas.resize(pacing.frames_in_flight);
   //
   /**
     1. Create a vulkan instance
@@ -90,7 +96,8 @@ void HelloTriangle::initVulkan() {
   createLogicalDevice();
 
   // 5. create swap chain
-  swap_chain = swapchain(physical_dev, logical_dev, window);
+  swap_chain = swapchain(physical_dev, logical_dev, window, 1,
+                         VK_NULL_HANDLE, pacing);
 
   /**
     7. create render pass
@@ -109,6 +116,22 @@ void HelloTriangle::initVulkan() {
 
   // 8. descriptor set layout
   createDescriptorSetLayout();
+  // textures by index for every draw, if the device can
+  createTextureTable();
+
+  // workers and their own command pools for parallel recording, started
+  // first so the optimized graphics pipeline compiles on them
+  if (record_threads == 0) {
+    std::size_t cores = std::thread::hardware_concurrency();
+    record_threads = std::min<std::size_t>(std::max<std::size_t>(cores, 1), 8);
+  }
+  if (record_threads > 1) {
+    QueuFamilyIndices qfi = QueuFamilyIndices::find_family_indices(
+        physical_dev.pdevice, physical_dev.surface);
+    record_workers.start(record_threads);
+    record_pools = thread_command_pools(logical_dev, qfi.graphics_family.value(),
+                                       record_threads);
+  }
 
   // 8. create graphics pipeline
   createGraphicsPipeline();
@@ -122,6 +145,18 @@ void HelloTriangle::initVulkan() {
   // 11. create command pool
   // createCommandPool();
   command_pool = vk_command_pool(physical_dev, logical_dev);
+  // one timeline per queue, values from a single counter, signaled by the
+  // uploads below as well as by the frames
+  frames = frame_scheduler(logical_dev.device(), pacing.frames_in_flight,
+                           swap_chain.simages.size());
+  upload_pool = transient_command_pool(physical_dev, logical_dev,
+                                       logical_dev.graphics_queue, frames);
+  use_transfer_queue = logical_dev.families.has_dedicated_transfer();
+  if (use_transfer_queue) {
+    transfer_pool = transient_command_pool(
+        logical_dev, logical_dev.families.transfer_family.value(),
+        logical_dev.transfer_queue, frames, timeline_lane::transfer);
+  }
 
   // 12. create depth image
   // createDepthRessources();
@@ -134,17 +169,33 @@ void HelloTriangle::initVulkan() {
 
   // 15. create texture sampler
   createTextureSampler();
+  addTableTextures();
 
   loadModel();
+  createSceneGraph();
+  computeModelBounds();
 
   // 16. create vertex buffer
   createVertexBuffer();
 
   // 17. create index buffer
   createIndexBuffer();
-
-  // 18. create uniform buffers
+  draw_item model_draw;
+  model_draw.index_count = static_cast<uint32_t>(indices.size());
+  model_draw.instance_count = instance_count;
+  model_draw.transform_node = model_node;
+  model_draw.material_index = model_texture_slot;
+  scene_draws.push(model_draw);
+
+  // 18. create uniform buffers and per instance transforms
   createUniformBuffer();
+  instances.grid(instance_count);
+  placeInstances();
+  createInstanceBuffers();
+  createFrameTimer();
+  // instances outside the view are skipped when the device allows it
+  createCullPipeline();
+  createCullBuffers();
 
   // 19. create descriptor pool
   createDescriptorPool();
@@ -157,6 +208,18 @@ void HelloTriangle::initVulkan() {
 
   // 22. create sync objects: semaphores, fences etc
   createSyncObjects();
+
+  // uploads were pipelined, they must land before the first frame
+  finishUploads();
+
+  // 23. memory footprint after setup
+  reportMemoryUsage();
+  reportRecordStats();
+
+  // 24. watch the shaders while tuning
+  if (hot_reload_enabled) {
+    startHotReload();
+  }
 }
 
 /**
@@ -164,6 +227,47 @@ void HelloTriangle::initVulkan() {
 
   Render elements to window. Acquire user input
  */
+void HelloTriangle::runInstanceBenchmark() {
+  const uint32_t counts[] = {1, 10, 100, 1000, 10000, 100000};
+  const int warmup_frames = 10;
+  const int measured_frames = 100;
+  if (!instancing) {
+    std::cout << "bench.instances skipped, no instanced pipeline" << std::endl;
+    return;
+  }
+  for (uint32_t count : counts) {
+    setInstanceCount(count);
+    for (int i = 0; i < warmup_frames && !glfwWindowShouldClose(window); i++) {
+      glfwPollEvents();
+      draw();
+    }
+    gpu_time_ms_total = 0.0;
+    gpu_time_samples = 0;
+    double blocked_before = frames.stats().blocked_us;
+    auto start = std::chrono::steady_clock::now();
+    int done = 0;
+    for (; done < measured_frames && !glfwWindowShouldClose(window); done++) {
+      glfwPollEvents();
+      draw();
+    }
+    std::chrono::duration<double, std::milli> wall =
+        std::chrono::steady_clock::now() - start;
+    if (done == 0) {
+      break;
+    }
+    // cpu time is the frame time minus what was spent waiting for the gpu
+    double blocked_ms = (frames.stats().blocked_us - blocked_before) / 1000.0;
+    std::string prefix = "bench.instances." + std::to_string(count);
+    std::cout << prefix << ".frame_ms " << wall.count() / done << std::endl;
+    std::cout << prefix << ".cpu_ms " << (wall.count() - blocked_ms) / done
+              << std::endl;
+    if (gpu_time_samples > 0) {
+      std::cout << prefix << ".gpu_ms " << gpu_time_ms_total / gpu_time_samples
+                << std::endl;
+    }
+  }
+  frames.wait_idle(logical_dev.device());
+}
 void HelloTriangle::renderLoop() {
   //
   while (!glfwWindowShouldClose(window)) {
@@ -178,39 +282,87 @@ void HelloTriangle::renderLoop() {
   Destroy window, and other ressources.
  */
 void HelloTriangle::cleanUp() {
+  // a rebuild still running holds modules and maybe a pipeline
+  stopHotReload();
+  // device is idle, whatever was retired during resizes can go now
+  deletions.flush();
   //
+  reportMemoryUsage();
+  reportRecordStats();
+  reportFramePacing();
+  reportCullStats();
+  reportDescriptorStats();
+  // a build still running would write the cache while it is saved
+  pipeline_builds.wait_all();
+  if (!pipelines.save(logical_dev.device())) {
+    std::cerr << "failed to save pipeline cache to " << pipeline_cache_path
+              << std::endl;
+  }
+  pipelines.report(std::cout);
+  shaders.report(std::cout);
+  pipeline_library.report(std::cout);
+  pipeline_builds.report(std::cout);
+  untrackSwapchainMemory();
+  // owned by the library, destroyed with it below
+  graphics_pipeline = VK_NULL_HANDLE;
+  // framebuffers and the render pass belong to their caches
+  framebuffers.report(std::cout);
+  framebuffers.destroy(logical_dev.device());
+  swapchain_framebuffers.clear();
+  render_pass = VK_NULL_HANDLE;
   auto v = cmd_buffers.to_vec();
+  // the depth view is destroyed with the swapchain below
+  view_cache.release(depth_image);
   swap_chain.destroy(logical_dev, command_pool.pool, v, swapchain_framebuffers,
                      render_pass, graphics_pipeline, pipeline_layout,
-                     uniform_buffers, uniform_buffer_memories, descriptor_pool,
-                     depth_image, depth_image_view, depth_image_memory);
+                     uniform_buffers, uniform_buffer_memories, depth_image,
+                     depth_image_view, depth_image_memory);
+  descriptors.destroy(logical_dev.device());
+  texture_table.destroy(logical_dev.device());
 
   // destroy texture sampler
-  vkDestroySampler(logical_dev.device(), texture_sampler, nullptr);
-  // destroy image view
-  vkDestroyImageView(logical_dev.device(), texture_image_view, nullptr);
+  samplers.report(std::cout);
+  samplers.destroy(logical_dev.device());
+  // destroy image views, every one of them before its image
+  view_cache.report(std::cout);
+  for (VkImageView view : view_cache.release(texture_image)) {
+    vkDestroyImageView(logical_dev.device(), view, nullptr);
+  }
+  view_cache.destroy(logical_dev.device());
   //
   vkDestroyImage(logical_dev.device(), texture_image, nullptr);
-  vkFreeMemory(logical_dev.device(), texture_image_memory, nullptr);
-  //
-  vkDestroyDescriptorSetLayout(logical_dev.device(), descriptor_set_layout,
-                               nullptr);
+  freeMemory(texture_image_memory);
 
   vkDestroyBuffer(logical_dev.device(), index_buffer, nullptr);
-  vkFreeMemory(logical_dev.device(), index_buffer_memory, nullptr);
+  freeMemory(index_buffer_memory);
 
   vkDestroyBuffer(logical_dev.device(), vertex_buffer, nullptr);
-  vkFreeMemory(logical_dev.device(), vertex_buffer_memory, nullptr);
-  auto mxflight = static_cast<unsigned int>(MAX_FRAMES_IN_FLIGHT);
-
-  for (unsigned int i = 0; i < mxflight; i++) {
-    vkDestroySemaphore(logical_dev.device(), render_finished_semaphores[i],
-                       nullptr);
-    vkDestroySemaphore(logical_dev.device(), image_available_semaphores[i],
-                       nullptr);
-    vkDestroyFence(logical_dev.device(), current_fences[i], nullptr);
+  freeMemory(vertex_buffer_memory);
+  for (std::size_t i = 0; i < instance_buffers.size(); i++) {
+    vkDestroyBuffer(logical_dev.device(), instance_buffers[i], nullptr);
+    freeMemory(instance_buffer_memories[i]);
+  }
+  frame_timer.destroy(logical_dev.device());
+  destroyCulling();
+  destroyFrameSlots();
+  // the pools wait on the scheduler's semaphores
+  upload_pool.destroy(logical_dev);
+  if (use_transfer_queue) {
+    transfer_pool.destroy(logical_dev);
+  }
+  frames.destroy(logical_dev.device());
+  for (const auto &secondaries : secondary_buffers) {
+    free_secondaries(logical_dev.device(), secondaries);
   }
+  record_pools.destroy(logical_dev);
+  record_workers.stop();
   command_pool.destroy(logical_dev);
+  pipeline_library.destroy(logical_dev.device());
+  render_passes.report(std::cout);
+  render_passes.destroy(logical_dev.device());
+  pipelines.destroy(logical_dev.device());
+  shaders.destroy(logical_dev.device());
+  descriptor_layouts.destroy(logical_dev.device());
 
   // 4. destroy logical device
   logical_dev.destroy();
@@ -362,33 +514,30 @@ bool HelloTriangle::checkDeviceExtensionSupport(VkPhysicalDevice pdev) {
   }
   return requested_extensions.empty();
 }
-VkShaderModule
-HelloTriangle::createShaderModule(const std::vector<char> &shaderCode) {
-  //
-  VkShaderModuleCreateInfo createInfo{};
-  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  createInfo.codeSize = shaderCode.size();
-  createInfo.pCode = reinterpret_cast<const uint32_t *>(shaderCode.data());
-
-  VkShaderModule shaderModule;
-  CHECK_VK2(vkCreateShaderModule(logical_dev.device(), &createInfo, nullptr,
-                                 &shaderModule),
-            "failed to create shader module");
+VkShaderModule HelloTriangle::acquireShader(const std::string &path) {
+  VkShaderModule shaderModule = VK_NULL_HANDLE;
+  CHECK_VK2(shaders.acquire(logical_dev.device(), path, shaderModule),
+            "failed to create shader module from " << path);
   return shaderModule;
 }
 void HelloTriangle::createFramebuffers() {
+  VkDevice device = logical_dev.device();
   swapchain_framebuffers.resize(swap_chain.view_size());
+  // every image's framebuffer is in use at once, none may be evicted
+  framebuffers.fit(swap_chain.view_size());
   for (std::size_t i = 0; i < swap_chain.view_size(); i++) {
     // vk image view per frame
     std::vector<VkImageView> image_attachments = {swap_chain.simage_views[i],
                                                   depth_image_view};
-    auto width = swap_chain.sextent.width;
-    auto height = swap_chain.sextent.height;
     auto layer_nb = 1;
-    auto vbuffer = vulkan_buffer<VkFramebuffer>(
-        width, height, layer_nb, render_pass, image_attachments, logical_dev);
-    swapchain_framebuffers[i] = vbuffer;
-    //
+    CHECK_VK2(framebuffers.get(device, render_pass, image_attachments,
+                               swap_chain.sextent, layer_nb,
+                               swapchain_framebuffers[i].buffer),
+              "failed to create framebuffer for image view");
+  }
+  // frames in flight may still render into what was pushed out
+  for (VkFramebuffer evicted : framebuffers.evicted()) {
+    deletions.destroy(device, evicted, vkDestroyFramebuffer);
   }
 }
 
@@ -447,7 +596,8 @@ void HelloTriangle::createTextureImage() {
   VkMemoryPropertyFlags mem_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
                                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 
-  createBuffer(imsize, usage, mem_flags, staging_buffer, stage_buffer_memory);
+  createBuffer(imsize, usage, mem_flags, staging_buffer, stage_buffer_memory,
+               memory_category::staging);
   void *data;
   vkMapMemory(logical_dev.device(), stage_buffer_memory, 0, imsize, 0, &data);
   memcpy(data, pixels, static_cast<std::size_t>(imsize));
@@ -462,7 +612,7 @@ void HelloTriangle::createTextureImage() {
       VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
   VkMemoryPropertyFlags improps = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
   createImage(imwidth, imheight, imformat, imtiling, imusage, improps,
-              texture_image, texture_image_memory);
+              texture_image, texture_image_memory, memory_category::texture);
   //
   auto format = VK_FORMAT_R8G8B8A8_SRGB;
   auto old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -474,15 +624,22 @@ void HelloTriangle::createTextureImage() {
 
   old_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
   new_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-  transitionImageLayout(texture_image, format, old_layout, new_layout);
-
-  vkDestroyBuffer(logical_dev.device(), staging_buffer, nullptr);
-  vkFreeMemory(logical_dev.device(), stage_buffer_memory, nullptr);
+  auto ticket =
+      transitionImageLayout(texture_image, format, old_layout, new_layout);
+
+  // the three submits run back to back, staging goes once the last is done
+  VkBuffer stage = staging_buffer;
+  VkDeviceMemory stage_memory = stage_buffer_memory;
+  upload_pool.release_after(ticket, [this, stage, stage_memory]() {
+    vkDestroyBuffer(logical_dev.device(), stage, nullptr);
+    freeMemory(stage_memory);
+  });
 }
 void HelloTriangle::createImage(uint32_t imw, uint32_t imh, VkFormat format,
                                 VkImageTiling tiling, VkImageUsageFlags imusage,
                                 VkMemoryPropertyFlags improps, VkImage &vimage,
-                                VkDeviceMemory &vimage_memory) {
+                                VkDeviceMemory &vimage_memory,
+                                memory_category category) {
   VkImageCreateInfo img_info{};
   img_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
   img_info.imageType = VK_IMAGE_TYPE_2D;
@@ -513,11 +670,14 @@ void HelloTriangle::createImage(uint32_t imw, uint32_t imh, VkFormat format,
   CHECK_VK2(vkAllocateMemory(logical_dev.device(), &allocInfo, nullptr,
                              &vimage_memory),
             "failed to create image memory");
+  memory_stats.track(vimage_memory, allocInfo.allocationSize,
+                     allocInfo.memoryTypeIndex, category);
   vkBindImageMemory(logical_dev.device(), vimage, vimage_memory, 0);
 }
-void HelloTriangle::transitionImageLayout(VkImage image, VkFormat format,
-                                          VkImageLayout old_layout,
-                                          VkImageLayout new_layout) {
+transient_submit HelloTriangle::transitionImageLayout(VkImage image,
+                                                      VkFormat format,
+                                                      VkImageLayout old_layout,
+                                                      VkImageLayout new_layout) {
   VkCommandBuffer command_buffer = beginSignalCommand();
   //
   VkImageMemoryBarrier barrier{};
@@ -575,11 +735,13 @@ void HelloTriangle::transitionImageLayout(VkImage image, VkFormat format,
   }
   vkCmdPipelineBarrier(command_buffer, source_stage, dst_stage, 0, 0, nullptr,
                        0, nullptr, 1, &barrier);
-  endSignalCommand(command_buffer);
+  return endSignalCommand(command_buffer);
 }
 
-void HelloTriangle::copyBufferToImage(VkBuffer buffer, VkImage image,
-                                      uint32_t width, uint32_t height) {
+transient_submit HelloTriangle::copyBufferToImage(VkBuffer buffer,
+                                                  VkImage image,
+                                                  uint32_t width,
+                                                  uint32_t height) {
   VkCommandBuffer cbuffer = beginSignalCommand();
 
   VkBufferImageCopy region{};
@@ -595,7 +757,7 @@ void HelloTriangle::copyBufferToImage(VkBuffer buffer, VkImage image,
 
   vkCmdCopyBufferToImage(cbuffer, buffer, image,
                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-  endSignalCommand(cbuffer);
+  return endSignalCommand(cbuffer);
 }
 
 void HelloTriangle::createTextureSampler() {
@@ -623,43 +785,16 @@ void HelloTriangle::createTextureSampler() {
   cinfo.compareOp = VK_COMPARE_OP_ALWAYS;
   cinfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 
-  // create sampler with given information
-  CHECK_VK2(
-      vkCreateSampler(logical_dev.device(), &cinfo, nullptr, &texture_sampler),
-      "failed to create texture sampler");
+  // textures sampled the same way share the sampler
+  CHECK_VK2(samplers.get(logical_dev.device(), cinfo, texture_sampler),
+            "failed to create texture sampler");
 }
 VkCommandBuffer HelloTriangle::beginSignalCommand() {
   //
-  VkCommandBufferAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandPool = command_pool.pool;
-  allocInfo.commandBufferCount = 1;
-
-  VkCommandBuffer cbuffer;
-  vkAllocateCommandBuffers(logical_dev.device(), &allocInfo, &cbuffer);
-
-  VkCommandBufferBeginInfo binfo{};
-  binfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-  binfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-  //
-  vkBeginCommandBuffer(cbuffer, &binfo);
-  return cbuffer;
+  return upload_pool.begin();
 }
-void HelloTriangle::endSignalCommand(VkCommandBuffer cbuffer) {
-  vkEndCommandBuffer(cbuffer);
-
-  VkSubmitInfo sinfo{};
-  sinfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  sinfo.commandBufferCount = 1;
-  sinfo.pCommandBuffers = &cbuffer;
-
-  //
-  vkQueueSubmit(logical_dev.graphics_queue, 1, &sinfo, VK_NULL_HANDLE);
-  vkQueueWaitIdle(logical_dev.graphics_queue);
-
-  vkFreeCommandBuffers(logical_dev.device(), command_pool.pool, 1, &cbuffer);
+transient_submit HelloTriangle::endSignalCommand(VkCommandBuffer cbuffer) {
+  return upload_pool.submit(cbuffer);
 }
 void HelloTriangle::loadModel() {
   tinyobj::attrib_t attrib;
@@ -707,32 +842,102 @@ uint32_t HelloTriangle::findMemoryType(uint32_t filter,
   throw std::runtime_error("could not find a suitable memory type");
 }
 void HelloTriangle::createSyncObjects() {
-  image_available_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  render_finished_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  current_fences.resize(MAX_FRAMES_IN_FLIGHT);
-  images_in_flight.resize(swap_chain.simages.size(), VK_NULL_HANDLE);
+  // the frame scheduler exists since the upload pools do
+  createFrameSlots();
+}
+void HelloTriangle::createFrameSlots() {
+  image_available_semaphores.resize(pacing.frames_in_flight);
+  render_finished_semaphores.resize(pacing.frames_in_flight);
+  frame_arenas.resize(pacing.frames_in_flight);
 
   // create semaphore info
   VkSemaphoreCreateInfo semaphoreInfo{};
   semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-  // create fences
-  VkFenceCreateInfo fenceInfo{};
-  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-  auto mxflight = static_cast<unsigned int>(MAX_FRAMES_IN_FLIGHT);
-  for (std::size_t i = 0; i < mxflight; i++) {
+  for (std::size_t i = 0; i < pacing.frames_in_flight; i++) {
     CHECK_VK2(vkCreateSemaphore(logical_dev.device(), &semaphoreInfo, nullptr,
                                 &image_available_semaphores[i]),
               "Failed to create image available semaphore");
     CHECK_VK2(vkCreateSemaphore(logical_dev.device(), &semaphoreInfo, nullptr,
                                 &render_finished_semaphores[i]),
               "Failed to create render finished semaphore");
-
-    CHECK_VK2(vkCreateFence(logical_dev.device(), &fenceInfo, nullptr,
-                            &current_fences[i]),
-              "Failed to in flight fence");
   }
+  if (recording_mode == command_recording::per_frame) {
+    for (std::size_t i = 0; i < pacing.frames_in_flight; i++) {
+      frame_pools.push_back(frame_command_pool(physical_dev, logical_dev));
+    }
+  }
+}
+void HelloTriangle::destroyFrameSlots() {
+  for (std::size_t i = 0; i < image_available_semaphores.size(); i++) {
+    vkDestroySemaphore(logical_dev.device(), render_finished_semaphores[i],
+                       nullptr);
+    vkDestroySemaphore(logical_dev.device(), image_available_semaphores[i],
+                       nullptr);
+  }
+  image_available_semaphores.clear();
+  render_finished_semaphores.clear();
+  for (auto &fpool : frame_pools) {
+    fpool.destroy(logical_dev);
+  }
+  frame_pools.clear();
+}
+void HelloTriangle::setFramesInFlight(std::size_t count) {
+  if (count == 0) {
+    throw std::runtime_error("at least one frame must be in flight");
+  }
+  // slots are indexed by frame, none may be in use while they are rebuilt
+  frames.wait_idle(logical_dev.device());
+  deletions.collect(frames.last_value());
+  destroyFrameSlots();
+  pacing.frames_in_flight = count;
+  frames.set_frames_in_flight(count);
+  current_frame = 0;
+  createFrameSlots();
+}
+void HelloTriangle::setFramePacing(const frame_pacing_config &config) {
+  frame_pacing_config old = pacing;
+  pacing = config;
+  pacing.frames_in_flight = old.frames_in_flight;
+  if (config.frames_in_flight != old.frames_in_flight) {
+    setFramesInFlight(config.frames_in_flight);
+  }
+  if (config.present_modes != old.present_modes ||
+      config.image_count != old.image_count) {
+    recreateSwapchain();
+  }
+  // samples taken under the old settings would skew the new ones
+  frame_latency.reset();
+}
+void HelloTriangle::reportFramePacing() {
+  latency_stats done = frame_latency.submit_to_complete();
+  latency_stats present = frame_latency.present();
+  std::cout << "pacing.present_mode "
+            << present_mode_name(swap_chain.present_mode) << std::endl;
+  std::cout << "pacing.frames_in_flight " << pacing.frames_in_flight
+            << std::endl;
+  std::cout << "pacing.images " << swap_chain.simages.size() << std::endl;
+  std::cout << "pacing.wait_before_acquire " << pacing.wait_before_acquire
+            << std::endl;
+  std::cout << "latency.submit_to_complete.samples " << done.samples
+            << std::endl;
+  std::cout << "latency.submit_to_complete.avg_us " << done.average_us
+            << std::endl;
+  std::cout << "latency.submit_to_complete.p50_us " << done.p50_us
+            << std::endl;
+  std::cout << "latency.submit_to_complete.p99_us " << done.p99_us
+            << std::endl;
+  std::cout << "latency.submit_to_complete.max_us " << done.max_us
+            << std::endl;
+  std::cout << "latency.present_call.avg_us " << present.average_us
+            << std::endl;
+  std::cout << "latency.present_call.max_us " << present.max_us << std::endl;
+  std::cout << "resize.rebuilds " << swapchain_rebuilds.rebuilds << std::endl;
+  std::cout << "resize.pipeline_rebuilds "
+            << swapchain_rebuilds.pipeline_rebuilds << std::endl;
+  std::cout << "resize.avg_us " << swapchain_rebuilds.average_us()
+            << std::endl;
+  std::cout << "resize.max_us " << swapchain_rebuilds.max_us << std::endl;
 }
 void HelloTriangle::recreateSwapchain() {
   //
@@ -742,17 +947,29 @@ void HelloTriangle::recreateSwapchain() {
     glfwGetFramebufferSize(window, &width, &height);
     glfwWaitEvents();
   }
-  vkDeviceWaitIdle(logical_dev.device());
-  auto vs = cmd_buffers.to_vec();
-  swap_chain.destroy(logical_dev, command_pool.pool, vs, swapchain_framebuffers,
-                     render_pass, graphics_pipeline, pipeline_layout,
-                     uniform_buffers, uniform_buffer_memories, descriptor_pool,
-                     depth_image, depth_image_view, depth_image_memory);
-  swap_chain = swapchain(physical_dev, logical_dev, window);
-  // 1. render pass
+  auto start = std::chrono::steady_clock::now();
+  // no device wait: frames in flight may still use the old objects, they
+  // are destroyed once the timeline reached the values of those frames
+  retireSwapchainResources();
+  deferred<VkSwapchainKHR> old_chain(deletions, logical_dev.device(),
+                                     swap_chain.chain, vkDestroySwapchainKHR);
+  swap_chain = swapchain(physical_dev, logical_dev, window, 1, old_chain.get(),
+                         pacing);
+  // a shader rebuild compiles against the current pass, it must not go
+  // while the worker uses it. Built for a pass replaced meanwhile, the
+  // result is dropped as stale
+  waitShaderReload();
+  // 1. render pass, from the cache unless the attachment formats changed
+  VkRenderPass old_pass = render_pass;
   createRenderPass();
-  // 2. graphics pipeline
-  createGraphicsPipeline();
+  // viewport and scissor are dynamic, the pipeline only depends on the
+  // render pass
+  bool rebuild_pipeline =
+      rebuild_pipeline_on_resize || render_pass != old_pass;
+  if (rebuild_pipeline) {
+    // 2. graphics pipeline
+    createGraphicsPipeline();
+  }
 
   // 3. create depth ressources
   createDepthRessources();
@@ -760,34 +977,147 @@ void HelloTriangle::recreateSwapchain() {
   createFramebuffers();
   // 4. uniform buffer
   createUniformBuffer();
+  createInstanceBuffers();
+  createCullBuffers();
+  createFrameTimer();
   // 5. descriptor pool
   createDescriptorPool();
   // 6. descriptor pool
   createDescriptorSets();
   // 7. command buffers
   createCommandBuffers();
+  // 8. image count may have changed, new images are not used by any frame
+  frames.set_image_count(swap_chain.simages.size());
+
+  std::chrono::duration<double, std::micro> took =
+      std::chrono::steady_clock::now() - start;
+  swapchain_rebuilds.add(took.count(), rebuild_pipeline);
 }
-void HelloTriangle::updateUniformBuffer(uint32_t image_index) {
-  UniformBufferObject ubo;
-  glm::mat4 model(1.0f);
-  ubo.model =
-      glm::rotate(model, glm::radians(45.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+void HelloTriangle::retireCommandBuffers() {
+  VkDevice device = logical_dev.device();
+  VkCommandPool pool = command_pool.pool;
+  auto cbuffers = cmd_buffers.to_vec();
+  if (!cbuffers.empty()) {
+    deletions.push([device, pool, cbuffers]() {
+      vkFreeCommandBuffers(device, pool,
+                           static_cast<uint32_t>(cbuffers.size()),
+                           cbuffers.data());
+    });
+  }
+  cmd_buffers.resize(0);
+  auto secondaries = secondary_buffers;
+  deletions.push([device, secondaries]() {
+    for (const auto &recs : secondaries) {
+      free_secondaries(device, recs);
+    }
+  });
+  secondary_buffers.clear();
+}
+void HelloTriangle::retireSwapchainResources() {
+  VkDevice device = logical_dev.device();
+  // framebuffers attaching the old views, they can not be asked for again
+  std::vector<VkImageView> attachments = swap_chain.simage_views.data();
+  attachments.push_back(depth_image_view);
+  for (VkImageView view : attachments) {
+    for (VkFramebuffer framebuffer : framebuffers.release(view)) {
+      deletions.destroy(device, framebuffer, vkDestroyFramebuffer);
+    }
+  }
+  swapchain_framebuffers.clear();
+  // depth attachment, the new image gets its own views
+  for (VkImageView view : view_cache.release(depth_image)) {
+    deletions.destroy(device, view, vkDestroyImageView);
+  }
+  deletions.destroy(device, depth_image, vkDestroyImage);
+  VkDeviceMemory depth_memory = depth_image_memory;
+  deletions.push([this, depth_memory]() { freeMemory(depth_memory); });
+
+  // command buffers recorded against the old framebuffers
+  retireCommandBuffers();
+  auto views = swap_chain.simage_views;
+  deletions.push([this, views]() mutable { views.destroy(logical_dev); });
+
+  // per image uniform buffers and the descriptor sets pointing at them
+  for (std::size_t i = 0; i < uniform_buffers.size(); i++) {
+    deletions.destroy(device, uniform_buffers[i], vkDestroyBuffer);
+    VkDeviceMemory memory = uniform_buffer_memories[i];
+    deletions.push([this, memory]() { freeMemory(memory); });
+  }
+  // the sets go back to their pools once no frame reads them
+  auto pools = descriptors.detach();
+  deletions.push(
+      [this, device, pools]() { descriptors.recycle(device, pools); });
+  retireInstanceBuffers();
+  retireCullBuffers();
+  // one query pair per image
+  gpu_timer old_timer = frame_timer;
+  deletions.push([device, old_timer]() mutable { old_timer.destroy(device); });
+}
+void HelloTriangle::createFrameTimer() {
+  frame_timer =
+      gpu_timer(physical_dev.pdevice, logical_dev.device(),
+                logical_dev.families.graphics_family.value(),
+                static_cast<uint32_t>(swap_chain.simages.size()));
+}
+void HelloTriangle::createSceneGraph() {
+  scene_graph = transform_hierarchy();
+  model_node = scene_graph.add();
+  scene_graph.set_rotation(model_node, glm::radians(45.0f),
+                           glm::vec3(0.0f, 0.0f, 1.0f));
+  // the instances apply after the model matrix, they have their own root
+  instance_root = scene_graph.add();
+  scene_graph.update();
+}
+void HelloTriangle::placeInstances() {
+  // instance nodes come last, the new ones get fresh versions so every
+  // instance buffer picks them up
+  scene_graph.truncate(instance_root + 1);
+  instances.add_nodes(scene_graph, instance_root);
+  scene_graph.update();
+}
+void HelloTriangle::updateCamera() {
   glm::vec3 cam_pos(2.0f);
   glm::vec3 cam_target(0.0f);
   glm::vec3 world_up(0.0f, 0.0f, 1.0f);
-  ubo.view = glm::lookAt(cam_pos, cam_target, world_up);
+  camera_view = glm::lookAt(cam_pos, cam_target, world_up);
   float aspect_ratio =
       swap_chain.sextent.width / static_cast<float>(swap_chain.sextent.height);
   float near_plane_distance = 0.1f;
   float far_plane_distance = 100.0f;
-  ubo.proj = glm::perspective(glm::radians(45.0f), aspect_ratio,
-                              near_plane_distance, far_plane_distance);
-  ubo.proj[1][1] *= -1;
-
-  void *data;
-  vkMapMemory(logical_dev.device(), uniform_buffer_memories[image_index], 0,
-              sizeof(ubo), 0, &data);
-  memcpy(data, &ubo, sizeof(ubo));
-  vkUnmapMemory(logical_dev.device(), uniform_buffer_memories[image_index]);
+  camera_proj = glm::perspective(glm::radians(45.0f), aspect_ratio,
+                                 near_plane_distance, far_plane_distance);
+  camera_proj[1][1] *= -1;
+}
+UniformBufferObject HelloTriangle::frameUniforms() const {
+  UniformBufferObject ubo;
+  ubo.model = scene_graph.world(model_node);
+  ubo.view = camera_view;
+  ubo.proj = camera_proj;
+  return ubo;
+}
+DrawPushConstants HelloTriangle::drawConstants(const draw_item &d) const {
+  DrawPushConstants constants;
+  constants.model = scene_graph.world(d.transform_node);
+  constants.material_index = d.material_index;
+  return constants;
+}
+void HelloTriangle::updateUniformBuffer(uint32_t image_index) {
+  // only nodes moved since the last frame are recomputed
+  scene_graph.update();
+  // the image's last frame completed, its buffer is free to overwrite
+  UniformBufferObject *ubo = uniform_mapped[image_index];
+  uint64_t &written = uniform_written[image_index];
+  if (written == std::numeric_limits<uint64_t>::max()) {
+    // the camera comes with the buffer, both change with the swapchain
+    ubo->view = camera_view;
+    ubo->proj = camera_proj;
+    written = 0;
+  }
+  // with push constants the model matrix travels with the draw and the
+  // buffer holds the camera alone
+  if (!use_push_constants) {
+    scene_graph.write_changed(&ubo->model, written, model_node, 1);
+  }
+  written = scene_graph.version();
 }
 } // namespace vtuto